@@ -0,0 +1,176 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <doctest.h>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <praktor/loop.h>
+#include <praktor/mpsc_queue.h>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr std::size_t producer_count      = 12;
+constexpr std::size_t items_per_producer  = 200000;
+constexpr std::size_t total_item_count    = producer_count * items_per_producer;
+
+struct bench_node
+{
+	bench_node*           m_next;
+	std::function<void()> m_handler;
+};
+
+// Reproduces the previous dispatch queue: a deque guarded by a recursive
+// mutex, re-locked for every handler the consumer removes.
+class locked_queue
+{
+public:
+	void
+	push(std::function<void()>&& handler)
+	{
+		std::lock_guard<std::recursive_mutex> guard(m_mutex);
+		m_queue.emplace_back(std::move(handler));
+	}
+
+	bool
+	try_run_front()
+	{
+		std::function<void()> handler;
+		{
+			std::lock_guard<std::recursive_mutex> guard(m_mutex);
+			if (m_queue.empty())
+			{
+				return false;
+			}
+			handler = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+		handler();
+		return true;
+	}
+
+private:
+	std::deque<std::function<void()>> m_queue;
+	std::recursive_mutex              m_mutex;
+};
+
+template<class Produce, class Consume>
+double
+run_contended(Produce produce, Consume consume)
+{
+	std::atomic<bool>        go{false};
+	std::vector<std::thread> producers;
+	for (std::size_t i = 0; i < producer_count; ++i)
+	{
+		producers.emplace_back([&]() {
+			while (!go.load())
+				;
+			for (std::size_t n = 0; n < items_per_producer; ++n)
+			{
+				produce();
+			}
+		});
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	go.store(true);
+	consume();
+	auto elapsed = std::chrono::steady_clock::now() - start;
+
+	for (auto& t : producers)
+	{
+		t.join();
+	}
+	return static_cast<double>(total_item_count) / std::chrono::duration<double>(elapsed).count();
+}
+
+}    // namespace
+
+TEST_CASE("praktor::loop [ bench ] { dispatch queue contention }")
+{
+	std::size_t consumed{0};
+
+	locked_queue lq;
+	auto         locked_rate = run_contended(
+            [&]() { lq.push([&]() { ++consumed; }); },
+            [&]() {
+                while (consumed < total_item_count)
+                {
+                    lq.try_run_front();
+                }
+            });
+	CHECK(consumed == total_item_count);
+
+	consumed = 0;
+	mpsc_queue<bench_node> mq;
+	auto                   mpsc_rate = run_contended(
+            [&]() { mq.push(new bench_node{nullptr, [&]() { ++consumed; }}); },
+            [&]() {
+                while (consumed < total_item_count)
+                {
+                    auto node = mq.take_all();
+                    while (node)
+                    {
+                        std::unique_ptr<bench_node> current{node};
+                        node = node->m_next;
+                        current->m_handler();
+                    }
+                }
+            });
+	CHECK(consumed == total_item_count);
+
+	std::cout << "dispatch queue, " << producer_count << " producers:" << std::endl;
+	std::cout << "    mutex + deque: " << static_cast<std::size_t>(locked_rate) << " handlers/s" << std::endl;
+	std::cout << "    mpsc_queue:    " << static_cast<std::size_t>(mpsc_rate) << " handlers/s" << std::endl;
+	std::cout << "    speedup:       " << mpsc_rate / locked_rate << "x" << std::endl;
+}
+
+TEST_CASE("praktor::loop [ bench ] { cross-thread dispatch }")
+{
+	auto        lp = praktor::loop::create();
+	std::size_t handled{0};
+
+	auto rate = run_contended(
+			[&]() {
+				lp->dispatch([&]() {
+					if (++handled == total_item_count)
+					{
+						lp->stop();
+					}
+				});
+			},
+			[&]() { lp->run(); });
+
+	CHECK(handled == total_item_count);
+	std::cout << "loop::dispatch, " << producer_count << " producers: " << static_cast<std::size_t>(rate)
+			  << " handlers/s" << std::endl;
+	lp->close();
+}
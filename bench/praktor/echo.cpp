@@ -0,0 +1,242 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <doctest.h>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <praktor/loop_group.h>
+#include <praktor/tcp.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+
+constexpr std::size_t connects_per_client_loop = 2000;
+constexpr std::size_t connect_window           = 32;
+constexpr std::size_t echo_channels_per_loop   = 16;
+constexpr std::size_t echo_message_size        = 4096;
+constexpr auto        echo_duration            = std::chrono::seconds{2};
+
+using praktor::acceptor;
+using praktor::channel;
+
+struct server_stats
+{
+	std::atomic<std::size_t> m_accepted{0};
+};
+
+struct client_stats
+{
+	std::atomic<std::size_t>   m_connected{0};
+	std::atomic<std::uint64_t> m_echoed_bytes{0};
+	std::atomic<bool>          m_done{false};
+};
+
+void
+echo_on_connection(server_stats& stats, channel::ptr const& chan, std::error_code const& err)
+{
+	if (err)
+	{
+		return;
+	}
+	++stats.m_accepted;
+	chan->start_read([](channel::ptr const& chan, util::const_buffer&& buf, std::error_code const& err) {
+		if (err)
+		{
+			chan->close();
+			return;
+		}
+		std::error_code ec;
+		chan->write(util::mutable_buffer{buf.data(), buf.size()}, ec);
+	});
+}
+
+// Keeps connect_window connects in flight on one loop, closing each channel
+// as soon as it connects, until connects_per_client_loop have completed.
+class connect_storm : public std::enable_shared_from_this<connect_storm>
+{
+public:
+	connect_storm(praktor::ip::endpoint const& ep, client_stats& stats) : m_endpoint{ep}, m_stats{stats}, m_launched{0}
+	{}
+
+	void
+	launch(praktor::loop::ptr const& lp)
+	{
+		if (m_launched == connects_per_client_loop)
+		{
+			return;
+		}
+		++m_launched;
+		auto            self = shared_from_this();
+		std::error_code err;
+		lp->connect_channel(praktor::options{m_endpoint}, err, [self](channel::ptr const& chan, std::error_code const& ec) {
+			if (!ec)
+			{
+				++self->m_stats.m_connected;
+			}
+			auto lp = chan->loop();
+			chan->close();
+			self->launch(lp);
+		});
+	}
+
+private:
+	praktor::ip::endpoint m_endpoint;
+	client_stats&         m_stats;
+	std::size_t           m_launched;
+};
+
+// Sends one echo_message_size message, waits for all of it to come back,
+// and repeats until the benchmark is done.
+void
+start_echo_client(praktor::loop::ptr const& lp, praktor::ip::endpoint const& ep, client_stats& stats)
+{
+	static std::string const payload(echo_message_size, 'x');
+
+	std::error_code err;
+	lp->connect_channel(praktor::options{ep}, err, [&stats](channel::ptr const& chan, std::error_code const& ec) {
+		if (ec)
+		{
+			return;
+		}
+		auto outstanding = std::make_shared<std::size_t>(echo_message_size);
+		chan->start_read([&stats, outstanding](channel::ptr const& chan, util::const_buffer&& buf, std::error_code const& err) {
+			if (err)
+			{
+				chan->close();
+				return;
+			}
+			stats.m_echoed_bytes += buf.size();
+			*outstanding -= buf.size();
+			if (*outstanding == 0)
+			{
+				if (stats.m_done.load(std::memory_order_relaxed))
+				{
+					chan->close();
+					return;
+				}
+				*outstanding = echo_message_size;
+				chan->write(util::mutable_buffer{payload.data(), payload.size()});
+			}
+		});
+		chan->write(util::mutable_buffer{payload.data(), payload.size()});
+	});
+}
+
+template<class Predicate>
+bool
+wait_for(Predicate pred, std::chrono::seconds limit)
+{
+	auto deadline = std::chrono::steady_clock::now() + limit;
+	while (!pred())
+	{
+		if (std::chrono::steady_clock::now() > deadline)
+		{
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::microseconds{200});
+	}
+	return true;
+}
+
+void
+run_echo_bench(std::size_t shard_count)
+{
+	server_stats server;
+	client_stats clients;
+
+	auto server_group = praktor::loop_group::create(shard_count);
+	auto client_group = praktor::loop_group::create(shard_count);
+
+	auto acceptors = server_group->create_acceptors(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 0}},
+			[&server](acceptor::ptr const&, channel::ptr const& chan, std::error_code const& err) {
+				echo_on_connection(server, chan, err);
+			});
+	REQUIRE(acceptors.size() == shard_count);
+
+	std::promise<praktor::ip::endpoint> ep_promise;
+	server_group->dispatch_to(0, [&]() { ep_promise.set_value(acceptors[0]->get_endpoint()); });
+	auto ep = ep_promise.get_future().get();
+
+	// accept rate
+	auto        start         = std::chrono::steady_clock::now();
+	std::size_t total_connects = connects_per_client_loop * shard_count;
+	for (std::size_t i = 0; i < shard_count; ++i)
+	{
+		client_group->dispatch_to(i, [&ep, &clients](praktor::loop::ptr const& lp) {
+			auto storm = std::make_shared<connect_storm>(ep, clients);
+			for (std::size_t n = 0; n < connect_window; ++n)
+			{
+				storm->launch(lp);
+			}
+		});
+	}
+	CHECK(wait_for([&]() { return server.m_accepted.load() >= total_connects; }, std::chrono::seconds{30}));
+	double accept_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	// echo throughput
+	for (std::size_t i = 0; i < shard_count; ++i)
+	{
+		client_group->dispatch_to(i, [&ep, &clients](praktor::loop::ptr const& lp) {
+			for (std::size_t n = 0; n < echo_channels_per_loop; ++n)
+			{
+				start_echo_client(lp, ep, clients);
+			}
+		});
+	}
+	auto bytes_before = clients.m_echoed_bytes.load();
+	start             = std::chrono::steady_clock::now();
+	std::this_thread::sleep_for(echo_duration);
+	auto   echoed       = clients.m_echoed_bytes.load() - bytes_before;
+	double echo_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	clients.m_done      = true;
+
+	client_group->stop();
+	client_group->join();
+	server_group->stop();
+	server_group->join();
+
+	std::cout << "    " << shard_count << " loop(s): " << static_cast<std::size_t>(server.m_accepted / accept_seconds)
+			  << " accepts/s, " << static_cast<std::size_t>(echoed / echo_seconds / (1024 * 1024)) << " MiB/s echoed"
+			  << std::endl;
+}
+
+}    // namespace
+
+TEST_CASE("praktor::loop_group [ bench ] { sharded echo server }")
+{
+	std::cout << "sharded echo server, " << std::thread::hardware_concurrency() << " hardware threads, "
+			  << echo_channels_per_loop << " echo channels per loop, " << echo_message_size << " byte messages:"
+			  << std::endl;
+	for (std::size_t shard_count : {1, 2, 4})
+	{
+		run_echo_bench(shard_count);
+	}
+}
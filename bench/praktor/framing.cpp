@@ -0,0 +1,161 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <doctest.h>
+#include <endian.h>
+#include <iostream>
+#include <netinet/in.h>
+#include <praktor/loop.h>
+#include <praktor/tcp.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+constexpr std::uint16_t receiver_port   = 7010;
+constexpr std::size_t   send_chunk_size = 256 * 1024;
+constexpr auto          run_duration    = std::chrono::milliseconds{1000};
+
+// Whole frames, header and payload, repeated to fill at least one chunk.
+std::vector<char>
+make_frames(std::size_t frame_size)
+{
+	std::vector<char> frame(sizeof(std::uint64_t) + frame_size, 'x');
+	std::uint64_t     header = htobe64(frame_size);
+	std::memcpy(frame.data(), &header, sizeof(header));
+
+	std::vector<char> result;
+	do
+	{
+		result.insert(result.end(), frame.begin(), frame.end());
+	}
+	while (result.size() < send_chunk_size);
+	return result;
+}
+
+// Floods a framed acceptor from a plain socket on another thread, so the
+// sender does not share the receiver's loop.
+void
+run_frame_bench(std::size_t frame_size, bool batched)
+{
+	auto                  lp = praktor::loop::create();
+	praktor::ip::endpoint ep{praktor::ip::address::v4_loopback(), receiver_port};
+	std::size_t           frames{0};
+	std::size_t           bytes{0};
+
+	auto acceptor = lp->create_acceptor(
+			praktor::options{ep}.framing(true),
+			[&](praktor::acceptor::ptr const&, praktor::channel::ptr const& chan, std::error_code const& err) {
+				if (err)
+				{
+					return;
+				}
+				if (batched)
+				{
+					chan->start_read_batch([&](praktor::channel::ptr const&,
+											   util::const_buffer*   bufs,
+											   std::size_t           count,
+											   std::error_code const& err) {
+						frames += count;
+						for (std::size_t i = 0; i < count; ++i)
+						{
+							bytes += bufs[i].size();
+						}
+					});
+					return;
+				}
+				chan->start_read([&](praktor::channel::ptr const&, util::const_buffer&& buf, std::error_code const& err) {
+					if (!err)
+					{
+						++frames;
+						bytes += buf.size();
+					}
+				});
+			});
+
+	int         sock = ::socket(AF_INET, SOCK_STREAM, 0);
+	sockaddr_in addr{};
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(receiver_port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	std::atomic<bool> running{true};
+	std::thread       sender([&]() {
+        if (::connect(sock, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+        {
+            return;
+        }
+        auto data = make_frames(frame_size);
+        while (running)
+        {
+            if (::send(sock, data.data(), data.size(), MSG_NOSIGNAL) < 0)
+            {
+                return;
+            }
+        }
+    });
+
+	auto start = std::chrono::steady_clock::now();
+	lp->schedule(run_duration, [](praktor::loop::ptr const& lp) { lp->stop(); });
+	lp->run();
+	auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	running = false;
+	::shutdown(sock, SHUT_RDWR);
+	sender.join();
+	::close(sock);
+	acceptor->close();
+	lp->close();
+
+	std::cout << "    " << frame_size << " byte frames: " << static_cast<std::size_t>(frames / seconds) << " frames/s, "
+			  << static_cast<std::size_t>(bytes / seconds / (1024 * 1024)) << " MiB/s" << std::endl;
+}
+
+}    // namespace
+
+TEST_CASE("praktor::tcp_framed_channel [ bench ] { framed read throughput }")
+{
+	std::cout << "framed reads, tcp loopback:" << std::endl;
+	for (std::size_t frame_size : {64, 1024, 4096, 64 * 1024, 1024 * 1024})
+	{
+		run_frame_bench(frame_size, false);
+	}
+}
+
+TEST_CASE("praktor::tcp_framed_channel [ bench ] { batched framed read throughput }")
+{
+	std::cout << "batched framed reads, tcp loopback:" << std::endl;
+	for (std::size_t frame_size : {64, 1024, 4096})
+	{
+		run_frame_bench(frame_size, true);
+	}
+}
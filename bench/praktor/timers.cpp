@@ -0,0 +1,181 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <doctest.h>
+#include <iostream>
+#include <praktor/loop.h>
+#include <vector>
+
+namespace
+{
+
+constexpr std::size_t cycle_count      = 1000000;
+constexpr std::size_t background_count = 10000;    // long timeouts left armed throughout, as on a busy server
+constexpr std::size_t handle_count     = 1024;
+constexpr auto        idle_timeout     = std::chrono::seconds{30};
+
+constexpr std::size_t jitter_sample_count = 5000;
+
+template<class Cycle>
+double
+run_cycles(Cycle cycle)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (std::size_t n = 0; n < cycle_count; ++n)
+	{
+		cycle(n);
+	}
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	return static_cast<double>(cycle_count) / std::chrono::duration<double>(elapsed).count();
+}
+
+// Chains sample_count timeouts, each armed by its predecessor's handler,
+// and returns how late each one ran, sorted.
+template<class Arm>
+std::vector<std::chrono::microseconds>
+measure_lateness(praktor::loop::ptr const& lp, std::size_t sample_count, Arm arm)
+{
+	using clock = std::chrono::steady_clock;
+
+	std::vector<std::chrono::microseconds> lateness;
+	lateness.reserve(sample_count);
+
+	praktor::unique_function<void()> next;
+	next = [&]() {
+		arm([&](clock::time_point deadline) {
+			lateness.push_back(std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - deadline));
+			if (lateness.size() < sample_count)
+			{
+				next();
+			}
+			else
+			{
+				lp->stop();
+			}
+		});
+	};
+	next();
+	lp->run();
+
+	std::sort(lateness.begin(), lateness.end());
+	return lateness;
+}
+
+void
+report_lateness(char const* label, std::vector<std::chrono::microseconds> const& lateness)
+{
+	auto percentile = [&](double p) {
+		return lateness[std::min(lateness.size() - 1, static_cast<std::size_t>(p * lateness.size()))].count();
+	};
+	std::cout << "    " << label << "p50 " << percentile(0.50) << " us, p99 " << percentile(0.99) << " us, p999 "
+			  << percentile(0.999) << " us, min " << lateness.front().count() << " us" << std::endl;
+}
+
+}    // namespace
+
+TEST_CASE("praktor::loop [ bench ] { timeout arm/cancel }")
+{
+	auto        lp = praktor::loop::create();
+	std::size_t fired{0};
+
+	std::vector<praktor::timer::ptr> background_timers;
+	std::vector<praktor::timer::ptr> timers;
+	for (std::size_t i = 0; i < background_count; ++i)
+	{
+		background_timers.emplace_back(lp->create_timer([&]() { ++fired; }));
+		background_timers.back()->start(idle_timeout + std::chrono::milliseconds{i});
+	}
+	for (std::size_t i = 0; i < handle_count; ++i)
+	{
+		timers.emplace_back(lp->create_timer([&]() { ++fired; }));
+	}
+
+	auto timer_rate = run_cycles([&](std::size_t n) {
+		auto& tp = timers[n % handle_count];
+		tp->start(idle_timeout + std::chrono::milliseconds{n % 1000});
+		tp->stop();
+	});
+
+	for (auto& tp : background_timers)
+	{
+		tp->close();
+	}
+	for (auto& tp : timers)
+	{
+		tp->close();
+	}
+
+	for (std::size_t i = 0; i < background_count; ++i)
+	{
+		lp->set_timeout(idle_timeout + std::chrono::milliseconds{i}, [&]() { ++fired; });
+	}
+
+	auto timeout_rate = run_cycles([&](std::size_t n) {
+		auto to = lp->set_timeout(idle_timeout + std::chrono::milliseconds{n % 1000}, [&]() { ++fired; });
+		to.cancel();
+	});
+
+	std::vector<praktor::timeout> timeouts;
+	for (std::size_t i = 0; i < handle_count; ++i)
+	{
+		timeouts.emplace_back(lp->set_timeout(idle_timeout, [&]() { ++fired; }));
+	}
+	auto restart_rate = run_cycles([&](std::size_t n) {
+		timeouts[n % handle_count].restart(idle_timeout + std::chrono::milliseconds{n % 1000});
+	});
+
+	CHECK(fired == 0);
+	std::cout << "timeout arm/cancel, " << background_count << " others pending:" << std::endl;
+	std::cout << "    timer start/stop:       " << static_cast<std::size_t>(timer_rate) << " cycles/s" << std::endl;
+	std::cout << "    set_timeout/cancel:     " << static_cast<std::size_t>(timeout_rate) << " cycles/s" << std::endl;
+	std::cout << "    timeout restart:        " << static_cast<std::size_t>(restart_rate) << " cycles/s" << std::endl;
+	std::cout << "    speedup (arm/cancel):   " << timeout_rate / timer_rate << "x" << std::endl;
+	lp->close();
+}
+
+TEST_CASE("praktor::loop [ bench ] { timeout jitter }")
+{
+	using clock = std::chrono::steady_clock;
+
+	auto lp = praktor::loop::create();
+
+	auto precise = measure_lateness(lp, jitter_sample_count, [&](auto on_fire) {
+		auto deadline = clock::now() + std::chrono::microseconds{100};
+		lp->set_precise_timeout(deadline, [=]() mutable { on_fire(deadline); });
+	});
+
+	auto wheel = measure_lateness(lp, jitter_sample_count / 5, [&](auto on_fire) {
+		auto deadline = clock::now() + std::chrono::milliseconds{1};
+		lp->set_timeout(std::chrono::milliseconds{1}, [=]() mutable { on_fire(deadline); });
+	});
+
+	CHECK(precise.front().count() >= 0);
+	std::cout << "timeout lateness:" << std::endl;
+	report_lateness("set_precise_timeout(100 us): ", precise);
+	report_lateness("set_timeout(1 ms):           ", wheel);
+	lp->close();
+}
@@ -0,0 +1,317 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <doctest.h>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <praktor/loop.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+
+constexpr std::uint16_t receiver_port = 7010;
+constexpr std::uint16_t sink_port     = 7011;
+constexpr std::size_t   fanout_size   = 1000;
+constexpr std::size_t   segment_size  = 1200;
+constexpr std::size_t   segment_count = 50;
+constexpr std::size_t   datagram_size = 64;
+constexpr std::size_t   batch_size    = 16;
+constexpr auto          run_duration  = std::chrono::milliseconds{1000};
+
+enum class receive_mode
+{
+	single,
+	batched_per_datagram,
+	batched_per_batch
+};
+
+// Floods the receiver from a plain socket so the sender does not share the
+// receiver's loop.
+std::size_t
+flood(std::atomic<bool>& done)
+{
+	int         sock = ::socket(AF_INET, SOCK_DGRAM, 0);
+	sockaddr_in dest{};
+	dest.sin_family      = AF_INET;
+	dest.sin_port        = htons(receiver_port);
+	dest.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	char        payload[datagram_size] = {};
+	std::size_t sent{0};
+	while (!done.load(std::memory_order_relaxed))
+	{
+		if (::sendto(sock, payload, sizeof(payload), 0, reinterpret_cast<sockaddr*>(&dest), sizeof(dest)) > 0)
+		{
+			++sent;
+		}
+	}
+	::close(sock);
+	return sent;
+}
+
+void
+run_receive_bench(receive_mode mode, char const* label)
+{
+	auto        lp = praktor::loop::create();
+	std::size_t received{0};
+	std::size_t callbacks{0};
+
+	praktor::options opts{praktor::ip::endpoint{praktor::ip::address::v4_loopback(), receiver_port}};
+	if (mode != receive_mode::single)
+	{
+		opts.receive_batch(batch_size);
+	}
+
+	auto recvr = lp->create_transceiver(opts);
+	if (mode == receive_mode::batched_per_batch)
+	{
+		recvr->start_receive([&](praktor::transceiver::ptr const&,
+								 std::vector<praktor::received_datagram>& batch,
+								 std::error_code const&) {
+			received += batch.size();
+			++callbacks;
+		});
+	}
+	else
+	{
+		recvr->start_receive(
+				[&](praktor::transceiver::ptr const&, util::const_buffer&&, praktor::ip::endpoint const&, std::error_code const&) {
+					++received;
+					++callbacks;
+				});
+	}
+
+	std::atomic<bool> done{false};
+	std::size_t       sent{0};
+	std::thread       sender([&]() { sent = flood(done); });
+
+	auto start = std::chrono::steady_clock::now();
+	lp->schedule(run_duration, [](praktor::loop::ptr const& lp) { lp->stop(); });
+	lp->run();
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	done = true;
+	sender.join();
+	recvr->close();
+	lp->run_nowait();
+	lp->close();
+
+	std::cout << "    " << label << static_cast<std::size_t>(received / elapsed) << " datagrams/s, "
+			  << static_cast<std::size_t>(callbacks / elapsed) << " callbacks/s (" << sent << " sent)" << std::endl;
+}
+
+enum class send_mode
+{
+	per_datagram,
+	batched
+};
+
+// Sends rounds of fanout_size datagrams, starting each round when the
+// previous one has completed. The sink never reads; loopback drops what
+// overflows its receive buffer without failing the send.
+void
+run_send_bench(send_mode mode, char const* label)
+{
+	int         sink = ::socket(AF_INET, SOCK_DGRAM, 0);
+	sockaddr_in addr{};
+	addr.sin_family      = AF_INET;
+	addr.sin_port        = htons(sink_port);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	::bind(sink, reinterpret_cast<sockaddr*>(&addr), sizeof(addr));
+
+	auto lp    = praktor::loop::create();
+	auto trans = lp->create_transceiver(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 0}});
+
+	praktor::ip::endpoint dest{praktor::ip::address::v4_loopback(), sink_port};
+	std::size_t           sent{0};
+	bool                  running{true};
+
+	std::function<void()> send_round = [&]() {
+		if (!running)
+		{
+			return;
+		}
+		if (mode == send_mode::batched)
+		{
+			std::vector<praktor::outgoing_datagram> batch(fanout_size);
+			for (auto& dgram : batch)
+			{
+				dgram.buffer = util::mutable_buffer{datagram_size};
+				dgram.buffer.fill(0);
+				dgram.destination = dest;
+			}
+			trans->emit_batch(
+					std::move(batch),
+					[&](praktor::transceiver::ptr const&, std::vector<praktor::outgoing_datagram>&& batch, std::error_code const&) {
+						sent += batch.size();
+						send_round();
+					});
+		}
+		else
+		{
+			auto pending = std::make_shared<std::size_t>(fanout_size);
+			for (std::size_t i = 0; i < fanout_size; ++i)
+			{
+				util::mutable_buffer msg{datagram_size};
+				msg.fill(0);
+				trans->emit(
+						std::move(msg),
+						dest,
+						[&, pending](praktor::transceiver::ptr const&, util::mutable_buffer&&, praktor::ip::endpoint const&, std::error_code) {
+							++sent;
+							if (--*pending == 0)
+							{
+								send_round();
+							}
+						});
+			}
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	lp->schedule(run_duration, [&](praktor::loop::ptr const& lp) {
+		running = false;
+		lp->stop();
+	});
+	send_round();
+	lp->run();
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	trans->close();
+	lp->run_nowait();
+	lp->close();
+	::close(sink);
+
+	std::cout << "    " << label << static_cast<std::size_t>(sent / elapsed) << " datagrams/s" << std::endl;
+}
+
+// Streams runs of segment_count datagrams to a receiver on the same loop,
+// starting each run when the previous one has been sent, and counts what
+// the receiver gets.
+void
+run_segment_bench(bool gso, bool gro, char const* label)
+{
+	auto lp = praktor::loop::create();
+
+	std::size_t received{0};
+	auto        recvr = lp->create_transceiver(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_loopback(), receiver_port}}.gro(gro));
+	recvr->start_receive(
+			[&](praktor::transceiver::ptr const&, std::vector<praktor::received_datagram>& batch, std::error_code const&) {
+				received += batch.size();
+			});
+
+	auto trans = lp->create_transceiver(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 0}});
+
+	praktor::ip::endpoint dest{praktor::ip::address::v4_loopback(), receiver_port};
+	bool                  running{true};
+
+	std::function<void()> send_run = [&]() {
+		if (!running)
+		{
+			return;
+		}
+		if (gso)
+		{
+			util::mutable_buffer msg{segment_size * segment_count};
+			msg.fill(0);
+			trans->emit_segmented(
+					std::move(msg),
+					segment_size,
+					dest,
+					[&](praktor::transceiver::ptr const&, util::mutable_buffer&&, praktor::ip::endpoint const&, std::error_code) {
+						send_run();
+					});
+		}
+		else
+		{
+			std::vector<praktor::outgoing_datagram> batch(segment_count);
+			for (auto& dgram : batch)
+			{
+				dgram.buffer = util::mutable_buffer{segment_size};
+				dgram.buffer.fill(0);
+				dgram.destination = dest;
+			}
+			trans->emit_batch(
+					std::move(batch),
+					[&](praktor::transceiver::ptr const&, std::vector<praktor::outgoing_datagram>&&, std::error_code const&) {
+						send_run();
+					});
+		}
+	};
+
+	auto start = std::chrono::steady_clock::now();
+	lp->schedule(run_duration, [&](praktor::loop::ptr const& lp) {
+		running = false;
+		lp->stop();
+	});
+	send_run();
+	lp->run();
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	trans->close();
+	recvr->close();
+	lp->run_nowait();
+	lp->close();
+
+	std::cout << "    " << label << static_cast<std::size_t>(received / elapsed) << " datagrams/s received"
+			  << std::endl;
+}
+
+}    // namespace
+
+TEST_CASE("praktor::transceiver [ bench ] { batched receive }")
+{
+	std::cout << "udp receive, " << datagram_size << " byte datagrams, batch size " << batch_size << ":" << std::endl;
+	run_receive_bench(receive_mode::single, "recvmsg:                        ");
+	run_receive_bench(receive_mode::batched_per_datagram, "recvmmsg, handler per datagram: ");
+	run_receive_bench(receive_mode::batched_per_batch, "recvmmsg, handler per batch:    ");
+}
+
+TEST_CASE("praktor::transceiver [ bench ] { batched send }")
+{
+	std::cout << "udp send, " << datagram_size << " byte datagrams, " << fanout_size << " per round:" << std::endl;
+	run_send_bench(send_mode::per_datagram, "emit per datagram: ");
+	run_send_bench(send_mode::batched, "emit_batch:        ");
+}
+
+TEST_CASE("praktor::transceiver [ bench ] { segmentation offload }")
+{
+	std::cout << "udp loopback, " << segment_size << " byte datagrams, " << segment_count << " per run:" << std::endl;
+	run_segment_bench(false, false, "sendmmsg, no GRO: ");
+	run_segment_bench(true, false, "GSO, no GRO:      ");
+	run_segment_bench(false, true, "sendmmsg, GRO:    ");
+	run_segment_bench(true, true, "GSO, GRO:         ");
+}
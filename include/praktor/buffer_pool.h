@@ -0,0 +1,125 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef PRAKTOR_BUFFER_POOL_H
+#define PRAKTOR_BUFFER_POOL_H
+
+#include <cstddef>
+
+
+namespace praktor
+{
+
+/** \brief Configuration for a loop's read buffer pool.
+ *
+ * Each loop recycles the blocks that stream reads land in. Blocks come in
+ * power-of-two size classes from min_block_size to max_block_size; a
+ * request is served from the smallest class that fits it. Requests larger
+ * than max_block_size are allocated and freed without pooling. At most
+ * max_cached_blocks blocks are kept per size class; blocks returned beyond
+ * that are freed. read_size is the block size requested for each read,
+ * overriding libuv's suggested size.
+ */
+class buffer_pool_config
+{
+public:
+	buffer_pool_config()
+		: m_min_block_size{2048}, m_max_block_size{65536}, m_max_cached_blocks{64}, m_read_size{65536}
+	{}
+
+	buffer_pool_config&
+	min_block_size(std::size_t value)
+	{
+		m_min_block_size = value;
+		return *this;
+	}
+
+	std::size_t
+	min_block_size() const
+	{
+		return m_min_block_size;
+	}
+
+	buffer_pool_config&
+	max_block_size(std::size_t value)
+	{
+		m_max_block_size = value;
+		return *this;
+	}
+
+	std::size_t
+	max_block_size() const
+	{
+		return m_max_block_size;
+	}
+
+	buffer_pool_config&
+	max_cached_blocks(std::size_t value)
+	{
+		m_max_cached_blocks = value;
+		return *this;
+	}
+
+	std::size_t
+	max_cached_blocks() const
+	{
+		return m_max_cached_blocks;
+	}
+
+	buffer_pool_config&
+	read_size(std::size_t value)
+	{
+		m_read_size = value;
+		return *this;
+	}
+
+	std::size_t
+	read_size() const
+	{
+		return m_read_size;
+	}
+
+private:
+	std::size_t m_min_block_size;
+	std::size_t m_max_block_size;
+	std::size_t m_max_cached_blocks;
+	std::size_t m_read_size;
+};
+
+/** \brief A snapshot of a loop's read buffer pool counters.
+ */
+struct buffer_pool_stats
+{
+	std::size_t allocations;      ///< blocks handed out
+	std::size_t cache_hits;       ///< allocations served from a cached block
+	std::size_t returns;          ///< blocks given back by released buffers
+	std::size_t frees;            ///< returned blocks freed instead of cached
+	std::size_t outstanding;      ///< blocks currently held by buffers
+	std::size_t cached_blocks;    ///< blocks waiting for reuse
+	std::size_t cached_bytes;     ///< capacity of the blocks waiting for reuse
+};
+
+}    // namespace praktor
+
+#endif    // PRAKTOR_BUFFER_POOL_H
@@ -27,9 +27,9 @@
 
 #include <chrono>
 #include <deque>
-#include <functional>
 #include <praktor/endpoint.h>
 #include <praktor/options.h>
+#include <praktor/unique_function.h>
 #include <util/buffer.h>
 #include <util/shared_ptr.h>
 #include <memory>
@@ -46,17 +46,28 @@ class channel
 public:
 	using ptr = util::shared_ptr<channel>;
 
-	using read_handler = std::function<void(channel::ptr const& chan, util::const_buffer&& buf, std::error_code const& err)>;
+	using read_handler = unique_function<void(channel::ptr const& chan, util::const_buffer&& buf, std::error_code const& err)>;
+
+	/** \brief Receives the count buffers at bufs; count is zero when err reports a failure.
+	 *
+	 * The buffers may be moved from; the array is only valid during the call.
+	 */
+	using read_batch_handler = unique_function<
+			void(channel::ptr const& chan, util::const_buffer* bufs, std::size_t count, std::error_code const& err)>;
 
 	using write_buffer_handler
-			= std::function<void(channel::ptr const& chan, util::mutable_buffer&& buf, std::error_code const& err)>;
+			= unique_function<void(channel::ptr const& chan, util::mutable_buffer&& buf, std::error_code const& err)>;
 
-	using write_buffers_handler = std::function<
+	using write_buffers_handler = unique_function<
 			void(channel::ptr const& chan, std::deque<util::mutable_buffer>&& bufs, std::error_code const& err)>;
 
-	using connect_handler = std::function<void(channel::ptr const& chan, std::error_code const& err)>;
+	using connect_handler = unique_function<void(channel::ptr const& chan, std::error_code const& err)>;
+
+	using close_handler = unique_function<void(channel::ptr const& chan)>;
 
-	using close_handler = std::function<void(channel::ptr const& chan)>;
+	using pressure_handler = unique_function<void(channel::ptr const& chan, std::size_t queued)>;
+
+	using drain_handler = unique_function<void(channel::ptr const& chan)>;
 
 	virtual ~channel() {}
 
@@ -77,6 +88,29 @@ public:
 		}
 	}
 
+	/** \brief Starts reading, delivering everything one read produces in a single call.
+	 *
+	 * A framed channel passes every frame completed by one read of the
+	 * socket together, in order; an unframed channel passes each read as a
+	 * batch of one. Replaces any handler set by start_read(), and vice versa.
+	 */
+	void
+	start_read_batch(std::error_code& err, read_batch_handler handler)
+	{
+		really_start_read_batch(err, std::move(handler));
+	}
+
+	void
+	start_read_batch(read_batch_handler handler)
+	{
+		std::error_code err;
+		really_start_read_batch(err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
 	virtual void
 	stop_read()
 			= 0;
@@ -193,11 +227,45 @@ public:
 	virtual std::size_t
 	get_queue_size() const = 0;
 
+	/** \brief Sets the handler called when queued writes reach the high watermark.
+	 *
+	 * The handler is called from within the write that crossed the
+	 * watermark, with the number of bytes queued, after the pressure
+	 * policy has been applied. See options::write_watermarks().
+	 */
+	void
+	on_pressure(pressure_handler handler)
+	{
+		set_pressure_handler(std::move(handler));
+	}
+
+	/** \brief Sets the handler called when a channel under pressure drains to the low watermark.
+	 *
+	 * The handler is called after the handler of the write that brought the
+	 * queue down, once the pressure policy has been lifted.
+	 */
+	void
+	on_drain(drain_handler handler)
+	{
+		set_drain_handler(std::move(handler));
+	}
+
+	virtual bool
+	is_under_pressure() const = 0;
+
 protected:
 	virtual void
 	set_close_handler(close_handler&& handler)
 			= 0;
 
+	virtual void
+	set_pressure_handler(pressure_handler&& handler)
+			= 0;
+
+	virtual void
+	set_drain_handler(drain_handler&& handler)
+			= 0;
+
 	virtual void
 	really_write(util::mutable_buffer&& buf, std::error_code& err, write_buffer_handler&& handler)
 			= 0;
@@ -218,6 +286,10 @@ protected:
 	really_start_read(std::error_code& err, read_handler&& handler)
 			= 0;
 
+	virtual void
+	really_start_read_batch(std::error_code& err, read_batch_handler&& handler)
+			= 0;
+
 };
 
 class acceptor
@@ -225,8 +297,14 @@ class acceptor
 public:
 	using ptr = util::shared_ptr<acceptor>;
 	using connection_handler
-			= std::function<void(acceptor::ptr const& sp, channel::ptr const& chan, std::error_code const& err)>;
-	using close_handler = std::function<void(acceptor::ptr const& lp)>;
+			= unique_function<void(acceptor::ptr const& sp, channel::ptr const& chan, std::error_code const& err)>;
+	using close_handler = unique_function<void(acceptor::ptr const& lp)>;
+
+	/** \brief Chooses the loop that will own the next accepted channel.
+	 *
+	 * Invoked on the acceptor's loop once per accepted connection.
+	 */
+	using loop_selector = unique_function<std::shared_ptr<praktor::loop>()>;
 
 	virtual ~acceptor() {}
 
@@ -271,6 +349,34 @@ public:
 
 	}
 
+	/** \brief Listens, handing each accepted connection off to another loop.
+	 *
+	 * For every connection, selector picks a target loop. The socket is
+	 * accepted on the acceptor's loop, then re-opened on the target loop,
+	 * where the channel lives from then on and where handler is invoked.
+	 * Because the target loops may run on different threads, handler may be
+	 * invoked concurrently, and may still be invoked for connections already
+	 * in flight when the acceptor is closed. If the selected loop cannot
+	 * take the connection, handler is invoked on the acceptor's loop with
+	 * the error.
+	 */
+	void
+	listen(std::error_code& err, loop_selector selector, connection_handler handler)
+	{
+		really_listen(err, std::move(selector), std::move(handler));
+	}
+
+	void
+	listen(loop_selector selector, connection_handler handler)
+	{
+		std::error_code err;
+		really_listen(err, std::move(selector), std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
 	bool
 	close()
 	{
@@ -312,6 +418,9 @@ protected:
 
 	virtual void
 	really_listen(std::error_code& err, connection_handler&& handler) = 0;
+
+	virtual void
+	really_listen(std::error_code& err, loop_selector&& selector, connection_handler&& handler) = 0;
 };
 
 }    // namespace praktor
@@ -77,6 +77,8 @@ enum class errc
 	ill_formed_address,
 	loop_closed,
 	timer_closed,
+	write_queue_full,
+	frame_too_large,
 };
 
 std::error_category const&
@@ -26,12 +26,14 @@
 #define PRAKTOR_LOOP_H
 
 #include <chrono>
-#include <functional>
+#include <praktor/buffer_pool.h>
 #include <praktor/channel.h>
 #include <praktor/endpoint.h>
 #include <praktor/options.h>
+#include <praktor/timeout.h>
 #include <praktor/timer.h>
 #include <praktor/transceiver.h>
+#include <praktor/unique_function.h>
 #include <util/promise.h>
 #include <memory>
 #include <system_error>
@@ -40,16 +42,24 @@
 namespace praktor
 {
 
+/** \brief A snapshot of a loop's counters for pooled write, send, connect and resolve requests.
+ */
+struct request_pool_stats
+{
+	std::size_t requests;      ///< requests created
+	std::size_t cache_hits;    ///< requests served from a cached block
+};
+
 class loop
 {
 public:
 	using ptr             = std::shared_ptr<loop>;
-	using resolve_handler = std::function<
+	using resolve_handler = unique_function<
 			void(std::string const& hostname, std::deque<ip::address>&& addresses, std::error_code const& err)>;
-	using dispatch_handler       = std::function<void(loop::ptr const&)>;
-	using dispatch_void_handler  = std::function<void()>;
-	using scheduled_handler      = std::function<void(loop::ptr const&)>;
-	using scheduled_void_handler = std::function<void()>;
+	using dispatch_handler       = unique_function<void(loop::ptr const&)>;
+	using dispatch_void_handler  = unique_function<void()>;
+	using scheduled_handler      = unique_function<void(loop::ptr const&)>;
+	using scheduled_void_handler = unique_function<void()>;
 
 	static loop::ptr
 	create();
@@ -184,14 +194,14 @@ public:
 	void
 	schedule(std::chrono::milliseconds timeout, std::error_code& err, scheduled_handler handler)
 	{
-		really_schedule(timeout, err, std::move(handler));
+		really_schedule(timeout, std::chrono::milliseconds{0}, err, std::move(handler));
 	}
 
 	void
 	schedule(std::chrono::milliseconds timeout, scheduled_handler handler)
 	{
 		std::error_code err;
-		really_schedule(timeout, err, std::move(handler));
+		really_schedule(timeout, std::chrono::milliseconds{0}, err, std::move(handler));
 		if (err)
 		{
 			throw std::system_error{err};
@@ -201,18 +211,186 @@ public:
 	void
 	schedule(std::chrono::milliseconds timeout, std::error_code& err, scheduled_void_handler handler)
 	{
-		really_schedule_void(timeout, err, std::move(handler));
+		really_schedule_void(timeout, std::chrono::milliseconds{0}, err, std::move(handler));
 	}
 
 	void
 	schedule(std::chrono::milliseconds timeout, scheduled_void_handler handler)
 	{
 		std::error_code err;
-		really_schedule_void(timeout, err, std::move(handler));
+		really_schedule_void(timeout, std::chrono::milliseconds{0}, err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	/** \brief Like schedule(), but lets the handler run up to slack late.
+	 *
+	 * The handler never runs before timeout; see timer::start() for how
+	 * slack lets nearby expirations share a wakeup.
+	 */
+	void
+	schedule(
+			std::chrono::milliseconds timeout,
+			std::chrono::milliseconds slack,
+			std::error_code&          err,
+			scheduled_handler         handler)
+	{
+		really_schedule(timeout, slack, err, std::move(handler));
+	}
+
+	void
+	schedule(std::chrono::milliseconds timeout, std::chrono::milliseconds slack, scheduled_handler handler)
+	{
+		std::error_code err;
+		really_schedule(timeout, slack, err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	void
+	schedule(
+			std::chrono::milliseconds timeout,
+			std::chrono::milliseconds slack,
+			std::error_code&          err,
+			scheduled_void_handler    handler)
+	{
+		really_schedule_void(timeout, slack, err, std::move(handler));
+	}
+
+	void
+	schedule(std::chrono::milliseconds timeout, std::chrono::milliseconds slack, scheduled_void_handler handler)
+	{
+		std::error_code err;
+		really_schedule_void(timeout, slack, err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	/** \brief Runs handler every interval until the returned timer is stopped or closed.
+	 *
+	 * The first run is interval from now. The handler is kept for the life of
+	 * the timer rather than re-created each tick; see timer::periodic_mode
+	 * for how later runs are placed.
+	 */
+	timer::ptr
+	schedule_every(
+			std::chrono::milliseconds interval,
+			std::error_code&          err,
+			scheduled_handler         handler,
+			timer::periodic_mode      mode = timer::periodic_mode::fixed_delay)
+	{
+		return really_schedule_every(interval, mode, err, std::move(handler));
+	}
+
+	timer::ptr
+	schedule_every(
+			std::chrono::milliseconds interval,
+			scheduled_handler         handler,
+			timer::periodic_mode      mode = timer::periodic_mode::fixed_delay)
+	{
+		std::error_code err;
+		auto            result = really_schedule_every(interval, mode, err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+		return result;
+	}
+
+	timer::ptr
+	schedule_every(
+			std::chrono::milliseconds interval,
+			std::error_code&          err,
+			scheduled_void_handler    handler,
+			timer::periodic_mode      mode = timer::periodic_mode::fixed_delay)
+	{
+		return really_schedule_every_void(interval, mode, err, std::move(handler));
+	}
+
+	timer::ptr
+	schedule_every(
+			std::chrono::milliseconds interval,
+			scheduled_void_handler    handler,
+			timer::periodic_mode      mode = timer::periodic_mode::fixed_delay)
+	{
+		std::error_code err;
+		auto            result = really_schedule_every_void(interval, mode, err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+		return result;
+	}
+
+	/** \brief Arms handler to run once, delay from now, on the loop's timing wheel.
+	 *
+	 * Unlike schedule() and create_timer(), arming and cancelling cost O(1)
+	 * and allocate nothing in steady state, which suits per-connection
+	 * timeouts that are almost always cancelled before they fire. Resolution
+	 * is one millisecond. Must be called on the loop's thread.
+	 */
+	timeout
+	set_timeout(std::chrono::milliseconds delay, std::error_code& err, timeout::handler handler)
+	{
+		return really_set_timeout(delay, err, std::move(handler));
+	}
+
+	timeout
+	set_timeout(std::chrono::milliseconds delay, timeout::handler handler)
+	{
+		std::error_code err;
+		auto            result = really_set_timeout(delay, err, std::move(handler));
 		if (err)
 		{
 			throw std::system_error{err};
 		}
+		return result;
+	}
+
+	/** \brief Arms handler to run once at deadline, with microsecond resolution.
+	 *
+	 * Deadlines are on std::chrono::steady_clock; the handler never runs
+	 * before its deadline. Where the loop cannot wait on a high-resolution
+	 * clock (anything but Linux, which uses a timerfd), waits are rounded up
+	 * to libuv's whole milliseconds. Arming and cancelling cost O(log n) in
+	 * the number of pending precise timeouts, so prefer set_timeout() for
+	 * timeouts that do not need better than millisecond resolution. Must be
+	 * called on the loop's thread.
+	 */
+	timeout
+	set_precise_timeout(std::chrono::steady_clock::time_point deadline, std::error_code& err, timeout::handler handler)
+	{
+		return really_set_precise_timeout(deadline, err, std::move(handler));
+	}
+
+	timeout
+	set_precise_timeout(std::chrono::steady_clock::time_point deadline, timeout::handler handler)
+	{
+		std::error_code err;
+		auto            result = really_set_precise_timeout(deadline, err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+		return result;
+	}
+
+	timeout
+	set_precise_timeout(std::chrono::microseconds delay, std::error_code& err, timeout::handler handler)
+	{
+		return really_set_precise_timeout(std::chrono::steady_clock::now() + delay, err, std::move(handler));
+	}
+
+	timeout
+	set_precise_timeout(std::chrono::microseconds delay, timeout::handler handler)
+	{
+		return set_precise_timeout(std::chrono::steady_clock::now() + delay, std::move(handler));
 	}
 
 	timer::ptr
@@ -376,6 +554,59 @@ public:
 		}
 	}
 
+	/** \brief Reconfigures the pool that stream reads on this loop draw from.
+	 *
+	 * Must be called on the loop's thread, or while the loop is not running.
+	 * Cached blocks are freed; blocks still held by buffers are freed or
+	 * recycled under the new configuration as they are released.
+	 */
+	void
+	configure_buffer_pool(buffer_pool_config const& config, std::error_code& err)
+	{
+		really_configure_buffer_pool(config, err);
+	}
+
+	void
+	configure_buffer_pool(buffer_pool_config const& config)
+	{
+		std::error_code err;
+		really_configure_buffer_pool(config, err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	/** \brief Returns the read buffer pool's counters.
+	 *
+	 * Must be called on the loop's thread, or while the loop is not running.
+	 */
+	buffer_pool_stats
+	get_buffer_pool_stats()
+	{
+		return really_get_buffer_pool_stats();
+	}
+
+	/** \brief Returns the request pool's counters.
+	 *
+	 * Must be called on the loop's thread, or while the loop is not running.
+	 */
+	request_pool_stats
+	get_request_pool_stats()
+	{
+		return really_get_request_pool_stats();
+	}
+
+	/** \brief Returns the counters for timers made by create_timer() and schedule().
+	 *
+	 * Must be called on the loop's thread, or while the loop is not running.
+	 */
+	timer_stats
+	get_timer_stats()
+	{
+		return really_get_timer_stats();
+	}
+
 	virtual bool
 	is_alive() const = 0;
 
@@ -421,11 +652,46 @@ protected:
 			= 0;
 
 	virtual void
-	really_schedule(std::chrono::milliseconds timeout, std::error_code& err, scheduled_handler&& handler)
+	really_schedule(
+			std::chrono::milliseconds timeout,
+			std::chrono::milliseconds slack,
+			std::error_code&          err,
+			scheduled_handler&&       handler)
 			= 0;
 
 	virtual void
-	really_schedule_void(std::chrono::milliseconds timeout, std::error_code& err, scheduled_void_handler&& handler)
+	really_schedule_void(
+			std::chrono::milliseconds timeout,
+			std::chrono::milliseconds slack,
+			std::error_code&          err,
+			scheduled_void_handler&&  handler)
+			= 0;
+
+	virtual timer::ptr
+	really_schedule_every(
+			std::chrono::milliseconds interval,
+			timer::periodic_mode      mode,
+			std::error_code&          err,
+			scheduled_handler&&       handler)
+			= 0;
+
+	virtual timer::ptr
+	really_schedule_every_void(
+			std::chrono::milliseconds interval,
+			timer::periodic_mode      mode,
+			std::error_code&          err,
+			scheduled_void_handler&&  handler)
+			= 0;
+
+	virtual timeout
+	really_set_timeout(std::chrono::milliseconds delay, std::error_code& err, timeout::handler&& handler)
+			= 0;
+
+	virtual timeout
+	really_set_precise_timeout(
+			std::chrono::steady_clock::time_point deadline,
+			std::error_code&                      err,
+			timeout::handler&&                    handler)
 			= 0;
 
 	virtual acceptor::ptr
@@ -451,6 +717,22 @@ protected:
 	virtual void
 	really_resolve(std::string const& hostname, std::error_code& err, resolve_handler&& handler)
 			= 0;
+
+	virtual void
+	really_configure_buffer_pool(buffer_pool_config const& config, std::error_code& err)
+			= 0;
+
+	virtual buffer_pool_stats
+	really_get_buffer_pool_stats()
+			= 0;
+
+	virtual request_pool_stats
+	really_get_request_pool_stats()
+			= 0;
+
+	virtual timer_stats
+	really_get_timer_stats()
+			= 0;
 };
 
 }    // namespace praktor
@@ -470,8 +752,11 @@ public:
 		p.cancel_timer();
 		if (p.m_shared)
 		{
+			// the loop's timing wheel recycles its entries, and a timeout handle
+			// is two trivially copyable words, which std::function stores
+			// without allocating
 			std::error_code err;
-			auto            tp = m_loop->create_timer(err, [p]() mutable {
+			auto            to = m_loop->set_timeout(m_timeout, err, [p]() mutable {
                 p.cancel_timer();
                 if (!p.is_finished())
                 {
@@ -479,9 +764,10 @@ public:
                 }
             });
 
-			p.m_shared->cancel_timer = [tp]() { tp->close(); };
-
-			tp->start(m_timeout, err);
+			if (!err)
+			{
+				p.m_shared->cancel_timer = [to]() mutable { to.cancel(); };
+			}
 		}
 	}
 
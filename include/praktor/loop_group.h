@@ -0,0 +1,260 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef PRAKTOR_LOOP_GROUP_H
+#define PRAKTOR_LOOP_GROUP_H
+
+#include <atomic>
+#include <praktor/loop.h>
+#include <memory>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+
+namespace praktor
+{
+
+/** \brief A fixed set of loops, each running on its own thread.
+ *
+ * A loop_group creates N loops and starts one thread per loop, optionally
+ * pinning thread i to CPU (i mod hardware_concurrency). The loops run until
+ * stop() is called; each thread then closes its own loop (closing any
+ * handles still open on it) and exits. join() waits for every thread.
+ *
+ * Loops are not thread-safe. Apart from dispatch_to(), which may be called
+ * from any thread, work must reach a loop by dispatching to it. stop() and
+ * join() must not be called from one of the group's own threads.
+ */
+class loop_group
+{
+public:
+	using ptr = std::shared_ptr<loop_group>;
+
+	enum class affinity
+	{
+		none,
+		pin_to_cores
+	};
+
+	static loop_group::ptr
+	create(std::size_t size, affinity aff, std::error_code& err);
+
+	static loop_group::ptr
+	create(std::size_t size, affinity aff = affinity::none)
+	{
+		std::error_code err;
+		auto            result = create(size, aff, err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+		return result;
+	}
+
+	~loop_group();
+
+	std::size_t
+	size() const
+	{
+		return m_loops.size();
+	}
+
+	loop::ptr const&
+	get(std::size_t index) const
+	{
+		return m_loops[index];
+	}
+
+	/** \brief Selects loops in round-robin order. Safe to call from any thread.
+	 */
+	loop::ptr const&
+	next()
+	{
+		return m_loops[m_next.fetch_add(1, std::memory_order_relaxed) % m_loops.size()];
+	}
+
+	/** \brief Selects a loop by hash, so equal keys always map to the same loop.
+	 */
+	loop::ptr const&
+	select(std::size_t hash) const
+	{
+		return m_loops[hash % m_loops.size()];
+	}
+
+	void
+	dispatch_to(std::size_t index, std::error_code& err, loop::dispatch_handler handler)
+	{
+		if (!check_index(index, err))
+		{
+			return;
+		}
+		m_loops[index]->dispatch(err, std::move(handler));
+	}
+
+	void
+	dispatch_to(std::size_t index, loop::dispatch_handler handler)
+	{
+		std::error_code err;
+		dispatch_to(index, err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	void
+	dispatch_to(std::size_t index, std::error_code& err, loop::dispatch_void_handler handler)
+	{
+		if (!check_index(index, err))
+		{
+			return;
+		}
+		m_loops[index]->dispatch(err, std::move(handler));
+	}
+
+	void
+	dispatch_to(std::size_t index, loop::dispatch_void_handler handler)
+	{
+		std::error_code err;
+		dispatch_to(index, err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	/** \brief Listens on one endpoint with one acceptor per loop.
+	 *
+	 * Each acceptor is bound with options::reuse_port set, so the kernel
+	 * balances incoming connections across the loops instead of handing
+	 * them all to one. The handler is shared by every acceptor and is
+	 * invoked concurrently from each loop's thread. If the endpoint's port
+	 * is 0, the port assigned to the first acceptor is used for the rest.
+	 *
+	 * Blocks until every acceptor is listening. On failure no acceptors are
+	 * left open and the result is empty.
+	 */
+	std::vector<acceptor::ptr>
+	create_acceptors(options const& opts, std::error_code& err, acceptor::connection_handler handler);
+
+	std::vector<acceptor::ptr>
+	create_acceptors(options const& opts, acceptor::connection_handler handler)
+	{
+		std::error_code err;
+		auto            result = create_acceptors(opts, err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+		return result;
+	}
+
+	/** \brief Asks every loop to stop. Does not wait; see join().
+	 */
+	void
+	stop(std::error_code& err);
+
+	void
+	stop()
+	{
+		std::error_code err;
+		stop(err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	/** \brief Waits until every loop has stopped and closed.
+	 */
+	void
+	join(std::error_code& err);
+
+	void
+	join()
+	{
+		std::error_code err;
+		join(err);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	bool
+	is_running() const
+	{
+		return m_running.load(std::memory_order_acquire);
+	}
+
+	/** \brief Returns true if the calling thread belongs to this group.
+	 */
+	bool
+	is_group_thread() const;
+
+	loop_group(loop_group const&) = delete;
+	loop_group(loop_group&&)      = delete;
+
+	loop_group&
+	operator=(loop_group const&)
+			= delete;
+
+	loop_group&
+	operator=(loop_group&&)
+			= delete;
+
+private:
+	loop_group() : m_next{0}, m_running{false} {}
+
+	void
+	start(affinity aff, std::error_code& err);
+
+	bool
+	check_index(std::size_t index, std::error_code& err) const
+	{
+		err.clear();
+		if (index >= m_loops.size())
+		{
+			err = make_error_code(std::errc::invalid_argument);
+			return false;
+		}
+		if (!is_running())
+		{
+			err = make_error_code(praktor::errc::loop_closed);
+			return false;
+		}
+		return true;
+	}
+
+	std::vector<loop::ptr>   m_loops;
+	std::vector<std::thread> m_threads;
+	std::atomic<std::size_t> m_next;
+	std::atomic<bool>        m_running;
+};
+
+}    // namespace praktor
+
+#endif    // PRAKTOR_LOOP_GROUP_H
@@ -27,33 +27,68 @@
 
 #include <praktor/endpoint.h>
 #include <memory>
+#include <string>
 
 
 namespace praktor
 {
 
+/** \brief What a channel does while its write queue is above the high watermark.
+ */
+enum class write_pressure_policy
+{
+	notify,       // only call the pressure handler
+	fail_fast,    // also fail further writes with errc::write_queue_full
+	pause_read    // also stop reading the channel until the queue drains
+};
+
+/** \brief How a framed channel encodes the length of each frame.
+ */
+enum class frame_header_format
+{
+	fixed16,    // 2-byte big-endian length
+	fixed32,    // 4-byte big-endian length
+	fixed64,    // 8-byte big-endian length
+	varint      // LEB128; 1 byte up to 127, 2 bytes up to 16383
+};
+
 class options
 {
 public:
 	options(ip::endpoint const& ep)
 		: m_endpoint{ep},
 		  m_framing{false},
+		  m_frame_header{frame_header_format::fixed64},
+		  m_max_frame_size{0},
+		  m_delimiter{},
 		  m_nodelay_was_set{false},
 		  m_nodelay{false},
 		  m_keepalive_was_set{false},
 		  m_keepalive{false},
-		  m_keepalive_time{std::chrono::seconds{0}}
+		  m_keepalive_time{std::chrono::seconds{0}},
+		  m_reuse_port{false},
+		  m_mtu{0},
+		  m_receive_batch{0},
+		  m_gro{false},
+		  m_coalesce_threshold{0},
+		  m_high_watermark{0},
+		  m_low_watermark{0},
+		  m_pressure_policy{write_pressure_policy::notify},
+		  m_send_buffer_size{0},
+		  m_receive_buffer_size{0},
+		  m_quickack_was_set{false},
+		  m_quickack{false},
+		  m_notsent_lowat{0},
+		  m_user_timeout{0},
+		  m_v6only{false},
+		  m_backlog{128}
 	{}
 
-	options(options const& rhs)
-		: m_endpoint{rhs.m_endpoint},
-		  m_framing{rhs.m_framing},
-		  m_nodelay_was_set{rhs.m_nodelay_was_set},
-		  m_nodelay{rhs.m_nodelay},
-		  m_keepalive_was_set{rhs.m_keepalive_was_set},
-		  m_keepalive{rhs.m_keepalive},
-		  m_keepalive_time{rhs.m_keepalive_time}
-	{}
+	options(options const& rhs) = default;
+
+	options&
+	operator=(options const& rhs)
+			= default;
 
 	static options
 	create(ip::endpoint const& ep)
@@ -67,6 +102,13 @@ public:
 		return m_endpoint;
 	}
 
+	options&
+	endpoint(ip::endpoint const& ep)
+	{
+		m_endpoint = ep;
+		return *this;
+	}
+
 	options&
 	framing(bool value)
 	{
@@ -80,6 +122,66 @@ public:
 		return m_framing;
 	}
 
+	/** \brief Sets the frame header format of framed channels; fixed64 by default.
+	 *
+	 * Both ends of a connection must use the same format.
+	 */
+	options&
+	frame_header(frame_header_format value)
+	{
+		m_frame_header = value;
+		return *this;
+	}
+
+	frame_header_format
+	frame_header() const
+	{
+		return m_frame_header;
+	}
+
+	/** \brief Sets the largest frame a framed channel will read or write, in bytes.
+	 *
+	 * Writing a larger frame fails with errc::frame_too_large. Receiving a
+	 * frame header announcing one stops reading, and the read handler is
+	 * called with errc::frame_too_large; the stream cannot be resumed.
+	 * Zero (the default) allows any size the header format can express.
+	 *
+	 * For delimited channels it bounds the length of a received record,
+	 * delimiter excluded, in the same way; zero allows any length.
+	 */
+	options&
+	max_frame_size(std::size_t bytes)
+	{
+		m_max_frame_size = bytes;
+		return *this;
+	}
+
+	std::size_t
+	max_frame_size() const
+	{
+		return m_max_frame_size;
+	}
+
+	/** \brief Makes channels split their input into records ending in delimiter.
+	 *
+	 * Each record is passed to the read handler without its delimiter.
+	 * Writes are sent as they are; the writer supplies the delimiters. A
+	 * non-empty delimiter takes precedence over framing(). Empty (the
+	 * default) leaves the input unsplit.
+	 */
+	options&
+	delimiter(std::string const& value)
+	{
+		m_delimiter = value;
+		return *this;
+	}
+
+	std::string const&
+	delimiter() const
+	{
+		return m_delimiter;
+	}
+
 	options&
 	nodelay(bool value)
 	{
@@ -94,6 +196,12 @@ public:
 		return m_nodelay;
 	}
 
+	bool
+	nodelay_was_set() const
+	{
+		return m_nodelay_was_set;
+	}
+
 	options&
 	keepalive(bool value, std::chrono::seconds period)
 	{
@@ -115,14 +223,313 @@ public:
 		return m_keepalive_time;
 	}
 
+	bool
+	keepalive_was_set() const
+	{
+		return m_keepalive_was_set;
+	}
+
+	/** \brief Sets SO_REUSEPORT on a listening socket before it is bound.
+	 *
+	 * Several acceptors (typically one per loop) may then bind the same
+	 * endpoint, and the kernel distributes incoming connections among them.
+	 * Binding fails with operation_not_supported where SO_REUSEPORT is not
+	 * available.
+	 */
+	options&
+	reuse_port(bool value)
+	{
+		m_reuse_port = value;
+		return *this;
+	}
+
+	bool
+	reuse_port() const
+	{
+		return m_reuse_port;
+	}
+
+	/** \brief Sets the largest datagram a transceiver will receive.
+	 *
+	 * Receive buffers are sized to this value; longer datagrams are
+	 * truncated and reported with std::errc::message_size. Zero (the
+	 * default) means transceiver::payload_size_limit.
+	 */
+	options&
+	mtu(std::size_t value)
+	{
+		m_mtu = value;
+		return *this;
+	}
+
+	std::size_t
+	mtu() const
+	{
+		return m_mtu;
+	}
+
+	/** \brief Reads up to count datagrams per receive syscall (recvmmsg).
+	 *
+	 * Takes effect when a transceiver is created. Values of 0 or 1 read one
+	 * datagram per syscall. libuv caps a batch at 20 datagrams, and only
+	 * batches where the platform has recvmmsg; elsewhere the option is
+	 * ignored. Each batch slot reserves 64 KiB of receive buffer.
+	 */
+	options&
+	receive_batch(std::size_t count)
+	{
+		m_receive_batch = count;
+		return *this;
+	}
+
+	std::size_t
+	receive_batch() const
+	{
+		return m_receive_batch;
+	}
+
+	/** \brief Lets the kernel coalesce received datagrams (UDP_GRO).
+	 *
+	 * Runs of datagrams from one sender arrive in a single read and are
+	 * split back into individual datagrams before the receive handler is
+	 * called, so handlers see no difference. Where the kernel does not
+	 * support UDP_GRO the option is ignored. Overrides receive_batch.
+	 */
+	options&
+	gro(bool value)
+	{
+		m_gro = value;
+		return *this;
+	}
+
+	bool
+	gro() const
+	{
+		return m_gro;
+	}
+
+	/** \brief Gathers a channel's writes into one vectored write per loop iteration.
+	 *
+	 * Writes made during one iteration of the loop are submitted together,
+	 * as a single uv_write, once the loop has finished processing I/O, or
+	 * as soon as flush_threshold bytes are pending. Each write's handler is
+	 * still called individually when the gathered write completes. Zero
+	 * (the default) writes each call through immediately.
+	 */
+	options&
+	coalesce_writes(std::size_t flush_threshold)
+	{
+		m_coalesce_threshold = flush_threshold;
+		return *this;
+	}
+
+	std::size_t
+	coalesce_writes() const
+	{
+		return m_coalesce_threshold;
+	}
+
+	/** \brief Sets the write queue watermarks of a channel, in bytes.
+	 *
+	 * When the bytes queued for writing reach high, the channel is under
+	 * pressure: its pressure handler is called and the pressure policy
+	 * applies until the queue falls to low, when the drain handler is
+	 * called. A low watermark above high is taken as high. Zero (the
+	 * default) for high disables both.
+	 */
+	options&
+	write_watermarks(std::size_t high, std::size_t low)
+	{
+		m_high_watermark = high;
+		m_low_watermark  = low;
+		return *this;
+	}
+
+	std::size_t
+	high_watermark() const
+	{
+		return m_high_watermark;
+	}
+
+	std::size_t
+	low_watermark() const
+	{
+		return m_low_watermark;
+	}
+
+	/** \brief Sets what a channel does while under write pressure; notify by default.
+	 */
+	options&
+	pressure_policy(write_pressure_policy value)
+	{
+		m_pressure_policy = value;
+		return *this;
+	}
+
+	write_pressure_policy
+	pressure_policy() const
+	{
+		return m_pressure_policy;
+	}
+
+	/** \brief Sets SO_SNDBUF on channel sockets, in bytes; zero (the default) leaves the system's.
+	 *
+	 * Like every socket option here, applied to channels when they connect
+	 * or are accepted, and to an acceptor's listening socket when it binds,
+	 * so that accepted sockets start out with it.
+	 */
+	options&
+	send_buffer_size(std::size_t bytes)
+	{
+		m_send_buffer_size = bytes;
+		return *this;
+	}
+
+	std::size_t
+	send_buffer_size() const
+	{
+		return m_send_buffer_size;
+	}
+
+	/** \brief Sets SO_RCVBUF, in bytes; zero (the default) leaves the system's.
+	 *
+	 * Set before connect or listen, as here, it also sizes the TCP window
+	 * scale the connection negotiates.
+	 */
+	options&
+	receive_buffer_size(std::size_t bytes)
+	{
+		m_receive_buffer_size = bytes;
+		return *this;
+	}
+
+	std::size_t
+	receive_buffer_size() const
+	{
+		return m_receive_buffer_size;
+	}
+
+	/** \brief Sets TCP_QUICKACK, acknowledging received data without delay.
+	 *
+	 * Linux only; elsewhere applying it fails with operation_not_supported.
+	 * The kernel may fall back to delayed acknowledgements later on.
+	 */
+	options&
+	quickack(bool value)
+	{
+		m_quickack         = value;
+		m_quickack_was_set = true;
+		return *this;
+	}
+
+	bool
+	quickack() const
+	{
+		return m_quickack;
+	}
+
+	bool
+	quickack_was_set() const
+	{
+		return m_quickack_was_set;
+	}
+
+	/** \brief Sets TCP_NOTSENT_LOWAT, the unsent bytes above which the socket stops being writable.
+	 *
+	 * Keeps the kernel's send queue short, so data waits in the channel's
+	 * write queue, where watermarks see it. Zero (the default) leaves it
+	 * unset.
+	 */
+	options&
+	notsent_lowat(std::size_t bytes)
+	{
+		m_notsent_lowat = bytes;
+		return *this;
+	}
+
+	std::size_t
+	notsent_lowat() const
+	{
+		return m_notsent_lowat;
+	}
+
+	/** \brief Sets TCP_USER_TIMEOUT, how long sent data may stay unacknowledged before the connection is dropped.
+	 *
+	 * Zero (the default) leaves it unset.
+	 */
+	options&
+	user_timeout(std::chrono::milliseconds timeout)
+	{
+		m_user_timeout = timeout;
+		return *this;
+	}
+
+	std::chrono::milliseconds
+	user_timeout() const
+	{
+		return m_user_timeout;
+	}
+
+	/** \brief Sets IPV6_V6ONLY on an acceptor bound to an IPv6 endpoint.
+	 *
+	 * When off (the default) the system decides, usually accepting IPv4
+	 * connections too.
+	 */
+	options&
+	v6only(bool value)
+	{
+		m_v6only = value;
+		return *this;
+	}
+
+	bool
+	v6only() const
+	{
+		return m_v6only;
+	}
+
+	/** \brief Sets the listen backlog of an acceptor; 128 by default.
+	 */
+	options&
+	backlog(int value)
+	{
+		m_backlog = value;
+		return *this;
+	}
+
+	int
+	backlog() const
+	{
+		return m_backlog;
+	}
+
 private:
-	ip::endpoint         m_endpoint;
-	bool                 m_framing;
-	bool                 m_nodelay_was_set;
-	bool                 m_nodelay;
-	bool                 m_keepalive_was_set;
-	bool                 m_keepalive;
-	std::chrono::seconds m_keepalive_time;
+	ip::endpoint              m_endpoint;
+	bool                      m_framing;
+	frame_header_format       m_frame_header;
+	std::size_t               m_max_frame_size;
+	std::string               m_delimiter;
+	bool                      m_nodelay_was_set;
+	bool                      m_nodelay;
+	bool                      m_keepalive_was_set;
+	bool                      m_keepalive;
+	std::chrono::seconds      m_keepalive_time;
+	bool                      m_reuse_port;
+	std::size_t               m_mtu;
+	std::size_t               m_receive_batch;
+	bool                      m_gro;
+	std::size_t               m_coalesce_threshold;
+	std::size_t               m_high_watermark;
+	std::size_t               m_low_watermark;
+	write_pressure_policy     m_pressure_policy;
+	std::size_t               m_send_buffer_size;
+	std::size_t               m_receive_buffer_size;
+	bool                      m_quickack_was_set;
+	bool                      m_quickack;
+	std::size_t               m_notsent_lowat;
+	std::chrono::milliseconds m_user_timeout;
+	bool                      m_v6only;
+	int                       m_backlog;
 };
 
 }    // namespace praktor
@@ -0,0 +1,91 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef PRAKTOR_TIMEOUT_H
+#define PRAKTOR_TIMEOUT_H
+
+#include <chrono>
+#include <cstdint>
+#include <praktor/unique_function.h>
+
+class timeout_queue;
+struct timeout_entry;
+
+namespace praktor
+{
+
+/** \brief Refers to a callback armed on one of a loop's timeout queues.
+ *
+ * Returned by loop::set_timeout() and loop::set_precise_timeout(). A
+ * timeout is a small value, not an owner: copies refer to the same
+ * callback, and letting every copy go does not cancel it. Once the
+ * callback fires or is cancelled, every copy becomes inert, even after the
+ * loop reuses its storage for a later timeout.
+ *
+ * Timeouts must only be used on the loop's thread. Closing the loop
+ * cancels every timeout it issued; the handles stay safe to query and
+ * cancel, even after the loop has been destroyed.
+ */
+class timeout
+{
+public:
+	using handler = unique_function<void()>;
+
+	timeout() noexcept : m_entry{nullptr}, m_generation{0} {}
+
+	/** \brief Returns true if the callback has neither fired nor been cancelled.
+	 */
+	bool
+	is_pending() const;
+
+	/** \brief Disarms the callback, destroying it without invoking it.
+	 *
+	 * \return true if the timeout was pending.
+	 */
+	bool
+	cancel();
+
+	/** \brief Moves a pending timeout's deadline to delay from now.
+	 *
+	 * Timeouts from set_timeout() keep their millisecond resolution; the
+	 * delay is rounded up.
+	 *
+	 * \return false, doing nothing, if the timeout is no longer pending.
+	 */
+	bool
+	restart(std::chrono::microseconds delay);
+
+private:
+	friend class ::timeout_queue;
+
+	timeout(timeout_entry* entry, std::uint64_t generation) noexcept : m_entry{entry}, m_generation{generation} {}
+
+	timeout_entry* m_entry;
+	std::uint64_t  m_generation;
+};
+
+}    // namespace praktor
+
+#endif    // PRAKTOR_TIMEOUT_H
@@ -26,7 +26,8 @@
 #define PRAKTOR_TIMER_H
 
 #include <chrono>
-#include <functional>
+#include <cstddef>
+#include <praktor/unique_function.h>
 #include <util/shared_ptr.h>
 #include <memory>
 #include <system_error>
@@ -37,12 +38,35 @@ namespace praktor
 
 class loop;
 
+/** \brief A snapshot of a loop's counters for timers made by create_timer() and schedule().
+ */
+struct timer_stats
+{
+	std::size_t expirations;      ///< handlers run on expiry
+	std::size_t wakeups_saved;    ///< expirations deferred by slack into a wakeup that was already running timers
+};
+
 class timer
 {
 public:
 	using ptr          = util::shared_ptr<timer>;
-	using handler      = std::function<void(timer::ptr)>;
-	using void_handler = std::function<void()>;
+	using handler      = unique_function<void(timer::ptr)>;
+	using void_handler = unique_function<void()>;
+
+	/** \brief How a periodic timer schedules each expiration after the first.
+	 *
+	 * fixed_delay uses libuv's repeat, re-arming each expiration relative to
+	 * when the loop ran the previous one, so late wakeups and handler run
+	 * time accumulate as drift.
+	 * fixed_rate keeps expirations on the grid initial + k * interval,
+	 * absorbing late wakeups and handler run time; a tick whose time has
+	 * already passed when the timer re-arms is skipped, not run in a burst.
+	 */
+	enum class periodic_mode
+	{
+		fixed_delay,
+		fixed_rate
+	};
 
 	virtual ~timer() {}
 
@@ -54,6 +78,20 @@ public:
 	start(std::chrono::milliseconds timeout, std::error_code& err)
 			= 0;
 
+	/** \brief Starts the timer, allowing it to expire up to slack late.
+	 *
+	 * The timer never expires before timeout. Within [timeout, timeout +
+	 * slack] it expires on a boundary shared by other timers with similar
+	 * slack, so nearby expirations run in one loop wakeup instead of waking
+	 * the loop once each.
+	 */
+	virtual void
+	start(std::chrono::milliseconds timeout, std::chrono::milliseconds slack, std::error_code& err)
+			= 0;
+
+	virtual void
+	start(std::chrono::milliseconds timeout, std::chrono::milliseconds slack) = 0;
+
 	virtual void
 	start(std::chrono::milliseconds timeout, handler h)
 			= 0;
@@ -70,6 +108,34 @@ public:
 	start(std::chrono::milliseconds timeout, std::error_code& err, void_handler h)
 			= 0;
 
+	/** \brief Starts the timer expiring first after initial, then every interval.
+	 *
+	 * The timer must already have a handler. It keeps running until stopped
+	 * or closed, by the handler or otherwise.
+	 */
+	void
+	start_periodic(std::chrono::milliseconds initial, std::chrono::milliseconds interval, std::error_code& err)
+	{
+		start_periodic(initial, interval, periodic_mode::fixed_delay, err);
+	}
+
+	void
+	start_periodic(std::chrono::milliseconds initial, std::chrono::milliseconds interval)
+	{
+		start_periodic(initial, interval, periodic_mode::fixed_delay);
+	}
+
+	virtual void
+	start_periodic(
+			std::chrono::milliseconds initial,
+			std::chrono::milliseconds interval,
+			periodic_mode             mode,
+			std::error_code&          err)
+			= 0;
+
+	virtual void
+	start_periodic(std::chrono::milliseconds initial, std::chrono::milliseconds interval, periodic_mode mode) = 0;
+
 	virtual void
 	stop(std::error_code& err)
 			= 0;
@@ -27,12 +27,13 @@
 
 #include <chrono>
 #include <deque>
-#include <functional>
 #include <praktor/endpoint.h>
+#include <praktor/unique_function.h>
 #include <util/buffer.h>
 #include <util/shared_ptr.h>
 #include <memory>
 #include <system_error>
+#include <vector>
 
 #ifndef PRAKTOR_TRANSCEIVER_MAX_MSG_SIZE
 #define PRAKTOR_TRANSCEIVER_MAX_MSG_SIZE (9216)
@@ -44,27 +45,62 @@ namespace praktor
 
 class loop;
 
+/** \brief One datagram of a batch delivered to a transceiver::receive_batch_handler.
+ */
+struct received_datagram
+{
+	util::const_buffer buffer;
+	ip::endpoint       source;
+	std::error_code    error;    ///< per-datagram condition, e.g. std::errc::message_size on truncation
+};
+
+/** \brief One datagram of a batch submitted with transceiver::emit_batch.
+ */
+struct outgoing_datagram
+{
+	util::mutable_buffer buffer;
+	ip::endpoint         destination;
+	std::error_code      error;    ///< set on completion if this datagram was not sent
+};
+
 class transceiver
 {
 public:
 	using ptr = util::shared_ptr<transceiver>;
 
-	using receive_handler = std::function<
+	using receive_handler = unique_function<
 			void(transceiver::ptr const& chan, util::const_buffer&& buf, ip::endpoint const& ep, std::error_code const& err)>;
 
-	using send_buffer_handler = std::function<void(
+	using send_buffer_handler = unique_function<void(
 			transceiver::ptr const& trans,
 			util::mutable_buffer&&  buf,
 			ip::endpoint const&     ep,
 			std::error_code         err)>;
 
-	using send_buffers_handler = std::function<void(
+	using send_buffers_handler = unique_function<void(
 			transceiver::ptr const&            trans,
 			std::deque<util::mutable_buffer>&& bufs,
 			ip::endpoint const&                ep,
 			std::error_code                    err)>;
 
-	using close_handler = std::function<void(transceiver::ptr const& chan)>;
+	/** \brief Receives every datagram read by one receive syscall.
+	 *
+	 * The vector is reused; it is cleared after the handler returns, so
+	 * move out any buffers that must outlive the call. On a socket error the
+	 * batch is empty and err is set.
+	 */
+	using receive_batch_handler = unique_function<
+			void(transceiver::ptr const& trans, std::vector<received_datagram>& batch, std::error_code const& err)>;
+
+	/** \brief Completes a batch submitted with emit_batch.
+	 *
+	 * The batch is handed back in submission order with each datagram's
+	 * error set individually; err is the first of those errors, if any.
+	 */
+	using send_batch_handler = unique_function<
+			void(transceiver::ptr const& trans, std::vector<outgoing_datagram>&& batch, std::error_code const& err)>;
+
+	using close_handler = unique_function<void(transceiver::ptr const& chan)>;
 
 	static constexpr std::size_t payload_size_limit = PRAKTOR_TRANSCEIVER_MAX_MSG_SIZE;
 
@@ -85,6 +121,28 @@ public:
 		}
 	}
 
+	/** \brief Starts receiving with one handler call per syscall batch.
+	 *
+	 * Batches hold up to options::receive_batch datagrams when the
+	 * transceiver was created with that option, and one datagram otherwise.
+	 */
+	void
+	start_receive(std::error_code& err, transceiver::receive_batch_handler handler)
+	{
+		really_start_receive(err, std::move(handler));
+	}
+
+	void
+	start_receive(transceiver::receive_batch_handler handler)
+	{
+		std::error_code err;
+		really_start_receive(err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
 	virtual void
 	stop_receive()
 			= 0;
@@ -140,6 +198,97 @@ public:
 		}
 	}
 
+	/** \brief Sends buf as a run of segment_size datagrams (the last may be shorter).
+	 *
+	 * On Linux the run goes to the kernel as one segmentation offload send
+	 * (UDP_SEGMENT) per 64 segments; elsewhere, or if the kernel refuses
+	 * offload, each segment is sent as a datagram of its own. The handler
+	 * is called once, with the first error of any segment.
+	 */
+	void
+	emit_segmented(
+			util::mutable_buffer&& buf,
+			std::size_t            segment_size,
+			ip::endpoint const&    dest,
+			std::error_code&       err,
+			send_buffer_handler    handler)
+	{
+		really_send_segmented(std::move(buf), segment_size, dest, err, std::move(handler));
+	}
+
+	void
+	emit_segmented(
+			util::mutable_buffer&& buf,
+			std::size_t            segment_size,
+			ip::endpoint const&    dest,
+			send_buffer_handler    handler)
+	{
+		std::error_code err;
+		really_send_segmented(std::move(buf), segment_size, dest, err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	void
+	emit_segmented(util::mutable_buffer&& buf, std::size_t segment_size, ip::endpoint const& dest, std::error_code& err)
+	{
+		really_send_segmented(std::move(buf), segment_size, dest, err, nullptr);
+	}
+
+	void
+	emit_segmented(util::mutable_buffer&& buf, std::size_t segment_size, ip::endpoint const& dest)
+	{
+		std::error_code err;
+		really_send_segmented(std::move(buf), segment_size, dest, err, nullptr);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	/** \brief Sends each buffer of the batch to its own destination.
+	 *
+	 * Where the platform allows, the batch is written with as few syscalls
+	 * as possible (sendmmsg on Linux) rather than one per datagram. The
+	 * handler is called once, after every datagram has been sent or has
+	 * failed.
+	 */
+	void
+	emit_batch(std::vector<outgoing_datagram>&& batch, std::error_code& err, send_batch_handler handler)
+	{
+		really_emit_batch(std::move(batch), err, std::move(handler));
+	}
+
+	void
+	emit_batch(std::vector<outgoing_datagram>&& batch, send_batch_handler handler)
+	{
+		std::error_code err;
+		really_emit_batch(std::move(batch), err, std::move(handler));
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
+	void
+	emit_batch(std::vector<outgoing_datagram>&& batch, std::error_code& err)
+	{
+		really_emit_batch(std::move(batch), err, nullptr);
+	}
+
+	void
+	emit_batch(std::vector<outgoing_datagram>&& batch)
+	{
+		std::error_code err;
+		really_emit_batch(std::move(batch), err, nullptr);
+		if (err)
+		{
+			throw std::system_error{err};
+		}
+	}
+
 	void
 	write(std::deque<util::mutable_buffer>&& bufs, ip::endpoint const& dest, std::error_code& err)
 	{
@@ -181,6 +330,10 @@ protected:
 	really_start_receive(std::error_code& err, receive_handler&& handler)
 			= 0;
 
+	virtual void
+	really_start_receive(std::error_code& err, receive_batch_handler&& handler)
+			= 0;
+
 	virtual void
 	really_send(
 			util::mutable_buffer&& buf,
@@ -197,6 +350,19 @@ protected:
 			send_buffers_handler&&             handler)
 			= 0;
 
+	virtual void
+	really_send_segmented(
+			util::mutable_buffer&& buf,
+			std::size_t            segment_size,
+			ip::endpoint const&    dest,
+			std::error_code&       err,
+			send_buffer_handler&&  handler)
+			= 0;
+
+	virtual void
+	really_emit_batch(std::vector<outgoing_datagram>&& batch, std::error_code& err, send_batch_handler&& handler)
+			= 0;
+
 	virtual bool
 	really_close(close_handler&& handler)
 			= 0;
@@ -0,0 +1,313 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef PRAKTOR_UNIQUE_FUNCTION_H
+#define PRAKTOR_UNIQUE_FUNCTION_H
+
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifndef PRAKTOR_UNIQUE_FUNCTION_INLINE_SIZE
+#define PRAKTOR_UNIQUE_FUNCTION_INLINE_SIZE (56)
+#endif
+
+
+namespace praktor
+{
+
+template<class Signature, std::size_t InlineSize = PRAKTOR_UNIQUE_FUNCTION_INLINE_SIZE>
+class unique_function;
+
+/** \brief Move-only polymorphic function wrapper with inline storage.
+ *
+ * Drop-in replacement for std::function on the callback paths. Unlike
+ * std::function, the target is never copied, so callables that capture
+ * move-only state (buffers, other unique_functions) are accepted. Targets
+ * no larger than InlineSize bytes, aligned no stricter than a pointer, with a
+ * non-throwing move constructor, are stored in place without allocating;
+ * larger targets fall back to the heap.
+ *
+ * As with std::function, operator() is const and invoking an empty
+ * unique_function throws std::bad_function_call.
+ */
+template<class R, class... Args, std::size_t InlineSize>
+class unique_function<R(Args...), InlineSize>
+{
+public:
+	static constexpr std::size_t inline_size = InlineSize;
+
+	unique_function() noexcept : m_ops{nullptr} {}
+
+	unique_function(std::nullptr_t) noexcept : m_ops{nullptr} {}
+
+	template<
+			class F,
+			class = std::enable_if_t<
+					!std::is_same<std::decay_t<F>, unique_function>::value
+					&& std::is_invocable_r<R, std::decay_t<F>&, Args...>::value>>
+	unique_function(F&& f) : m_ops{nullptr}
+	{
+		using target_type = std::decay_t<F>;
+		if (!is_null(f))
+		{
+			construct<target_type>(std::forward<F>(f));
+		}
+	}
+
+	unique_function(unique_function&& rhs) noexcept : m_ops{nullptr}
+	{
+		take(rhs);
+	}
+
+	unique_function(unique_function const&) = delete;
+
+	~unique_function()
+	{
+		reset();
+	}
+
+	unique_function&
+	operator=(unique_function&& rhs) noexcept
+	{
+		if (this != &rhs)
+		{
+			reset();
+			take(rhs);
+		}
+		return *this;
+	}
+
+	unique_function&
+	operator=(unique_function const&)
+			= delete;
+
+	unique_function&
+	operator=(std::nullptr_t) noexcept
+	{
+		reset();
+		return *this;
+	}
+
+	template<
+			class F,
+			class = std::enable_if_t<
+					!std::is_same<std::decay_t<F>, unique_function>::value
+					&& std::is_invocable_r<R, std::decay_t<F>&, Args...>::value>>
+	unique_function&
+	operator=(F&& f)
+	{
+		unique_function{std::forward<F>(f)}.swap(*this);
+		return *this;
+	}
+
+	void
+	swap(unique_function& rhs) noexcept
+	{
+		unique_function tmp{std::move(rhs)};
+		rhs   = std::move(*this);
+		*this = std::move(tmp);
+	}
+
+	explicit operator bool() const noexcept
+	{
+		return m_ops != nullptr;
+	}
+
+	R
+	operator()(Args... args) const
+	{
+		if (!m_ops)
+		{
+			throw std::bad_function_call{};
+		}
+		return m_ops->invoke(const_cast<void*>(static_cast<const void*>(&m_storage)), std::forward<Args>(args)...);
+	}
+
+	/** \brief Returns true if the target is stored inline (no heap allocation).
+	 */
+	bool
+	is_inline() const noexcept
+	{
+		return m_ops && m_ops->is_inline;
+	}
+
+private:
+	using storage_type = std::aligned_storage_t<InlineSize, alignof(void*)>;
+
+	struct ops
+	{
+		R (*invoke)(void* storage, Args&&... args);
+		void (*relocate)(void* dst, void* src) noexcept;
+		void (*destroy)(void* storage) noexcept;
+		bool is_inline;
+	};
+
+	template<class T>
+	static constexpr bool
+	fits_inline()
+	{
+		return sizeof(T) <= InlineSize && alignof(T) <= alignof(storage_type)
+			   && std::is_nothrow_move_constructible<T>::value;
+	}
+
+	template<class T>
+	struct inline_ops
+	{
+		static R
+		invoke(void* storage, Args&&... args)
+		{
+			return (*static_cast<T*>(storage))(std::forward<Args>(args)...);
+		}
+
+		static void
+		relocate(void* dst, void* src) noexcept
+		{
+			::new (dst) T(std::move(*static_cast<T*>(src)));
+			static_cast<T*>(src)->~T();
+		}
+
+		static void
+		destroy(void* storage) noexcept
+		{
+			static_cast<T*>(storage)->~T();
+		}
+
+		static constexpr ops table{&invoke, &relocate, &destroy, true};
+	};
+
+	template<class T>
+	struct heap_ops
+	{
+		static R
+		invoke(void* storage, Args&&... args)
+		{
+			return (**static_cast<T**>(storage))(std::forward<Args>(args)...);
+		}
+
+		static void
+		relocate(void* dst, void* src) noexcept
+		{
+			*static_cast<T**>(dst) = *static_cast<T**>(src);
+		}
+
+		static void
+		destroy(void* storage) noexcept
+		{
+			delete *static_cast<T**>(storage);
+		}
+
+		static constexpr ops table{&invoke, &relocate, &destroy, false};
+	};
+
+	template<class T>
+	static bool
+	is_null(T const& f)
+	{
+		if constexpr (std::is_pointer<T>::value || std::is_member_pointer<T>::value)
+		{
+			return f == nullptr;
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	template<class Sig>
+	static bool
+	is_null(std::function<Sig> const& f)
+	{
+		return !f;
+	}
+
+	template<class Sig, std::size_t N>
+	static bool
+	is_null(unique_function<Sig, N> const& f)
+	{
+		return !f;
+	}
+
+	template<class T, class F>
+	void
+	construct(F&& f)
+	{
+		if constexpr (fits_inline<T>())
+		{
+			::new (static_cast<void*>(&m_storage)) T(std::forward<F>(f));
+			m_ops = &inline_ops<T>::table;
+		}
+		else
+		{
+			*reinterpret_cast<T**>(&m_storage) = new T(std::forward<F>(f));
+			m_ops = &heap_ops<T>::table;
+		}
+	}
+
+	void
+	take(unique_function& rhs) noexcept
+	{
+		if (rhs.m_ops)
+		{
+			rhs.m_ops->relocate(&m_storage, &rhs.m_storage);
+			m_ops     = rhs.m_ops;
+			rhs.m_ops = nullptr;
+		}
+	}
+
+	void
+	reset() noexcept
+	{
+		if (m_ops)
+		{
+			auto table = m_ops;
+			m_ops      = nullptr;
+			table->destroy(&m_storage);
+		}
+	}
+
+	storage_type m_storage;
+	ops const*   m_ops;
+};
+
+template<class Signature, std::size_t InlineSize>
+inline bool
+operator==(unique_function<Signature, InlineSize> const& f, std::nullptr_t) noexcept
+{
+	return !f;
+}
+
+template<class Signature, std::size_t InlineSize>
+inline bool
+operator!=(unique_function<Signature, InlineSize> const& f, std::nullptr_t) noexcept
+{
+	return static_cast<bool>(f);
+}
+
+}    // namespace praktor
+
+#endif    // PRAKTOR_UNIQUE_FUNCTION_H
@@ -146,6 +146,10 @@ praktor_category_impl::message(int ev ) const noexcept
 			return "loop closed";
 		case praktor::errc::timer_closed:
 			return "timer closed";
+		case praktor::errc::write_queue_full:
+			return "write queue full";
+		case praktor::errc::frame_too_large:
+			return "frame too large";
 		default:
 			return "unknown praktor error";
     }
@@ -0,0 +1,202 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef PRAKTOR_FRAME_HEADER_CODEC_H
+#define PRAKTOR_FRAME_HEADER_CODEC_H
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <praktor/options.h>
+#include <util/buffer.h>
+
+/** \brief Encodes and incrementally decodes the length header of a frame.
+ *
+ * Fixed headers hold the frame size big-endian in 2, 4 or 8 bytes. Varint
+ * headers hold it in LEB128: seven bits per byte, least significant group
+ * first, with the high bit set on every byte but the last.
+ *
+ * Decoding accepts the header a byte at a time, so it may straddle reads.
+ * A varint longer than 64 bits decodes as the largest std::uint64_t, which
+ * no frame size limit admits.
+ */
+class frame_header_codec
+{
+public:
+	static constexpr std::size_t max_header_size = 10;
+
+	explicit frame_header_codec(praktor::frame_header_format format = praktor::frame_header_format::fixed64)
+		: m_format{format}, m_value{0}, m_byte_count{0}
+	{}
+
+	praktor::frame_header_format
+	format() const
+	{
+		return m_format;
+	}
+
+	/** \brief The largest frame size the format can express.
+	 */
+	std::uint64_t
+	max_frame_size() const
+	{
+		switch (m_format)
+		{
+			case praktor::frame_header_format::fixed16:
+				return std::numeric_limits<std::uint16_t>::max();
+			case praktor::frame_header_format::fixed32:
+				return std::numeric_limits<std::uint32_t>::max();
+			default:
+				return std::numeric_limits<std::uint64_t>::max();
+		}
+	}
+
+	/** \brief Writes the header for frame_size to out, which must hold max_header_size bytes.
+	 *
+	 * \return the length of the header.
+	 */
+	std::size_t
+	encode(std::uint64_t frame_size, util::byte_type* out) const
+	{
+		assert(frame_size <= max_frame_size());
+		if (m_format == praktor::frame_header_format::varint)
+		{
+			std::size_t length{0};
+			while (frame_size > 0x7f)
+			{
+				out[length++] = static_cast<util::byte_type>((frame_size & 0x7f) | 0x80);
+				frame_size >>= 7;
+			}
+			out[length++] = static_cast<util::byte_type>(frame_size);
+			return length;
+		}
+
+		std::size_t length = fixed_size();
+		for (std::size_t i = length; i > 0; --i)
+		{
+			out[i - 1] = static_cast<util::byte_type>(frame_size & 0xff);
+			frame_size >>= 8;
+		}
+		return length;
+	}
+
+	/** \brief Consumes header bytes from data, up to size.
+	 *
+	 * \return the number of bytes consumed; the header is complete when
+	 * is_complete() is true, and the decoder is then ready for the next one
+	 * once reset.
+	 */
+	std::size_t
+	decode(util::byte_type const* data, std::size_t size)
+	{
+		assert(!is_complete());
+		std::size_t position{0};
+		if (m_format == praktor::frame_header_format::varint)
+		{
+			while (position < size)
+			{
+				auto        byte  = static_cast<std::uint8_t>(data[position++]);
+				std::size_t shift = 7 * m_byte_count++;
+				if (shift > 63 || (shift == 63 && (byte & 0x7e)))
+				{
+					m_value = std::numeric_limits<std::uint64_t>::max();
+				}
+				else if (m_value != std::numeric_limits<std::uint64_t>::max())
+				{
+					m_value |= static_cast<std::uint64_t>(byte & 0x7f) << shift;
+				}
+				if (!(byte & 0x80))
+				{
+					m_byte_count = complete;
+					break;
+				}
+				if (m_byte_count == max_header_size)
+				{
+					m_value      = std::numeric_limits<std::uint64_t>::max();
+					m_byte_count = complete;
+					break;
+				}
+			}
+			return position;
+		}
+
+		std::size_t length = fixed_size();
+		while (position < size && m_byte_count < length)
+		{
+			m_value = (m_value << 8) | static_cast<std::uint8_t>(data[position++]);
+			++m_byte_count;
+		}
+		if (m_byte_count == length)
+		{
+			m_byte_count = complete;
+		}
+		return position;
+	}
+
+	bool
+	is_complete() const
+	{
+		return m_byte_count == complete;
+	}
+
+	/** \brief The decoded frame size; valid once is_complete().
+	 */
+	std::uint64_t
+	frame_size() const
+	{
+		assert(is_complete());
+		return m_value;
+	}
+
+	void
+	reset()
+	{
+		m_value      = 0;
+		m_byte_count = 0;
+	}
+
+private:
+	static constexpr std::size_t complete = std::numeric_limits<std::size_t>::max();
+
+	std::size_t
+	fixed_size() const
+	{
+		switch (m_format)
+		{
+			case praktor::frame_header_format::fixed16:
+				return 2;
+			case praktor::frame_header_format::fixed32:
+				return 4;
+			default:
+				return 8;
+		}
+	}
+
+	praktor::frame_header_format m_format;
+	std::uint64_t                m_value;
+	std::size_t                  m_byte_count;
+};
+
+#endif    // PRAKTOR_FRAME_HEADER_CODEC_H
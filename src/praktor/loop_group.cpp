@@ -0,0 +1,272 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <algorithm>
+#include <future>
+#include <praktor/loop_group.h>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using praktor::loop_group;
+
+loop_group::ptr
+loop_group::create(std::size_t size, affinity aff, std::error_code& err)
+{
+	err.clear();
+	loop_group::ptr result;
+
+	if (size < 1)
+	{
+		size = std::max(std::thread::hardware_concurrency(), 1u);
+	}
+
+	result = loop_group::ptr{new loop_group};
+	for (std::size_t i = 0; i < size; ++i)
+	{
+		result->m_loops.emplace_back(loop::create());
+	}
+
+	result->start(aff, err);
+	if (err)
+	{
+		std::error_code ec;
+		result->stop(ec);
+		result->join(ec);
+		result.reset();
+	}
+
+	return result;
+}
+
+loop_group::~loop_group()
+{
+	std::error_code err;
+	stop(err);
+	if (is_group_thread())
+	{
+		// The last reference was dropped by a handler on one of our own loops;
+		// joining here would deadlock. Each thread holds its own loop reference,
+		// so letting the threads finish on their own is safe.
+		for (auto& t : m_threads)
+		{
+			t.detach();
+		}
+	}
+	else
+	{
+		join(err);
+	}
+}
+
+void
+loop_group::start(affinity aff, std::error_code& err)
+{
+	err.clear();
+	m_running.store(true, std::memory_order_release);
+
+	for (std::size_t i = 0; i < m_loops.size(); ++i)
+	{
+		loop::ptr lp = m_loops[i];
+		m_threads.emplace_back([lp]() {
+			std::error_code ec;
+			lp->run(ec);
+			lp->close(ec);
+		});
+
+		if (aff == affinity::pin_to_cores)
+		{
+#if defined(__linux__)
+			auto      cores = std::max(std::thread::hardware_concurrency(), 1u);
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(i % cores, &cpus);
+			auto stat = pthread_setaffinity_np(m_threads.back().native_handle(), sizeof(cpus), &cpus);
+			if (stat != 0)
+			{
+				err = std::error_code{stat, std::generic_category()};
+				return;
+			}
+#else
+			err = make_error_code(std::errc::operation_not_supported);
+			return;
+#endif
+		}
+	}
+}
+
+std::vector<praktor::acceptor::ptr>
+loop_group::create_acceptors(options const& opts, std::error_code& err, acceptor::connection_handler handler)
+{
+	err.clear();
+	std::vector<acceptor::ptr> result;
+
+	if (!handler)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		return result;
+	}
+
+	if (is_group_thread())
+	{
+		err = make_error_code(std::errc::resource_deadlock_would_occur);
+		return result;
+	}
+
+	if (!is_running())
+	{
+		err = make_error_code(praktor::errc::loop_closed);
+		return result;
+	}
+
+	auto    shared_handler = std::make_shared<acceptor::connection_handler>(std::move(handler));
+	options shard_opts{opts};
+	shard_opts.reuse_port(true);
+
+	// One loop at a time, so an ephemeral port picked by the first bind can
+	// be reused for the others.
+	for (auto& lp : m_loops)
+	{
+		std::promise<acceptor::ptr> created;
+		auto                        future = created.get_future();
+		std::error_code             create_err;
+
+		lp->dispatch(err, [&, created{std::move(created)}](loop::ptr const& lp) mutable {
+			auto acc = lp->create_acceptor(
+					shard_opts,
+					create_err,
+					[shared_handler](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+						(*shared_handler)(ap, chan, ec);
+					});
+			if (!create_err && shard_opts.endpoint().port() == 0)
+			{
+				shard_opts.endpoint(acc->get_endpoint(create_err));
+			}
+			if (create_err && acc)
+			{
+				acc->close();
+				acc.reset();
+			}
+			created.set_value(acc);
+		});
+		if (err)
+		{
+			break;
+		}
+
+		// Each group thread closes its loop as soon as the loop stops, and
+		// closing discards undelivered handlers, so a loop that stops before
+		// running this one breaks the promise instead of leaving us waiting.
+		try
+		{
+			auto acc = future.get();
+			if (create_err)
+			{
+				err = create_err;
+				break;
+			}
+			result.emplace_back(acc);
+		}
+		catch (std::future_error const&)
+		{
+			// the loop stopped before the handler ran
+			err = make_error_code(praktor::errc::loop_closed);
+			break;
+		}
+	}
+
+	if (err)
+	{
+		for (std::size_t i = 0; i < result.size(); ++i)
+		{
+			std::error_code ec;
+			m_loops[i]->dispatch(ec, [acc{result[i]}]() { acc->close(); });
+		}
+		result.clear();
+	}
+
+	return result;
+}
+
+void
+loop_group::stop(std::error_code& err)
+{
+	err.clear();
+
+	if (!m_running.exchange(false, std::memory_order_acq_rel))
+	{
+		return;
+	}
+
+	for (auto& lp : m_loops)
+	{
+		std::error_code ec;
+		lp->dispatch(ec, [](loop::ptr const& lp) {
+			std::error_code ec;
+			lp->stop(ec);
+		});
+		// a loop that already stopped on its own has closed; nothing to do
+		if (ec && ec != praktor::errc::loop_closed && !err)
+		{
+			err = ec;
+		}
+	}
+}
+
+void
+loop_group::join(std::error_code& err)
+{
+	err.clear();
+
+	if (is_group_thread())
+	{
+		err = make_error_code(std::errc::resource_deadlock_would_occur);
+		return;
+	}
+
+	for (auto& t : m_threads)
+	{
+		if (t.joinable())
+		{
+			t.join();
+		}
+	}
+}
+
+bool
+loop_group::is_group_thread() const
+{
+	auto id = std::this_thread::get_id();
+	for (auto& t : m_threads)
+	{
+		if (t.get_id() == id)
+		{
+			return true;
+		}
+	}
+	return false;
+}
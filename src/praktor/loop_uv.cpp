@@ -26,6 +26,7 @@
 #include "tcp_uv.h"
 #include "timer_uv.h"
 #include "udp_uv.h"
+#include <thread>
 
 using praktor::ip::address;
 
@@ -81,9 +82,11 @@ resolve_req_uv::on_resolve(uv_getaddrinfo_t* req, int status, struct addrinfo* r
 }
 
 
-loop_uv::loop_uv(use_default_loop flag) : m_uv_loop{uv_default_loop()}, m_is_default_loop{true} {}
+loop_uv::loop_uv(use_default_loop flag)
+	: m_dispatch_closed{false}, m_dispatch_producers{0}, m_uv_loop{uv_default_loop()}, m_is_default_loop{true}
+{}
 
-loop_uv::loop_uv() : m_uv_loop{new uv_loop_t}, m_is_default_loop{false}
+loop_uv::loop_uv() : m_dispatch_closed{false}, m_dispatch_producers{0}, m_uv_loop{new uv_loop_t}, m_is_default_loop{false}
 {
 	uv_loop_init(m_uv_loop);
 }
@@ -91,7 +94,8 @@ loop_uv::loop_uv() : m_uv_loop{new uv_loop_t}, m_is_default_loop{false}
 void
 loop_uv::init(loop_uv::wptr self)
 {
-	m_data.m_impl_wptr = self;
+	m_data.m_impl_wptr        = self;
+	m_data.m_read_buffer_pool = std::make_shared<read_buffer_pool>();
 	uv_loop_set_data(m_uv_loop, &m_data);
 	uv_async_init(m_uv_loop, &m_async_handle, on_async);
 }
@@ -100,6 +104,7 @@ loop_uv::~loop_uv()
 {
 	std::error_code err;
 	close(err);
+	discard_dispatch_queue();
 }
 
 timer::ptr
@@ -167,8 +172,7 @@ loop_uv::really_create_timer_void(std::error_code& err, timer::void_handler&& ha
 		err = make_error_code(praktor::errc::loop_closed);
 		goto exit;
 	}
-	result = util::make_shared<timer_uv>(
-			m_uv_loop, err, [=, handler{std::move(handler)}](praktor::timer::ptr) { handler(); });
+	result = util::make_shared<timer_uv>(m_uv_loop, err, std::move(handler));
 	result->init(result);
 	if (err)
 		goto exit;
@@ -261,7 +265,19 @@ loop_uv::on_walk(uv_handle_t* handle, void*)
 			case uv_handle_type::UV_TIMER:
 				if (!uv_is_closing(handle))
 				{
-					uv_close(handle, timer_uv::on_timer_close);
+					auto data = reinterpret_cast<loop_data*>(handle->loop->data);
+					if (data->m_timing_wheel.owns(handle))
+					{
+						uv_close(handle, nullptr);
+					}
+					else if (data->m_precise_timer_queue.owns(handle))
+					{
+						precise_timer_queue::close_handle(handle);
+					}
+					else
+					{
+						uv_close(handle, timer_uv::on_timer_close);
+					}
 				}
 				break;
 			case uv_handle_type::UV_TCP:
@@ -271,6 +287,8 @@ loop_uv::on_walk(uv_handle_t* handle, void*)
 				}
 				break;
 			case uv_handle_type::UV_ASYNC:
+			case uv_handle_type::UV_CHECK:
+			case uv_handle_type::UV_IDLE:
 				if (!uv_is_closing(handle))
 				{
 					uv_close(handle, nullptr);
@@ -282,6 +300,21 @@ loop_uv::on_walk(uv_handle_t* handle, void*)
 					uv_close(handle, udp_transceiver_uv::on_close);
 				}
 				break;
+			case uv_handle_type::UV_POLL:
+				// besides the precise timer queue's timerfd, only transceivers
+				// receiving with UDP_GRO own poll handles
+				if (!uv_is_closing(handle))
+				{
+					if (reinterpret_cast<loop_data*>(handle->loop->data)->m_precise_timer_queue.owns(handle))
+					{
+						precise_timer_queue::close_handle(handle);
+					}
+					else
+					{
+						uv_close(handle, udp_transceiver_uv::on_gro_poll_close);
+					}
+				}
+				break;
 			default:
 				std::cout << "closing loop handles, unexpected handle type: " << handle_type << std::endl;
 				break;
@@ -301,6 +334,10 @@ loop_uv::really_close(std::error_code& err)    // probably should NOT be called
 		goto exit;
 	}
 
+	close_dispatch_queue();
+	m_data.m_write_coalescer.clear();
+	m_data.m_timing_wheel.clear();
+	m_data.m_precise_timer_queue.clear();
 	status = uv_loop_close(m_uv_loop);
 	if (status == UV_EBUSY)
 	{
@@ -411,15 +448,16 @@ loop_uv::really_connect_channel(options const& opt, std::error_code& err, channe
 		goto exit;
 	}
 
-	if (opt.framing())
-	{
-		cp = util::make_shared<tcp_framed_channel_uv>();
-	}
-	else
+	cp = tcp_channel_uv::create(opt);
 	{
-		cp = util::make_shared<tcp_channel_uv>();
+		// create the socket now, so options like SO_RCVBUF precede the connect
+		sockaddr_storage saddr;
+		opt.endpoint().to_sockaddr(saddr);
+		cp->init(m_uv_loop, cp, err, saddr.ss_family);
 	}
-	cp->init(m_uv_loop, cp, err);
+	if (err)
+		goto exit;
+	cp->apply_socket_options(opt, err);
 	if (err)
 		goto exit;
 	cp->connect(opt.endpoint(), err, std::move(handler));
@@ -441,7 +479,7 @@ loop_uv::setup_transceiver(options const& opts, std::error_code& err)
 
 	tp = util::make_shared<udp_transceiver_uv>();
 
-	tp->init(m_uv_loop, tp, err);
+	tp->init(m_uv_loop, tp, opts, err);
 	if (err)
 		goto exit;
 
@@ -508,7 +546,7 @@ loop_uv::really_resolve(std::string const& hostname, std::error_code& err, resol
 	}
 
 	{
-		resolve_req_uv* req = new resolve_req_uv{hostname, std::move(handler)};
+		resolve_req_uv* req = new (m_data.m_request_pool) resolve_req_uv{hostname, std::move(handler)};
 		req->start(m_uv_loop, err);
 	}
 
@@ -516,6 +554,30 @@ exit:
 	return;
 }
 
+void
+loop_uv::really_configure_buffer_pool(praktor::buffer_pool_config const& config, std::error_code& err)
+{
+	m_data.m_read_buffer_pool->configure(config, err);
+}
+
+praktor::buffer_pool_stats
+loop_uv::really_get_buffer_pool_stats()
+{
+	return m_data.m_read_buffer_pool->get_stats();
+}
+
+praktor::request_pool_stats
+loop_uv::really_get_request_pool_stats()
+{
+	return m_data.m_request_pool.get_stats();
+}
+
+praktor::timer_stats
+loop_uv::really_get_timer_stats()
+{
+	return m_data.m_timer_stats;
+}
+
 loop_uv::ptr
 loop_data::get_loop_ptr()
 {
@@ -555,24 +617,7 @@ loop_uv::really_dispatch(std::error_code& err, loop::dispatch_handler&& handler)
 		goto exit;
 	}
 
-	if (!m_uv_loop)
-	{
-		err = make_error_code(praktor::errc::loop_closed);
-		goto exit;
-	}
-
-	{
-		std::lock_guard<std::recursive_mutex> guard(m_dispatch_queue_mutex);
-		m_dispatch_queue.emplace_back([=, handler{std::move(handler)}]() { handler(m_data.get_loop_ptr()); });
-	}
-
-	{
-		auto stat = uv_async_send(&m_async_handle);
-		if (stat < 0)
-		{
-			err = map_uv_error(stat);
-		}
-	}
+	enqueue_dispatch(err, dispatch_node::handler_slot{std::in_place_type<loop::dispatch_handler>, std::move(handler)});
 exit:
 	return;
 }
@@ -587,26 +632,45 @@ loop_uv::really_dispatch_void(std::error_code& err, loop::dispatch_void_handler&
 		goto exit;
 	}
 
-	if (!m_uv_loop)
-	{
-		err = make_error_code(praktor::errc::loop_closed);
-		goto exit;
-	}
+	enqueue_dispatch(err, dispatch_node::handler_slot{std::in_place_type<void_handler>, std::move(handler)});
+exit:
+	return;
+}
 
+void
+loop_uv::enqueue_dispatch(std::error_code& err, dispatch_node::handler_slot&& handler)
+{
+	// Other threads may dispatch while the loop closes. Registering as a
+	// producer before checking the closed flag lets close() wait until no
+	// producer can still touch the async handle it is about to close.
+	m_dispatch_producers.fetch_add(1);
+	if (m_dispatch_closed.load())
 	{
-		std::lock_guard<std::recursive_mutex> guard(m_dispatch_queue_mutex);
-		m_dispatch_queue.emplace_back(std::move(handler));
+		err = make_error_code(praktor::errc::loop_closed);
 	}
-
+	else
 	{
-		auto stat = uv_async_send(&m_async_handle);
-		if (stat < 0)
+		// Only the producer that finds the queue empty needs to wake the loop;
+		// every later producer is covered by that pending wakeup.
+		auto node = m_spare_dispatch_nodes.take();
+		if (node)
+		{
+			node->m_handler = std::move(handler);
+		}
+		else
+		{
+			node = new dispatch_node{nullptr, std::move(handler)};
+		}
+		if (m_dispatch_queue.push(node))
 		{
-			err = map_uv_error(stat);
+			auto stat = uv_async_send(&m_async_handle);
+			if (stat < 0)
+			{
+				err = map_uv_error(stat);
+			}
 		}
 	}
-exit:
-	return;
+	m_dispatch_producers.fetch_sub(1);
 }
 
 bool
@@ -617,57 +681,255 @@ loop_uv::is_alive() const
 
 void
 loop_uv::really_schedule(
-		std::chrono::milliseconds                 timeout,
-		std::error_code&                          err,
+		std::chrono::milliseconds          timeout,
+		std::chrono::milliseconds          slack,
+		std::error_code&                   err,
 		praktor::loop::scheduled_handler&& handler)
 {
-	auto tp = really_create_timer(
-			err, [=, handler{std::move(handler)}](praktor::timer::ptr) { handler(m_data.get_loop_ptr()); });
+	err.clear();
+	timer::ptr tp;
+
+	if (!handler || slack.count() < 0)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		goto exit;
+	}
+
+	if (!m_uv_loop)
+	{
+		err = make_error_code(praktor::errc::loop_closed);
+		goto exit;
+	}
+
+	{
+		auto impl = util::make_shared<timer_uv>(m_uv_loop, err, std::move(handler));
+		impl->init(impl);
+		tp = impl;
+	}
 	if (err)
 		goto exit;
-	tp->start(timeout, err);
+	tp->start(timeout, slack, err);
 exit:
 	return;
 }
 
 void
 loop_uv::really_schedule_void(
-		std::chrono::milliseconds                      timeout,
-		std::error_code&                               err,
+		std::chrono::milliseconds               timeout,
+		std::chrono::milliseconds               slack,
+		std::error_code&                        err,
 		praktor::loop::scheduled_void_handler&& handler)
 {
-	auto tp = really_create_timer(err, [handler{std::move(handler)}](praktor::timer::ptr) { handler(); });
+	timer::ptr tp;
+
+	if (slack.count() < 0)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		goto exit;
+	}
+
+	tp = really_create_timer_void(err, std::move(handler));
 	if (err)
 		goto exit;
-	tp->start(timeout, err);
+	tp->start(timeout, slack, err);
 exit:
 	return;
 }
 
-bool
-loop_uv::try_dispatch_front()
+timer::ptr
+loop_uv::really_schedule_every(
+		std::chrono::milliseconds          interval,
+		timer::periodic_mode               mode,
+		std::error_code&                   err,
+		praktor::loop::scheduled_handler&& handler)
+{
+	err.clear();
+	timer::ptr tp;
+
+	if (!handler || interval.count() <= 0)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		goto exit;
+	}
+
+	if (!m_uv_loop)
+	{
+		err = make_error_code(praktor::errc::loop_closed);
+		goto exit;
+	}
+
+	{
+		auto impl = util::make_shared<timer_uv>(m_uv_loop, err, std::move(handler));
+		impl->init(impl);
+		tp = impl;
+	}
+	if (err)
+		goto exit;
+	tp->start_periodic(interval, interval, mode, err);
+exit:
+	return tp;
+}
+
+timer::ptr
+loop_uv::really_schedule_every_void(
+		std::chrono::milliseconds               interval,
+		timer::periodic_mode                    mode,
+		std::error_code&                        err,
+		praktor::loop::scheduled_void_handler&& handler)
+{
+	timer::ptr tp;
+
+	if (interval.count() <= 0)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		goto exit;
+	}
+
+	tp = really_create_timer_void(err, std::move(handler));
+	if (err)
+		goto exit;
+	tp->start_periodic(interval, interval, mode, err);
+exit:
+	return tp;
+}
+
+praktor::timeout
+loop_uv::really_set_timeout(
+		std::chrono::milliseconds   delay,
+		std::error_code&            err,
+		praktor::timeout::handler&& handler)
 {
-	bool ok = false;
+	err.clear();
+	praktor::timeout result;
+
+	if (!handler)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		goto exit;
+	}
+
+	if (!m_uv_loop)
+	{
+		err = make_error_code(praktor::errc::loop_closed);
+		goto exit;
+	}
+
+	result = m_data.m_timing_wheel.add(m_uv_loop, delay, std::move(handler));
+exit:
+	return result;
+}
+
+praktor::timeout
+loop_uv::really_set_precise_timeout(
+		std::chrono::steady_clock::time_point deadline,
+		std::error_code&                      err,
+		praktor::timeout::handler&&           handler)
+{
+	err.clear();
+	praktor::timeout result;
 
-	void_handler handler;
+	if (!handler)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		goto exit;
+	}
 
+	if (!m_uv_loop)
 	{
-		std::lock_guard<std::recursive_mutex> guard(m_dispatch_queue_mutex);
+		err = make_error_code(praktor::errc::loop_closed);
+		goto exit;
+	}
 
-		if (!m_dispatch_queue.empty())
+	result = m_data.m_precise_timer_queue.add(m_uv_loop, deadline, err, std::move(handler));
+exit:
+	return result;
+}
+
+void
+loop_uv::drain_dispatch_queue()
+{
+	// Should a handler throw, the rest of its batch is discarded rather
+	// than leaked.
+	struct batch_guard
+	{
+		loop_uv*       m_loop;
+		dispatch_node* m_node;
+
+		~batch_guard()
 		{
-			handler = std::move(m_dispatch_queue.front());
-			m_dispatch_queue.pop_front();
-			ok = true;
+			m_loop->discard_dispatch_nodes(m_node);
 		}
+	};
+
+	// Handlers dispatched while this batch runs land in a fresh batch,
+	// which is picked up on the next wakeup. Each node is recycled before
+	// its handler runs, so the handler may dispatch again without
+	// allocating.
+	batch_guard batch{this, m_dispatch_queue.take_all()};
+	while (batch.m_node)
+	{
+		auto node    = batch.m_node;
+		batch.m_node = node->m_next;
+		auto handler = std::move(node->m_handler);
+		recycle_dispatch_node(node);
+		invoke_dispatch_handler(handler);
+	}
+}
+
+void
+loop_uv::recycle_dispatch_node(dispatch_node* node)
+{
+	// a recycled node keeps an empty handler of whichever signature it held
+	if (!m_spare_dispatch_nodes.put(node))
+	{
+		delete node;
 	}
+}
 
-	if (ok)
+void
+loop_uv::invoke_dispatch_handler(dispatch_node::handler_slot& handler)
+{
+	if (auto void_dispatch = std::get_if<void_handler>(&handler))
+	{
+		(*void_dispatch)();
+	}
+	else if (auto loop_dispatch = std::get_if<loop::dispatch_handler>(&handler))
 	{
-		handler();
+		(*loop_dispatch)(m_data.get_loop_ptr());
 	}
+}
 
-	return ok;
+void
+loop_uv::close_dispatch_queue()
+{
+	m_dispatch_closed.store(true);
+	while (m_dispatch_producers.load() != 0)
+	{
+		std::this_thread::yield();
+	}
+
+	// Handlers still queued never run; destroying them releases whatever
+	// they captured, so a thread waiting on one sees a broken promise
+	// rather than hanging.
+	discard_dispatch_queue();
+}
+
+void
+loop_uv::discard_dispatch_queue()
+{
+	discard_dispatch_nodes(m_dispatch_queue.take_all());
+}
+
+void
+loop_uv::discard_dispatch_nodes(dispatch_node* node)
+{
+	while (node)
+	{
+		auto next       = node->m_next;
+		node->m_handler = dispatch_node::handler_slot{};
+		recycle_dispatch_node(node);
+		node = next;
+	}
 }
 
 void
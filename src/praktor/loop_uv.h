@@ -25,11 +25,19 @@
 #ifndef PRAKTOR_LOOP_UV_H
 #define PRAKTOR_LOOP_UV_H
 
+#include "mpsc_queue.h"
+#include "node_cache.h"
+#include "precise_timer_queue.h"
+#include "read_buffer_pool.h"
+#include "request_pool.h"
+#include "timing_wheel.h"
 #include "uv_error.h"
+#include "write_coalescer.h"
+#include <atomic>
 #include <deque>
 #include <praktor/loop.h>
-#include <mutex>
 #include <uv.h>
+#include <variant>
 
 using praktor::ip::endpoint;
 using util::mutable_buffer;
@@ -40,7 +48,7 @@ using praktor::options;
 using praktor::timer;
 using praktor::loop;
 
-class resolve_req_uv
+class resolve_req_uv : public pooled_request
 {
 public:
 	resolve_req_uv(std::string const& hostname, loop::resolve_handler handler)
@@ -67,6 +75,13 @@ class udp_transceiver_uv;
 struct loop_data
 {
 	std::weak_ptr<loop_uv> m_impl_wptr;
+	read_buffer_pool::ptr  m_read_buffer_pool;
+	write_coalescer        m_write_coalescer;
+	request_pool           m_request_pool;
+	timing_wheel           m_timing_wheel;
+	precise_timer_queue    m_precise_timer_queue;
+	praktor::timer_stats   m_timer_stats{};
+	std::uint64_t          m_last_timer_wakeup{0};    // loop time of the last timer expiration
 	std::shared_ptr<loop_uv>
 	get_loop_ptr();
 };
@@ -79,7 +94,7 @@ public:
 	using ptr  = std::shared_ptr<loop_uv>;
 	using wptr = std::weak_ptr<loop_uv>;
 
-	using void_handler = std::function<void()>;
+	using void_handler = praktor::unique_function<void()>;
 
 	struct use_default_loop
 	{};
@@ -99,6 +114,12 @@ public:
 	virtual bool
 	is_alive() const override;
 
+	uv_loop_t*
+	get_uv_loop() const
+	{
+		return m_uv_loop;
+	}
+
 private:
 	loop_uv(loop_uv const&) = delete;
 	loop_uv(loop_uv&&)      = delete;
@@ -166,6 +187,18 @@ private:
 	virtual void
 	really_resolve(std::string const& hostname, std::error_code& err, resolve_handler&& handler) override;
 
+	virtual void
+	really_configure_buffer_pool(praktor::buffer_pool_config const& config, std::error_code& err) override;
+
+	virtual praktor::buffer_pool_stats
+	really_get_buffer_pool_stats() override;
+
+	virtual praktor::request_pool_stats
+	really_get_request_pool_stats() override;
+
+	virtual praktor::timer_stats
+	really_get_timer_stats() override;
+
 	virtual void
 	really_dispatch(std::error_code& err, loop::dispatch_handler&& handler) override;
 
@@ -173,27 +206,86 @@ private:
 	really_dispatch_void(std::error_code& err, loop::dispatch_void_handler&& handler) override;
 
 	virtual void
-	really_schedule(std::chrono::milliseconds timeout, std::error_code& err, loop::scheduled_handler&& handler) override;
+	really_schedule(
+			std::chrono::milliseconds timeout,
+			std::chrono::milliseconds slack,
+			std::error_code&          err,
+			loop::scheduled_handler&& handler) override;
 
 	virtual void
-	really_schedule_void(std::chrono::milliseconds timeout, std::error_code& err, loop::scheduled_void_handler&& handler) override;
+	really_schedule_void(
+			std::chrono::milliseconds      timeout,
+			std::chrono::milliseconds      slack,
+			std::error_code&               err,
+			loop::scheduled_void_handler&& handler) override;
+
+	virtual timer::ptr
+	really_schedule_every(
+			std::chrono::milliseconds interval,
+			timer::periodic_mode      mode,
+			std::error_code&          err,
+			loop::scheduled_handler&& handler) override;
+
+	virtual timer::ptr
+	really_schedule_every_void(
+			std::chrono::milliseconds      interval,
+			timer::periodic_mode           mode,
+			std::error_code&               err,
+			loop::scheduled_void_handler&& handler) override;
+
+	virtual praktor::timeout
+	really_set_timeout(std::chrono::milliseconds delay, std::error_code& err, praktor::timeout::handler&& handler) override;
+
+	virtual praktor::timeout
+	really_set_precise_timeout(
+			std::chrono::steady_clock::time_point deadline,
+			std::error_code&                      err,
+			praktor::timeout::handler&&           handler) override;
+
+	struct dispatch_node
+	{
+		// both signatures are stored as given, so neither is wrapped in a
+		// closure that would outgrow unique_function's inline storage
+		using handler_slot = std::variant<void_handler, loop::dispatch_handler>;
+
+		dispatch_node* m_next;
+		handler_slot   m_handler;
+	};
+
+	// handlers in flight at once beyond this many allocate their nodes
+	static constexpr std::size_t spare_dispatch_node_count = 64;
 
-	bool
-	try_dispatch_front();
+	using dispatch_node_cache = node_cache<dispatch_node, spare_dispatch_node_count>;
+
+	void
+	enqueue_dispatch(std::error_code& err, dispatch_node::handler_slot&& handler);
+
+	void
+	recycle_dispatch_node(dispatch_node* node);
+
+	void
+	invoke_dispatch_handler(dispatch_node::handler_slot& handler);
 
 	static void
 	on_async(uv_async_t* handle);
 
 	void
-	drain_dispatch_queue()
-	{
-		while (try_dispatch_front())
-			;
-	}
+	drain_dispatch_queue();
+
+	void
+	discard_dispatch_queue();
+
+	void
+	discard_dispatch_nodes(dispatch_node* node);
+
+	void
+	close_dispatch_queue();
 
 	uv_async_t                         m_async_handle;
-	std::deque<void_handler>           m_dispatch_queue;
-	std::recursive_mutex               m_dispatch_queue_mutex;
+	mpsc_queue<dispatch_node>          m_dispatch_queue;
+	dispatch_node_cache                m_spare_dispatch_nodes;
+	std::atomic<bool>                  m_dispatch_closed;       // set once by close(); producers then fail
+	std::atomic<std::size_t>           m_dispatch_producers;    // producers between the closed check and async send
 	uv_loop_t*                         m_uv_loop;
 	loop_data                          m_data;
 	bool                               m_is_default_loop;
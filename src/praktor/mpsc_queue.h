@@ -0,0 +1,107 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef PRAKTOR_MPSC_QUEUE_H
+#define PRAKTOR_MPSC_QUEUE_H
+
+#include <atomic>
+
+/** \brief Lock-free, intrusive, multi-producer/single-consumer queue.
+ *
+ * Producers push nodes with a single compare-and-swap on the head pointer.
+ * The consumer never pops individual nodes; it detaches the entire pending
+ * batch with one atomic exchange and receives it as a singly-linked list
+ * in FIFO order.
+ *
+ * T must have a public data member m_next of type T*. The queue does not
+ * own the nodes; nodes still linked when the queue is destroyed must be
+ * reclaimed by the owner (see take_all()).
+ */
+template<class T>
+class mpsc_queue
+{
+public:
+	mpsc_queue() : m_head{nullptr} {}
+
+	mpsc_queue(mpsc_queue const&) = delete;
+	mpsc_queue(mpsc_queue&&)      = delete;
+
+	mpsc_queue&
+	operator=(mpsc_queue const&)
+			= delete;
+
+	mpsc_queue&
+	operator=(mpsc_queue&&)
+			= delete;
+
+	/** \brief Pushes a node. Safe to call from any thread.
+	 *
+	 * \return true if the queue was empty before the push, i.e. the caller
+	 * is responsible for waking the consumer.
+	 */
+	bool
+	push(T* node)
+	{
+		T* head = m_head.load(std::memory_order_relaxed);
+		do
+		{
+			node->m_next = head;
+		}
+		while (!m_head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+		return head == nullptr;
+	}
+
+	/** \brief Detaches every pending node. Consumer only.
+	 *
+	 * \return the first node of the detached batch (oldest first), or nullptr
+	 * if the queue was empty.
+	 */
+	T*
+	take_all()
+	{
+		T* node = m_head.exchange(nullptr, std::memory_order_acquire);
+
+		// nodes were pushed onto the front; reverse to restore FIFO order
+		T* result = nullptr;
+		while (node)
+		{
+			T* next      = node->m_next;
+			node->m_next = result;
+			result       = node;
+			node         = next;
+		}
+		return result;
+	}
+
+	bool
+	empty() const
+	{
+		return m_head.load(std::memory_order_acquire) == nullptr;
+	}
+
+private:
+	std::atomic<T*> m_head;
+};
+
+#endif    // PRAKTOR_MPSC_QUEUE_H
@@ -0,0 +1,114 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef PRAKTOR_NODE_CACHE_H
+#define PRAKTOR_NODE_CACHE_H
+
+#include <atomic>
+#include <cstddef>
+
+/** \brief Lock-free, fixed-size cache of spare nodes shared between threads.
+ *
+ * Each slot holds at most one node. take() claims a node with an atomic
+ * exchange, so a node is never handed out twice and, unlike popping a
+ * linked free list, no stale next pointer can be followed. put() only
+ * fills an empty slot. When the cache is empty, callers allocate; when it
+ * is full, they free the node instead. Nodes still cached are deleted with
+ * the cache.
+ */
+template<class T, std::size_t N>
+class node_cache
+{
+public:
+	node_cache()
+	{
+		for (auto& slot : m_slots)
+		{
+			slot.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	~node_cache()
+	{
+		for (auto& slot : m_slots)
+		{
+			delete slot.exchange(nullptr, std::memory_order_acquire);
+		}
+	}
+
+	node_cache(node_cache const&) = delete;
+	node_cache(node_cache&&)      = delete;
+
+	node_cache&
+	operator=(node_cache const&)
+			= delete;
+
+	node_cache&
+	operator=(node_cache&&)
+			= delete;
+
+	/** \brief Claims a cached node. Safe to call from any thread.
+	 *
+	 * \return the node, or nullptr if every slot was empty.
+	 */
+	T*
+	take()
+	{
+		for (auto& slot : m_slots)
+		{
+			if (slot.load(std::memory_order_relaxed) != nullptr)
+			{
+				if (auto node = slot.exchange(nullptr, std::memory_order_acquire))
+				{
+					return node;
+				}
+			}
+		}
+		return nullptr;
+	}
+
+	/** \brief Caches a node. Safe to call from any thread.
+	 *
+	 * \return false if every slot was full; the caller still owns the node.
+	 */
+	bool
+	put(T* node)
+	{
+		for (auto& slot : m_slots)
+		{
+			T* expected = nullptr;
+			if (slot.load(std::memory_order_relaxed) == nullptr
+				&& slot.compare_exchange_strong(expected, node, std::memory_order_release, std::memory_order_relaxed))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+private:
+	std::atomic<T*> m_slots[N];
+};
+
+#endif    // PRAKTOR_NODE_CACHE_H
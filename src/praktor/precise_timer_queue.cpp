@@ -0,0 +1,373 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "precise_timer_queue.h"
+#include "uv_error.h"
+
+#if defined(PRAKTOR_TIMERFD)
+#include <sys/timerfd.h>
+#include <unistd.h>
+#endif
+
+precise_timer_queue::precise_timer_queue()
+	:
+#if defined(PRAKTOR_TIMERFD)
+	  m_fd{-1},
+	  m_use_timerfd{false},
+#endif
+	  m_is_initialized{false},
+	  m_is_expiring{false},
+	  m_armed_for{std::chrono::steady_clock::time_point::max()},
+	  m_sequence{0},
+	  m_pool{this}
+{}
+
+void
+precise_timer_queue::init(uv_loop_t* lp, std::error_code& err)
+{
+	err.clear();
+	int status = 0;
+
+	status = uv_timer_init(lp, &m_timer);
+	UV_ERROR_CHECK(status, err, exit);
+	uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_timer), this);
+
+#if defined(PRAKTOR_TIMERFD)
+	// without a timerfd the queue still works, on the timer alone
+	m_fd = ::timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (m_fd >= 0)
+	{
+		if (uv_poll_init(lp, &m_poll, m_fd) < 0)
+		{
+			::close(m_fd);
+			m_fd = -1;
+		}
+		else
+		{
+			uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_poll), this);
+			m_use_timerfd = true;
+		}
+	}
+#endif
+	m_is_initialized = true;
+exit:
+	return;
+}
+
+praktor::timeout
+precise_timer_queue::add(
+		uv_loop_t*                            lp,
+		std::chrono::steady_clock::time_point deadline,
+		std::error_code&                      err,
+		praktor::timeout::handler&&           handler)
+{
+	err.clear();
+	praktor::timeout      result;
+	precise_timer_entry* entry = nullptr;
+
+	if (!m_is_initialized)
+	{
+		init(lp, err);
+		if (err)
+			goto exit;
+	}
+
+	entry             = m_pool.acquire();
+	entry->m_deadline = deadline;
+	entry->m_sequence = m_sequence++;
+	entry->m_handler  = std::move(handler);
+	push(entry);
+	if (!m_is_expiring && entry->m_heap_index == 0)
+	{
+		arm();
+	}
+	result = make_handle(entry);
+exit:
+	return result;
+}
+
+void
+precise_timer_queue::cancel(timeout_entry* base)
+{
+	auto entry = static_cast<precise_timer_entry*>(base);
+	remove(entry);
+	auto handler = std::move(entry->m_handler);
+	m_pool.release(entry);
+	if (m_heap.empty() && !m_is_expiring)
+	{
+		disarm();
+	}
+}
+
+void
+precise_timer_queue::restart(timeout_entry* base, std::chrono::microseconds delay)
+{
+	auto entry = static_cast<precise_timer_entry*>(base);
+	remove(entry);
+	entry->m_deadline = std::chrono::steady_clock::now() + delay;
+	entry->m_sequence = m_sequence++;
+	push(entry);
+	if (!m_is_expiring && entry->m_heap_index == 0)
+	{
+		arm();
+	}
+}
+
+void
+precise_timer_queue::clear()
+{
+	while (!m_heap.empty())
+	{
+		auto entry = m_heap.back();
+		m_heap.pop_back();
+		auto handler = std::move(entry->m_handler);
+		m_pool.release(entry);
+	}
+	if (m_is_initialized)
+	{
+		disarm();
+	}
+}
+
+bool
+precise_timer_queue::owns(uv_handle_t const* handle) const
+{
+	if (!m_is_initialized)
+	{
+		return false;
+	}
+#if defined(PRAKTOR_TIMERFD)
+	if (m_fd >= 0 && handle == reinterpret_cast<uv_handle_t const*>(&m_poll))
+	{
+		return true;
+	}
+#endif
+	return handle == reinterpret_cast<uv_handle_t const*>(&m_timer);
+}
+
+void
+precise_timer_queue::close_handle(uv_handle_t* handle)
+{
+#if defined(PRAKTOR_TIMERFD)
+	if (uv_handle_get_type(handle) == UV_POLL)
+	{
+		uv_close(handle, on_poll_close);
+		return;
+	}
+#endif
+	uv_close(handle, nullptr);
+}
+
+void
+precise_timer_queue::push(precise_timer_entry* entry)
+{
+	m_heap.push_back(entry);
+	entry->m_heap_index = m_heap.size() - 1;
+	sift_up(entry->m_heap_index);
+}
+
+void
+precise_timer_queue::remove(precise_timer_entry* entry)
+{
+	auto index = entry->m_heap_index;
+	auto last  = m_heap.back();
+	m_heap.pop_back();
+	if (index < m_heap.size())
+	{
+		place(index, last);
+		sift_up(index);
+		sift_down(last->m_heap_index);
+	}
+}
+
+void
+precise_timer_queue::sift_up(std::size_t index)
+{
+	auto entry = m_heap[index];
+	while (index > 0)
+	{
+		auto parent = (index - 1) / 2;
+		if (!is_before(entry, m_heap[parent]))
+		{
+			break;
+		}
+		place(index, m_heap[parent]);
+		index = parent;
+	}
+	place(index, entry);
+}
+
+void
+precise_timer_queue::sift_down(std::size_t index)
+{
+	auto entry = m_heap[index];
+	auto count = m_heap.size();
+	for (auto child = 2 * index + 1; child < count; child = 2 * index + 1)
+	{
+		if (child + 1 < count && is_before(m_heap[child + 1], m_heap[child]))
+		{
+			++child;
+		}
+		if (!is_before(m_heap[child], entry))
+		{
+			break;
+		}
+		place(index, m_heap[child]);
+		index = child;
+	}
+	place(index, entry);
+}
+
+void
+precise_timer_queue::expire()
+{
+	// only entries armed before this pass may fire in it, so a handler that
+	// re-arms with a zero delay cannot keep the loop here
+	auto now     = std::chrono::steady_clock::now();
+	auto horizon = m_sequence;
+
+	m_is_expiring = true;
+	while (!m_heap.empty() && m_heap.front()->m_deadline <= now && m_heap.front()->m_sequence < horizon)
+	{
+		auto entry = m_heap.front();
+		remove(entry);
+		auto handler = std::move(entry->m_handler);
+		m_pool.release(entry);
+		handler();
+	}
+	m_is_expiring = false;
+	arm();
+}
+
+void
+precise_timer_queue::arm()
+{
+	if (m_heap.empty())
+	{
+		disarm();
+		return;
+	}
+
+	auto deadline = m_heap.front()->m_deadline;
+	if (deadline == m_armed_for)
+	{
+		return;
+	}
+	m_armed_for = deadline;
+
+#if defined(PRAKTOR_TIMERFD)
+	if (m_use_timerfd)
+	{
+		// steady_clock reads CLOCK_MONOTONIC; a zero it_value would disarm
+		auto              ns = std::chrono::duration_cast<std::chrono::nanoseconds>(deadline.time_since_epoch()).count();
+		struct itimerspec spec{};
+		spec.it_value.tv_sec  = ns > 0 ? ns / 1000000000 : 0;
+		spec.it_value.tv_nsec = ns > 0 ? ns % 1000000000 : 1;
+		if (::timerfd_settime(m_fd, TFD_TIMER_ABSTIME, &spec, nullptr) == 0
+			&& (uv_is_active(reinterpret_cast<uv_handle_t*>(&m_poll))
+				|| uv_poll_start(&m_poll, UV_READABLE, on_poll) == 0))
+		{
+			return;
+		}
+		fall_back();
+	}
+#endif
+	{
+		// libuv counts whole milliseconds from its cached time; round up, and
+		// let expire() re-arm if that still lands short of the deadline
+		auto delay = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+		uv_timer_start(&m_timer, on_timer, delay > 0 ? delay : 0, 0);
+	}
+}
+
+void
+precise_timer_queue::disarm()
+{
+	m_armed_for = std::chrono::steady_clock::time_point::max();
+#if defined(PRAKTOR_TIMERFD)
+	if (m_use_timerfd)
+	{
+		// a timerfd left armed would wake the loop for nothing
+		struct itimerspec spec{};
+		if (::timerfd_settime(m_fd, 0, &spec, nullptr) == 0)
+		{
+			uv_poll_stop(&m_poll);
+			return;
+		}
+		fall_back();
+	}
+#endif
+	uv_timer_stop(&m_timer);
+}
+
+void
+precise_timer_queue::on_timer(uv_timer_t* handle)
+{
+	auto self         = reinterpret_cast<precise_timer_queue*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(handle)));
+	self->m_armed_for = std::chrono::steady_clock::time_point::max();
+	self->expire();
+}
+
+#if defined(PRAKTOR_TIMERFD)
+
+// Hands the queue over to the timer for good; the poll handle stays open,
+// idle, until the loop's handle walk closes it.
+void
+precise_timer_queue::fall_back()
+{
+	m_use_timerfd = false;
+	uv_poll_stop(&m_poll);
+}
+
+void
+precise_timer_queue::on_poll(uv_poll_t* handle, int status, int)
+{
+	auto self = reinterpret_cast<precise_timer_queue*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(handle)));
+
+	if (status < 0)
+	{
+		// polling again would only report the same error; re-arm on the timer
+		self->fall_back();
+		self->m_armed_for = std::chrono::steady_clock::time_point::max();
+		self->arm();
+		return;
+	}
+
+	std::uint64_t expirations;
+	while (::read(self->m_fd, &expirations, sizeof(expirations)) > 0)
+		;
+	self->m_armed_for = std::chrono::steady_clock::time_point::max();
+	self->expire();
+}
+
+void
+precise_timer_queue::on_poll_close(uv_handle_t* handle)
+{
+	auto self = reinterpret_cast<precise_timer_queue*>(uv_handle_get_data(handle));
+	::close(self->m_fd);
+	self->m_fd = -1;
+}
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef PRAKTOR_PRECISE_TIMER_QUEUE_H
+#define PRAKTOR_PRECISE_TIMER_QUEUE_H
+
+#include "timeout_queue.h"
+#include <chrono>
+#include <cstdint>
+#include <system_error>
+#include <uv.h>
+#include <vector>
+
+// timerfd gives microsecond-accurate wakeups on the monotonic clock that
+// std::chrono::steady_clock reads; elsewhere fall back to a libuv timer
+#if defined(__linux__)
+#define PRAKTOR_TIMERFD 1
+#endif
+
+struct precise_timer_entry : timeout_entry
+{
+	std::chrono::steady_clock::time_point m_deadline;
+	std::uint64_t                         m_sequence;    // orders equal deadlines first-armed-first
+	std::size_t                           m_heap_index;
+};
+
+/** \brief Per-loop queue backing loop::set_precise_timeout().
+ *
+ * Entries sit in a binary min-heap ordered by steady_clock deadline, so
+ * arming and cancelling cost O(log n). On Linux a single timerfd, watched
+ * by a uv_poll_t, is set to the earliest deadline with TFD_TIMER_ABSTIME,
+ * which wakes the loop within tens of microseconds instead of at libuv's
+ * millisecond granularity. Elsewhere a uv_timer_t rounded up to the next
+ * millisecond stands in, keeping the never-early guarantee but not the
+ * resolution. A timerfd that cannot be created, set or polled hands over
+ * to that timer for the rest of the queue's life.
+ *
+ * The handles are created on first use.
+ */
+class precise_timer_queue : public timeout_queue
+{
+public:
+	precise_timer_queue();
+
+	precise_timer_queue(precise_timer_queue const&) = delete;
+	precise_timer_queue(precise_timer_queue&&)      = delete;
+
+	precise_timer_queue&
+	operator=(precise_timer_queue const&)
+			= delete;
+
+	precise_timer_queue&
+	operator=(precise_timer_queue&&)
+			= delete;
+
+	praktor::timeout
+	add(uv_loop_t*                            lp,
+		std::chrono::steady_clock::time_point deadline,
+		std::error_code&                      err,
+		praktor::timeout::handler&&           handler);
+
+	virtual void
+	cancel(timeout_entry* entry) override;
+
+	virtual void
+	restart(timeout_entry* entry, std::chrono::microseconds delay) override;
+
+	/** \brief Destroys pending handlers without invoking them; for loop close.
+	 *
+	 * The handle itself is closed by the loop's handle walk.
+	 */
+	void
+	clear();
+
+	bool
+	owns(uv_handle_t const* handle) const;
+
+	/** \brief Closes a handle for which owns() is true; for the loop's handle walk.
+	 */
+	static void
+	close_handle(uv_handle_t* handle);
+
+	std::size_t
+	size() const
+	{
+		return m_heap.size();
+	}
+
+private:
+	void
+	init(uv_loop_t* lp, std::error_code& err);
+
+	void
+	push(precise_timer_entry* entry);
+
+	void
+	remove(precise_timer_entry* entry);
+
+	bool
+	is_before(precise_timer_entry const* a, precise_timer_entry const* b) const
+	{
+		return a->m_deadline < b->m_deadline || (a->m_deadline == b->m_deadline && a->m_sequence < b->m_sequence);
+	}
+
+	void
+	sift_up(std::size_t index);
+
+	void
+	sift_down(std::size_t index);
+
+	void
+	place(std::size_t index, precise_timer_entry* entry)
+	{
+		m_heap[index]       = entry;
+		entry->m_heap_index = index;
+	}
+
+	void
+	expire();
+
+	void
+	arm();
+
+	void
+	disarm();
+
+	static void
+	on_timer(uv_timer_t* handle);
+
+#if defined(PRAKTOR_TIMERFD)
+	void
+	fall_back();
+
+	static void
+	on_poll(uv_poll_t* handle, int status, int events);
+
+	static void
+	on_poll_close(uv_handle_t* handle);
+
+	uv_poll_t m_poll;
+	int       m_fd;
+	bool      m_use_timerfd;
+#endif
+	uv_timer_t m_timer;
+	bool                                    m_is_initialized;
+	bool                                    m_is_expiring;
+	std::chrono::steady_clock::time_point   m_armed_for;
+	std::uint64_t                           m_sequence;
+	std::vector<precise_timer_entry*>       m_heap;
+	timeout_entry_pool<precise_timer_entry> m_pool;
+};
+
+#endif    // PRAKTOR_PRECISE_TIMER_QUEUE_H
@@ -0,0 +1,227 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "read_buffer_pool.h"
+#include <cassert>
+#include <new>
+
+namespace
+{
+
+std::size_t
+round_up_pow2(std::size_t value)
+{
+	std::size_t result{1};
+	while (result < value)
+	{
+		result <<= 1;
+	}
+	return result;
+}
+
+}    // namespace
+
+read_buffer_pool::read_buffer_pool() : m_stats{}
+{
+	std::error_code err;
+	configure(praktor::buffer_pool_config{}, err);
+	assert(!err);
+}
+
+read_buffer_pool::~read_buffer_pool()
+{
+	// No block can still be outstanding; each one holds a reference to us.
+	drain_returns();
+	free_cached_blocks();
+}
+
+util::byte_type*
+read_buffer_pool::allocate(std::size_t size, std::size_t& capacity)
+{
+	if (!m_returns.empty())
+	{
+		drain_returns();
+	}
+
+	block_header* block{nullptr};
+	if (size <= m_max_block_size)
+	{
+		auto index = class_of(size);
+		block      = m_free_lists[index];
+		if (block)
+		{
+			m_free_lists[index] = block->m_next;
+			--m_free_counts[index];
+			--m_stats.cached_blocks;
+			m_stats.cached_bytes -= block->m_capacity;
+			++m_stats.cache_hits;
+		}
+		else
+		{
+			block = new_block(class_size(index));
+		}
+	}
+	else
+	{
+		block = new_block(size);
+	}
+
+	block->m_pool = shared_from_this();
+	block->m_refs.store(1, std::memory_order_relaxed);
+	++m_stats.allocations;
+	++m_stats.outstanding;
+	capacity = block->m_capacity;
+	return data_of(block);
+}
+
+void
+read_buffer_pool::release(util::byte_type* data)
+{
+	auto block = header_of(data);
+
+	// a block shared by slices returns on the last release; an unshared one
+	// skips the atomic decrement
+	if (block->m_refs.load(std::memory_order_acquire) != 1
+		&& block->m_refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+	{
+		return;
+	}
+
+	auto pool = std::move(block->m_pool);
+	pool->m_returns.push(block);
+	// if that was the last reference, the pool is destroyed here and frees the block
+}
+
+void
+read_buffer_pool::configure(praktor::buffer_pool_config const& config, std::error_code& err)
+{
+	err.clear();
+	if (config.min_block_size() < 1 || config.max_block_size() < config.min_block_size() || config.read_size() < 1)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		return;
+	}
+
+	drain_returns();
+	free_cached_blocks();
+
+	m_config         = config;
+	m_min_block_size = round_up_pow2(config.min_block_size());
+	m_max_block_size = round_up_pow2(config.max_block_size());
+
+	auto class_count = class_of(m_max_block_size) + 1;
+	m_free_lists.assign(class_count, nullptr);
+	m_free_counts.assign(class_count, 0);
+}
+
+praktor::buffer_pool_stats
+read_buffer_pool::get_stats()
+{
+	drain_returns();
+	return m_stats;
+}
+
+read_buffer_pool::block_header*
+read_buffer_pool::new_block(std::size_t capacity)
+{
+	auto block = new (::operator new(sizeof(block_header) + capacity)) block_header;
+	block->m_next     = nullptr;
+	block->m_capacity = capacity;
+	return block;
+}
+
+void
+read_buffer_pool::free_block(block_header* block)
+{
+	block->~block_header();
+	::operator delete(block);
+}
+
+std::size_t
+read_buffer_pool::class_of(std::size_t size) const
+{
+	std::size_t index{0};
+	while (class_size(index) < size)
+	{
+		++index;
+	}
+	return index;
+}
+
+void
+read_buffer_pool::drain_returns()
+{
+	auto block = m_returns.take_all();
+	while (block)
+	{
+		auto next = block->m_next;
+		recycle(block);
+		block = next;
+	}
+}
+
+void
+read_buffer_pool::recycle(block_header* block)
+{
+	++m_stats.returns;
+	--m_stats.outstanding;
+
+	// blocks that are oversized, or from before a reconfiguration, may not
+	// match any current size class
+	if (block->m_capacity <= m_max_block_size)
+	{
+		auto index = class_of(block->m_capacity);
+		if (class_size(index) == block->m_capacity && m_free_counts[index] < m_config.max_cached_blocks())
+		{
+			block->m_next       = m_free_lists[index];
+			m_free_lists[index] = block;
+			++m_free_counts[index];
+			++m_stats.cached_blocks;
+			m_stats.cached_bytes += block->m_capacity;
+			return;
+		}
+	}
+
+	++m_stats.frees;
+	free_block(block);
+}
+
+void
+read_buffer_pool::free_cached_blocks()
+{
+	for (std::size_t i = 0; i < m_free_lists.size(); ++i)
+	{
+		auto block = m_free_lists[i];
+		while (block)
+		{
+			auto next = block->m_next;
+			free_block(block);
+			block = next;
+		}
+		m_free_lists[i]  = nullptr;
+		m_free_counts[i] = 0;
+	}
+	m_stats.cached_blocks = 0;
+	m_stats.cached_bytes  = 0;
+}
@@ -0,0 +1,198 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef PRAKTOR_READ_BUFFER_POOL_H
+#define PRAKTOR_READ_BUFFER_POOL_H
+
+#include "mpsc_queue.h"
+#include <atomic>
+#include <memory>
+#include <praktor/buffer_pool.h>
+#include <system_error>
+#include <util/buffer.h>
+#include <vector>
+
+/** \brief Per-loop pool of recyclable read buffer blocks.
+ *
+ * Blocks are handed out by allocate() on the loop's thread and wrapped in
+ * a util::const_buffer whose deleter returns the block to the pool. The
+ * buffer may be released on any thread: the block is pushed onto a
+ * lock-free return queue, which the loop drains into per-size-class free
+ * lists the next time it allocates.
+ *
+ * Every outstanding block holds a reference to its pool, so buffers may
+ * safely outlive the loop that filled them. A block may also be shared by
+ * several slices (see make_slice()); it returns to the pool once the last
+ * of them is released.
+ */
+class read_buffer_pool : public std::enable_shared_from_this<read_buffer_pool>
+{
+public:
+	using ptr = std::shared_ptr<read_buffer_pool>;
+
+	struct deleter
+	{
+		void
+		operator()(util::byte_type* data) const
+		{
+			release(data);
+		}
+	};
+
+	struct slice_deleter
+	{
+		void
+		operator()(util::byte_type*) const
+		{
+			release(m_block);
+		}
+
+		util::byte_type* m_block;
+	};
+
+	read_buffer_pool();
+
+	~read_buffer_pool();
+
+	read_buffer_pool(read_buffer_pool const&) = delete;
+	read_buffer_pool(read_buffer_pool&&)      = delete;
+
+	read_buffer_pool&
+	operator=(read_buffer_pool const&)
+			= delete;
+
+	read_buffer_pool&
+	operator=(read_buffer_pool&&)
+			= delete;
+
+	/** \brief Allocates a block of at least size bytes. Loop thread only.
+	 *
+	 * \param capacity receives the usable size of the block.
+	 */
+	util::byte_type*
+	allocate(std::size_t size, std::size_t& capacity);
+
+	util::byte_type*
+	allocate_for_read(std::size_t& capacity)
+	{
+		return allocate(m_config.read_size(), capacity);
+	}
+
+	/** \brief Returns a block to its pool. Safe to call from any thread.
+	 */
+	static void
+	release(util::byte_type* data);
+
+	/** \brief Wraps size bytes of an allocated block in a const_buffer that
+	 * returns the block on release.
+	 */
+	static util::const_buffer
+	make_buffer(util::byte_type* data, std::size_t size)
+	{
+		return util::const_buffer{data, size, deleter{}};
+	}
+
+	/** \brief Wraps size bytes at offset within an allocated block in a
+	 * const_buffer that shares the block. Loop thread only.
+	 *
+	 * The caller keeps its own reference, and still releases the block.
+	 */
+	static util::const_buffer
+	make_slice(util::byte_type* data, std::size_t offset, std::size_t size)
+	{
+		header_of(data)->m_refs.fetch_add(1, std::memory_order_relaxed);
+		return util::const_buffer{data + offset, size, slice_deleter{data}};
+	}
+
+	/** \brief Replaces the configuration and frees every cached block. Loop thread only.
+	 */
+	void
+	configure(praktor::buffer_pool_config const& config, std::error_code& err);
+
+	praktor::buffer_pool_config const&
+	config() const
+	{
+		return m_config;
+	}
+
+	/** \brief Loop thread only.
+	 */
+	praktor::buffer_pool_stats
+	get_stats();
+
+private:
+	struct alignas(16) block_header
+	{
+		block_header*            m_next;
+		ptr                      m_pool;
+		std::size_t              m_capacity;
+		std::atomic<std::size_t> m_refs;
+	};
+
+	static block_header*
+	header_of(util::byte_type* data)
+	{
+		return reinterpret_cast<block_header*>(data) - 1;
+	}
+
+	static util::byte_type*
+	data_of(block_header* block)
+	{
+		return reinterpret_cast<util::byte_type*>(block + 1);
+	}
+
+	static block_header*
+	new_block(std::size_t capacity);
+
+	static void
+	free_block(block_header* block);
+
+	std::size_t
+	class_of(std::size_t size) const;
+
+	std::size_t
+	class_size(std::size_t index) const
+	{
+		return m_min_block_size << index;
+	}
+
+	void
+	drain_returns();
+
+	void
+	recycle(block_header* block);
+
+	void
+	free_cached_blocks();
+
+	praktor::buffer_pool_config m_config;
+	std::size_t                 m_min_block_size;
+	std::size_t                 m_max_block_size;
+	std::vector<block_header*>  m_free_lists;
+	std::vector<std::size_t>    m_free_counts;
+	mpsc_queue<block_header>    m_returns;
+	praktor::buffer_pool_stats  m_stats;
+};
+
+#endif    // PRAKTOR_READ_BUFFER_POOL_H
@@ -0,0 +1,91 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "receive_slab.h"
+#include <new>
+
+namespace
+{
+
+constexpr std::size_t slot_alignment = 64;
+
+}    // namespace
+
+receive_slab::receive_slab(std::size_t slot_size)
+	: m_slot_size{slot_size},
+	  m_stride{(sizeof(slot_header) + slot_size + slot_alignment - 1) & ~(slot_alignment - 1)},
+	  m_free{nullptr}
+{}
+
+receive_slab::~receive_slab()
+{
+	// Every slot is back by now (each outstanding one holds a reference to
+	// us), so the chunks can go; the headers hold nothing but null pointers.
+	for (auto& chunk : m_chunks)
+	{
+		for (std::size_t i = 0; i < slots_per_chunk; ++i)
+		{
+			reinterpret_cast<slot_header*>(chunk.get() + i * m_stride)->~slot_header();
+		}
+	}
+}
+
+util::byte_type*
+receive_slab::acquire()
+{
+	if (!m_free)
+	{
+		m_free = m_returns.take_all();
+		if (!m_free)
+		{
+			add_chunk();
+		}
+	}
+
+	auto slot    = m_free;
+	m_free       = slot->m_next;
+	slot->m_slab = shared_from_this();
+	return data_of(slot);
+}
+
+void
+receive_slab::release(util::byte_type* data)
+{
+	auto slot = header_of(data);
+	auto slab = std::move(slot->m_slab);
+	slab->m_returns.push(slot);
+}
+
+void
+receive_slab::add_chunk()
+{
+	m_chunks.emplace_back(new util::byte_type[m_stride * slots_per_chunk]);
+	auto base = m_chunks.back().get();
+	for (std::size_t i = slots_per_chunk; i-- > 0;)
+	{
+		auto slot    = new (base + i * m_stride) slot_header;
+		slot->m_next = m_free;
+		m_free       = slot;
+	}
+}
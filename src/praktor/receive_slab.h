@@ -0,0 +1,133 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef PRAKTOR_RECEIVE_SLAB_H
+#define PRAKTOR_RECEIVE_SLAB_H
+
+#include "mpsc_queue.h"
+#include <memory>
+#include <util/buffer.h>
+#include <vector>
+
+/** \brief Fixed-size datagram receive slots carved from contiguous chunks.
+ *
+ * Each transceiver owns one slab whose slot size is the largest datagram it
+ * accepts. Slots are acquired on the loop's thread and handed out as
+ * util::const_buffer slices; releasing the buffer (on any thread) returns
+ * the slot through a lock-free queue that acquire() drains. When every
+ * slot is in use the slab grows by another chunk; chunks are freed only
+ * when the slab is destroyed.
+ *
+ * Every outstanding slot holds a reference to its slab, so buffers may
+ * safely outlive the transceiver that received them.
+ */
+class receive_slab : public std::enable_shared_from_this<receive_slab>
+{
+public:
+	using ptr = std::shared_ptr<receive_slab>;
+
+	static constexpr std::size_t slots_per_chunk = 16;
+
+	struct deleter
+	{
+		void
+		operator()(util::byte_type* data) const
+		{
+			release(data);
+		}
+	};
+
+	explicit receive_slab(std::size_t slot_size);
+
+	~receive_slab();
+
+	receive_slab(receive_slab const&) = delete;
+	receive_slab(receive_slab&&)      = delete;
+
+	receive_slab&
+	operator=(receive_slab const&)
+			= delete;
+
+	receive_slab&
+	operator=(receive_slab&&)
+			= delete;
+
+	/** \brief Returns a free slot of slot_size() bytes. Loop thread only.
+	 */
+	util::byte_type*
+	acquire();
+
+	/** \brief Returns a slot to its slab. Safe to call from any thread.
+	 */
+	static void
+	release(util::byte_type* data);
+
+	static util::const_buffer
+	make_buffer(util::byte_type* data, std::size_t size)
+	{
+		return util::const_buffer{data, size, deleter{}};
+	}
+
+	std::size_t
+	slot_size() const
+	{
+		return m_slot_size;
+	}
+
+	std::size_t
+	chunk_count() const
+	{
+		return m_chunks.size();
+	}
+
+private:
+	struct alignas(16) slot_header
+	{
+		slot_header* m_next;
+		ptr          m_slab;
+	};
+
+	static slot_header*
+	header_of(util::byte_type* data)
+	{
+		return reinterpret_cast<slot_header*>(data) - 1;
+	}
+
+	static util::byte_type*
+	data_of(slot_header* slot)
+	{
+		return reinterpret_cast<util::byte_type*>(slot + 1);
+	}
+
+	void
+	add_chunk();
+
+	std::size_t                                     m_slot_size;
+	std::size_t                                     m_stride;
+	std::vector<std::unique_ptr<util::byte_type[]>> m_chunks;
+	slot_header*                                    m_free;
+	mpsc_queue<slot_header>                         m_returns;
+};
+
+#endif    // PRAKTOR_RECEIVE_SLAB_H
@@ -0,0 +1,106 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "request_pool.h"
+#include "loop_uv.h"
+#include <new>
+
+request_pool::request_pool() : m_stats{}
+{
+	for (std::size_t i = 0; i < class_count; ++i)
+	{
+		m_free_lists[i]  = nullptr;
+		m_free_counts[i] = 0;
+	}
+}
+
+request_pool::~request_pool()
+{
+	for (std::size_t i = 0; i < class_count; ++i)
+	{
+		while (m_free_lists[i])
+		{
+			auto block      = m_free_lists[i];
+			m_free_lists[i] = block->m_next;
+			::operator delete(block);
+		}
+	}
+}
+
+request_pool&
+request_pool::of(uv_loop_t* lp)
+{
+	return reinterpret_cast<loop_data*>(lp->data)->m_request_pool;
+}
+
+void*
+request_pool::allocate(std::size_t size)
+{
+	std::size_t   index = (size + class_granularity - 1) / class_granularity - 1;
+	block_header* block{nullptr};
+	++m_stats.requests;
+	if (index >= class_count)
+	{
+		block = static_cast<block_header*>(::operator new(sizeof(block_header) + size));
+	}
+	else if (m_free_lists[index])
+	{
+		block               = m_free_lists[index];
+		m_free_lists[index] = block->m_next;
+		--m_free_counts[index];
+		++m_stats.cache_hits;
+	}
+	else
+	{
+		block = static_cast<block_header*>(
+				::operator new(sizeof(block_header) + (index + 1) * class_granularity));
+	}
+	block->m_next  = nullptr;
+	block->m_pool  = this;
+	block->m_class = index;
+	return block + 1;
+}
+
+void
+request_pool::release(void* p)
+{
+	if (!p)
+	{
+		return;
+	}
+	auto block = static_cast<block_header*>(p) - 1;
+	auto pool  = block->m_pool;
+	auto index = block->m_class;
+	if (index >= class_count || pool->m_free_counts[index] >= max_cached_per_class)
+	{
+		::operator delete(block);
+	}
+	else
+	{
+		block->m_next             = pool->m_free_lists[index];
+		pool->m_free_lists[index] = block;
+		++pool->m_free_counts[index];
+	}
+}
@@ -0,0 +1,127 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef PRAKTOR_REQUEST_POOL_H
+#define PRAKTOR_REQUEST_POOL_H
+
+#include <cstddef>
+#include <praktor/loop.h>
+#include <uv.h>
+
+/** \brief Per-loop free lists for libuv request objects.
+ *
+ * Write, send, connect and resolve requests live from the call that starts
+ * them until their libuv callback runs, so every operation used to cost a
+ * heap allocation. Request types derived from pooled_request are instead
+ * created with new (pool) and released with plain delete, which returns the
+ * block to the free list of its size class. Blocks larger than the largest
+ * class go to the heap.
+ *
+ * Requests are created and released on the loop's thread; libuv completes
+ * every request before the loop closes, so no block outlives its pool.
+ */
+class request_pool
+{
+public:
+	static constexpr std::size_t class_granularity    = 64;
+	static constexpr std::size_t class_count          = 16;
+	static constexpr std::size_t max_cached_per_class = 256;
+
+	request_pool();
+
+	~request_pool();
+
+	request_pool(request_pool const&) = delete;
+	request_pool(request_pool&&)      = delete;
+
+	request_pool&
+	operator=(request_pool const&)
+			= delete;
+
+	request_pool&
+	operator=(request_pool&&)
+			= delete;
+
+	/** \brief Returns the pool of the loop lp.
+	 */
+	static request_pool&
+	of(uv_loop_t* lp);
+
+	/** \brief Allocates a block of at least size bytes. Loop thread only.
+	 */
+	void*
+	allocate(std::size_t size);
+
+	/** \brief Returns a block to the pool it came from. Loop thread only.
+	 */
+	static void
+	release(void* p);
+
+	praktor::request_pool_stats
+	get_stats() const
+	{
+		return m_stats;
+	}
+
+private:
+	struct alignas(16) block_header
+	{
+		block_header* m_next;
+		request_pool* m_pool;
+		std::size_t   m_class;
+	};
+
+	block_header*               m_free_lists[class_count];
+	std::size_t                 m_free_counts[class_count];
+	praktor::request_pool_stats m_stats;
+};
+
+/** \brief Base for request types allocated from a request_pool.
+ *
+ * Hides the global operator new, so a pooled request can only be created
+ * with new (pool) T{...}.
+ */
+struct pooled_request
+{
+	static void*
+	operator new(std::size_t size, request_pool& pool)
+	{
+		return pool.allocate(size);
+	}
+
+	static void
+	operator delete(void* p, request_pool&)
+	{
+		request_pool::release(p);
+	}
+
+	static void
+	operator delete(void* p)
+	{
+		request_pool::release(p);
+	}
+};
+
+#endif    // PRAKTOR_REQUEST_POOL_H
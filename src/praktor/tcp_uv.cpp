@@ -25,6 +25,16 @@
 #include "tcp_uv.h"
 #include "loop_uv.h"
 
+#if !defined(_WIN32)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+// writes of more buffers than this skip the uv_try_write fast path
+constexpr std::size_t try_write_max_buffers = 16;
+
 util::shared_ptr<tcp_channel_uv>
 connect_request_uv::get_channel_shared_ptr(uv_connect_t* req)
 {
@@ -39,7 +49,7 @@ connect_request_uv::on_connect(uv_connect_t* req, int status)
 
 	request_ptr->m_handler(get_channel_shared_ptr(req), err);
 	request_ptr->m_handler = nullptr;
-	delete req;
+	delete request_ptr;
 }
 
 /* tcp_write_buf_req_uv */
@@ -53,13 +63,25 @@ tcp_write_buf_req_uv::get_channel_shared_ptr(uv_write_t* req)
 void
 tcp_write_buf_req_uv::on_write(uv_write_t* req, int status)
 {
-	auto target = reinterpret_cast<tcp_write_buf_req_uv*>(req);
+	auto target  = reinterpret_cast<tcp_write_buf_req_uv*>(req);
+	auto channel = get_channel_shared_ptr(req);
+	if (target->m_finished)
+	{
+		target->m_finished->complete(channel, 0);
+	}
 	if (target->m_write_handler)
 	{
 		std::error_code err = map_uv_error(status);
-		target->m_write_handler(get_channel_shared_ptr(req), std::move(target->m_buffer), err);
+		target->m_write_handler(channel, std::move(target->m_buffer), err);
 	}
 	delete target;
+	channel->write_request_done();
+}
+
+void
+tcp_write_buf_req_uv::hand_off(tcp_write_batch_req_uv* failed)
+{
+	failed->add(write_header{}, std::move(m_buffer), std::move(m_write_handler));
 }
 
 /* tcp_write_bufs_req_uv */
@@ -73,13 +95,140 @@ tcp_write_bufs_req_uv::get_channel_shared_ptr(uv_write_t* req)
 void
 tcp_write_bufs_req_uv::on_write(uv_write_t* req, int status)
 {
-	auto target = reinterpret_cast<tcp_write_bufs_req_uv*>(req);
+	auto target  = reinterpret_cast<tcp_write_bufs_req_uv*>(req);
+	auto channel = get_channel_shared_ptr(req);
+	if (target->m_finished)
+	{
+		target->m_finished->complete(channel, 0);
+	}
 	if (target->m_write_handler)
 	{
 		std::error_code err = map_uv_error(status);
-		target->m_write_handler(get_channel_shared_ptr(req), std::move(target->m_buffers), err);
+		target->m_write_handler(channel, std::move(target->m_buffers), err);
 	}
 	delete target;
+	channel->write_request_done();
+}
+
+void
+tcp_write_bufs_req_uv::hand_off(tcp_write_batch_req_uv* failed)
+{
+	failed->add(write_header{}, std::move(m_buffers), std::move(m_write_handler));
+}
+
+/* tcp_write_batch_req_uv */
+
+void
+tcp_write_batch_req_uv::add(
+		write_header const& header, mutable_buffer&& buf, praktor::channel::write_buffer_handler&& handler)
+{
+	add_header(header);
+	m_uv_buffers.push_back(uv_buf_init(reinterpret_cast<char*>(buf.data()), buf.size()));
+	m_byte_count += buf.size();
+	m_writes.emplace_back(buffer_write{std::move(buf), std::move(handler)});
+}
+
+void
+tcp_write_batch_req_uv::add(
+		write_header const&                       header,
+		std::deque<mutable_buffer>&&              bufs,
+		praktor::channel::write_buffers_handler&& handler)
+{
+	add_header(header);
+	for (auto& buf : bufs)
+	{
+		m_uv_buffers.push_back(uv_buf_init(reinterpret_cast<char*>(buf.data()), buf.size()));
+		m_byte_count += buf.size();
+	}
+	m_writes.emplace_back(buffers_write{std::move(bufs), std::move(handler)});
+}
+
+// m_header_bytes may still grow, so the header's uv_buf_t gets its base
+// when the batch starts.
+void
+tcp_write_batch_req_uv::add_header(write_header const& header)
+{
+	if (header.m_size > 0)
+	{
+		m_header_slots.push_back(m_uv_buffers.size());
+		m_uv_buffers.push_back(uv_buf_init(nullptr, header.m_size));
+		m_header_bytes.insert(m_header_bytes.end(), header.m_data, header.m_data + header.m_size);
+		m_byte_count += header.m_size;
+	}
+}
+
+int
+tcp_write_batch_req_uv::start(uv_stream_t* chan)
+{
+	auto base = reinterpret_cast<char*>(m_header_bytes.data());
+	for (auto slot : m_header_slots)
+	{
+		m_uv_buffers[slot].base = base;
+		base += m_uv_buffers[slot].len;
+	}
+	return uv_write(&m_uv_write_request, chan, m_uv_buffers.data(), m_uv_buffers.size(), on_write);
+}
+
+void
+tcp_write_batch_req_uv::fail(uv_stream_t* chan, int status)
+{
+	auto channel_ptr = util::dynamic_pointer_cast<tcp_channel_uv>(tcp_base_uv::get_base_shared_ptr(chan));
+	auto lp          = reinterpret_cast<loop_data*>(chan->loop->data)->get_loop_ptr();
+
+	// the handler owns the batch, so a loop that closes before running it
+	// destroys the batch and its buffers rather than leaking them
+	std::error_code err;
+	lp->dispatch(err, [channel_ptr, status, batch{std::unique_ptr<tcp_write_batch_req_uv>{this}}]() mutable {
+		batch.release()->complete(channel_ptr, status);
+	});
+}
+
+void
+tcp_write_batch_req_uv::on_write(uv_write_t* req, int status)
+{
+	auto target  = reinterpret_cast<tcp_write_batch_req_uv*>(req);
+	auto channel = util::dynamic_pointer_cast<tcp_channel_uv>(tcp_base_uv::get_base_shared_ptr(req->handle));
+	target->complete(channel, status);
+	channel->write_request_done();
+}
+
+void
+tcp_write_batch_req_uv::complete(util::shared_ptr<tcp_channel_uv> const& chan, int status)
+{
+	run_handlers(chan, status);
+	delete this;
+}
+
+void
+tcp_write_batch_req_uv::run_handlers(util::shared_ptr<tcp_channel_uv> const& chan, int status)
+{
+	// handlers may write again, adding to the batch; those wait for the next run
+	m_spare_writes.swap(m_writes);
+	m_uv_buffers.clear();
+	m_header_bytes.clear();
+	m_header_slots.clear();
+	m_byte_count = 0;
+
+	std::error_code err = map_uv_error(status);
+	for (auto& write : m_spare_writes)
+	{
+		if (auto single = std::get_if<buffer_write>(&write))
+		{
+			if (single->m_handler)
+			{
+				single->m_handler(chan, std::move(single->m_buffer), err);
+			}
+		}
+		else
+		{
+			auto& multi = std::get<buffers_write>(write);
+			if (multi.m_handler)
+			{
+				multi.m_handler(chan, std::move(multi.m_buffers), err);
+			}
+		}
+	}
+	m_spare_writes.clear();
 }
 
 /* tcp_base_uv */
@@ -103,6 +252,93 @@ tcp_base_uv::really_get_endpoint(std::error_code& err)
 	return result;
 }
 
+namespace
+{
+
+int
+set_socket_option(uv_os_fd_t fd, int level, int name, int value, std::error_code& err)
+{
+	if (::setsockopt(fd, level, name, &value, sizeof(value)) < 0)
+	{
+		err = std::error_code{errno, std::generic_category()};
+		return -1;
+	}
+	return 0;
+}
+
+}    // namespace
+
+void
+tcp_base_uv::apply_socket_options(praktor::options const& opts, std::error_code& err)
+{
+	err.clear();
+	int        stat{0};
+	uv_os_fd_t fd;
+
+	if (opts.nodelay_was_set())
+	{
+		stat = uv_tcp_nodelay(get_tcp_handle(), opts.nodelay() ? 1 : 0);
+		UV_ERROR_CHECK(stat, err, exit);
+	}
+	if (opts.keepalive_was_set())
+	{
+		stat = uv_tcp_keepalive(get_tcp_handle(), opts.keepalive() ? 1 : 0, opts.keepalive_time().count());
+		UV_ERROR_CHECK(stat, err, exit);
+	}
+
+	if (uv_fileno(get_handle(), &fd) < 0)
+	{
+		goto exit;
+	}
+
+#if !defined(_WIN32)
+	if (opts.send_buffer_size() > 0)
+	{
+		if (set_socket_option(fd, SOL_SOCKET, SO_SNDBUF, static_cast<int>(opts.send_buffer_size()), err) < 0)
+			goto exit;
+	}
+	if (opts.receive_buffer_size() > 0)
+	{
+		if (set_socket_option(fd, SOL_SOCKET, SO_RCVBUF, static_cast<int>(opts.receive_buffer_size()), err) < 0)
+			goto exit;
+	}
+	if (opts.quickack_was_set())
+	{
+#if defined(TCP_QUICKACK)
+		if (set_socket_option(fd, IPPROTO_TCP, TCP_QUICKACK, opts.quickack() ? 1 : 0, err) < 0)
+			goto exit;
+#else
+		err = make_error_code(std::errc::operation_not_supported);
+		goto exit;
+#endif
+	}
+	if (opts.notsent_lowat() > 0)
+	{
+#if defined(TCP_NOTSENT_LOWAT)
+		if (set_socket_option(fd, IPPROTO_TCP, TCP_NOTSENT_LOWAT, static_cast<int>(opts.notsent_lowat()), err) < 0)
+			goto exit;
+#else
+		err = make_error_code(std::errc::operation_not_supported);
+		goto exit;
+#endif
+	}
+	if (opts.user_timeout().count() > 0)
+	{
+#if defined(TCP_USER_TIMEOUT)
+		if (set_socket_option(fd, IPPROTO_TCP, TCP_USER_TIMEOUT, static_cast<int>(opts.user_timeout().count()), err)
+			< 0)
+			goto exit;
+#else
+		err = make_error_code(std::errc::operation_not_supported);
+		goto exit;
+#endif
+	}
+#endif
+
+exit:
+	return;
+}
+
 std::shared_ptr<praktor::loop>
 tcp_base_uv::get_loop()
 {
@@ -119,14 +355,37 @@ tcp_channel_uv::clear_handler()
 		m_close_handler(util::dynamic_pointer_cast<tcp_channel_uv>(m_data.m_self_ptr));
 		m_close_handler = nullptr;
 	}
-	m_read_handler = nullptr;
+	m_read_handler       = nullptr;
+	m_read_batch_handler = nullptr;
+	m_pressure_handler   = nullptr;
+	m_drain_handler      = nullptr;
+}
+
+tcp_channel_uv::ptr
+tcp_channel_uv::create(praktor::options const& opts)
+{
+	ptr channel_ptr;
+	if (!opts.delimiter().empty())
+	{
+		channel_ptr = util::make_shared<tcp_delimited_channel_uv>();
+	}
+	else if (opts.framing())
+	{
+		channel_ptr = util::make_shared<tcp_framed_channel_uv>();
+	}
+	else
+	{
+		channel_ptr = util::make_shared<tcp_channel_uv>();
+	}
+	channel_ptr->configure(opts);
+	return channel_ptr;
 }
 
 void
-tcp_channel_uv::init(uv_loop_t* lp, ptr const& self, std::error_code& err)
+tcp_channel_uv::init(uv_loop_t* lp, ptr const& self, std::error_code& err, unsigned int family)
 {
 	err.clear();
-	auto stat = uv_tcp_init(lp, get_tcp_handle());
+	auto stat = uv_tcp_init_ex(lp, get_tcp_handle(), family);
 	uv_handle_set_data(get_handle(), get_handle_data());
 	set_self_ptr(self);
 	UV_ERROR_CHECK(stat, err, exit);
@@ -140,32 +399,77 @@ tcp_channel_uv::on_read(uv_stream_t* stream_handle, ssize_t nread, const uv_buf_
 	std::error_code err;
 	ptr             channel_ptr = util::dynamic_pointer_cast<tcp_channel_uv>(get_base_shared_ptr(stream_handle));
 	assert(channel_ptr);
-	if (nread < 0)
+	if (nread > 0)
 	{
-		if (buf->base)
+		auto data = read_buffer_pool::make_buffer(
+				reinterpret_cast<util::byte_type*>(buf->base), static_cast<util::size_type>(nread));
+		if (channel_ptr->m_read_batch_handler)
+		{
+			channel_ptr->m_read_batch_handler(channel_ptr, &data, 1, err);
+		}
+		else
 		{
-			delete[] reinterpret_cast<util::byte_type*>(buf->base);
+			channel_ptr->m_read_handler(channel_ptr, std::move(data), err);
 		}
+		return;
+	}
+
+	// nread == 0 (EAGAIN) hands back an unused buffer as well
+	if (buf->base)
+	{
+		read_buffer_pool::release(reinterpret_cast<util::byte_type*>(buf->base));
+	}
+	if (nread < 0)
+	{
 		err = map_uv_error(nread);
-		channel_ptr->m_read_handler(channel_ptr, util::const_buffer{}, err);
+		channel_ptr->report_read_error(channel_ptr, err);
 	}
-	else if (nread > 0)
+}
+
+void
+tcp_channel_uv::report_read_error(praktor::channel::ptr const& chan, std::error_code const& err)
+{
+	if (m_read_batch_handler)
 	{
-		channel_ptr->m_read_handler(
-				channel_ptr,
-				util::const_buffer{reinterpret_cast<util::byte_type*>(buf->base),
-								   static_cast<util::size_type>(nread),
-								   std::default_delete<util::byte_type[]>{}},
-				err);
+		m_read_batch_handler(chan, nullptr, 0, err);
+	}
+	else
+	{
+		m_read_handler(chan, util::const_buffer{}, err);
 	}
 }
 
 void
-tcp_channel_uv::on_allocate(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf)
+tcp_channel_uv::deliver_read(praktor::channel::ptr const& chan, util::const_buffer&& buf)
 {
-	// static buffer::memory_broker::ptr broker = buffer::default_broker::get();
-	buf->base = reinterpret_cast<char*>(new util::byte_type[suggested_size]);
-	buf->len  = suggested_size;
+	if (m_read_batch_handler)
+	{
+		m_read_batch.emplace_back(std::move(buf));
+		return;
+	}
+	std::error_code err;
+	m_read_handler(chan, std::move(buf), err);
+}
+
+void
+tcp_channel_uv::deliver_read_batch(praktor::channel::ptr const& chan)
+{
+	std::error_code err;
+	if (m_read_batch_handler)
+	{
+		m_read_batch_handler(chan, m_read_batch.data(), m_read_batch.size(), err);
+	}
+	m_read_batch.clear();
+}
+
+void
+tcp_channel_uv::on_allocate(uv_handle_t* handle, size_t, uv_buf_t* buf)
+{
+	// the pool's configured read size takes precedence over suggested_size
+	auto&       pool = reinterpret_cast<loop_data*>(handle->loop->data)->m_read_buffer_pool;
+	std::size_t capacity{0};
+	buf->base = reinterpret_cast<char*>(pool->allocate_for_read(capacity));
+	buf->len  = capacity;
 }
 
 bool
@@ -176,6 +480,7 @@ tcp_channel_uv::really_close(praktor::channel::close_handler&& handler)
 	{
 		result = true;
 		m_close_handler = std::move(handler);
+		flush_writes();    // so gathered writes complete, cancelled, like queued ones
 		uv_close(get_handle(), tcp_base_uv::on_close);
 	}
 	return result;
@@ -188,6 +493,7 @@ tcp_channel_uv::really_close()
 	if (!uv_is_closing(get_handle()))
 	{
 		result = true;
+		flush_writes();
 		uv_close(get_handle(), tcp_base_uv::on_close);
 	}
 	return result;
@@ -203,49 +509,342 @@ void
 tcp_channel_uv::really_start_read(std::error_code& err, praktor::channel::read_handler&& handler)
 {
 	err.clear();
-	m_read_handler = std::move(handler);
-	auto stat      = uv_read_start(get_stream_handle(), on_allocate, on_read);
+	m_read_handler       = std::move(handler);
+	m_read_batch_handler = nullptr;
+	m_is_read_paused     = false;
+	auto stat            = start_reading();
+	if (stat < 0)
+	{
+		err = map_uv_error(stat);
+	}
+	else
+	{
+		m_is_reading = true;
+	}
+}
+
+void
+tcp_channel_uv::really_start_read_batch(std::error_code& err, praktor::channel::read_batch_handler&& handler)
+{
+	err.clear();
+	m_read_batch_handler = std::move(handler);
+	m_read_handler       = nullptr;
+	m_is_read_paused     = false;
+	auto stat            = start_reading();
 	if (stat < 0)
 	{
 		err = map_uv_error(stat);
 	}
+	else
+	{
+		m_is_reading = true;
+	}
+}
+
+int
+tcp_channel_uv::start_reading()
+{
+	return uv_read_start(get_stream_handle(), on_allocate, on_read);
 }
 
 void
 tcp_channel_uv::stop_read()
 {
+	m_is_reading     = false;
+	m_is_read_paused = false;
 	uv_read_stop(get_stream_handle());
 }
 
 void
-tcp_channel_uv::really_write(
-		util::mutable_buffer&&                 buf,
-		std::error_code&                       err,
-		praktor::channel::write_buffer_handler&& handler)
+tcp_channel_uv::really_write(
+		util::mutable_buffer&&                 buf,
+		std::error_code&                       err,
+		praktor::channel::write_buffer_handler&& handler)
+{
+	submit_write(std::move(buf), err, std::move(handler));
+}
+
+void
+tcp_channel_uv::really_write(
+		std::deque<util::mutable_buffer>&&      bufs,
+		std::error_code&                        err,
+		praktor::channel::write_buffers_handler&& handler)
+{
+	submit_write(std::move(bufs), err, std::move(handler));
+}
+
+void
+tcp_channel_uv::submit_write(
+		util::mutable_buffer&&                   buf,
+		std::error_code&                         err,
+		praktor::channel::write_buffer_handler&& handler,
+		write_header const&                      header)
+{
+	err.clear();
+	if (is_write_refused(err))
+	{
+		return;
+	}
+	if (m_coalesce_threshold > 0)
+	{
+		auto pending = get_pending_writes(err);
+		if (pending)
+		{
+			pending->add(header, std::move(buf), std::move(handler));
+			if (pending->byte_count() >= m_coalesce_threshold)
+			{
+				flush_writes();
+			}
+			check_write_pressure();
+		}
+		return;
+	}
+
+	uv_buf_t uv_buffers[2]{uv_buf_init(const_cast<char*>(reinterpret_cast<char const*>(header.m_data)), header.m_size),
+						   uv_buf_init(reinterpret_cast<char*>(buf.data()), buf.size())};
+	std::size_t first = header.m_size > 0 ? 0 : 1;
+	std::size_t written{0};
+	if (try_write(uv_buffers + first, 2 - first, header.m_size + buf.size(), written))
+	{
+		get_finished_writes()->add(write_header{}, std::move(buf), std::move(handler));
+		return;
+	}
+
+	start_request(
+			new (request_pool::of(get_handle()->loop)) tcp_write_buf_req_uv{header, std::move(buf), std::move(handler)},
+			written,
+			err);
+	check_write_pressure();
+}
+
+void
+tcp_channel_uv::submit_write(
+		std::deque<util::mutable_buffer>&&        bufs,
+		std::error_code&                          err,
+		praktor::channel::write_buffers_handler&& handler,
+		write_header const&                       header)
+{
+	err.clear();
+	if (is_write_refused(err))
+	{
+		return;
+	}
+	if (m_coalesce_threshold > 0)
+	{
+		auto pending = get_pending_writes(err);
+		if (pending)
+		{
+			pending->add(header, std::move(bufs), std::move(handler));
+			if (pending->byte_count() >= m_coalesce_threshold)
+			{
+				flush_writes();
+			}
+			check_write_pressure();
+		}
+		return;
+	}
+
+	std::size_t written{0};
+	if (bufs.size() <= try_write_max_buffers)
+	{
+		uv_buf_t    uv_buffers[try_write_max_buffers + 1];
+		std::size_t count{0};
+		std::size_t total{header.m_size};
+		if (header.m_size > 0)
+		{
+			uv_buffers[count++] = uv_buf_init(const_cast<char*>(reinterpret_cast<char const*>(header.m_data)), header.m_size);
+		}
+		for (auto& buf : bufs)
+		{
+			uv_buffers[count++] = uv_buf_init(reinterpret_cast<char*>(buf.data()), buf.size());
+			total += buf.size();
+		}
+		if (try_write(uv_buffers, count, total, written))
+		{
+			get_finished_writes()->add(write_header{}, std::move(bufs), std::move(handler));
+			return;
+		}
+	}
+
+	start_request(
+			new (request_pool::of(get_handle()->loop)) tcp_write_bufs_req_uv{header, std::move(bufs), std::move(handler)},
+			written,
+			err);
+	check_write_pressure();
+}
+
+// Returns the request gathering this iteration's writes, starting one and
+// registering for a flush if there is none yet.
+tcp_write_batch_req_uv*
+tcp_channel_uv::get_pending_writes(std::error_code& err)
+{
+	if (uv_is_closing(get_handle()))
+	{
+		// as uv_write would report for a closed handle
+		err = map_uv_error(UV_EBADF);
+		return nullptr;
+	}
+	if (!m_pending_writes)
+	{
+		m_pending_writes = new tcp_write_batch_req_uv;
+		reinterpret_cast<loop_data*>(get_handle()->loop->data)
+				->m_write_coalescer.schedule(
+						get_handle()->loop, util::dynamic_pointer_cast<tcp_channel_uv>(m_data.m_self_ptr));
+	}
+	return m_pending_writes;
+}
+
+// Writes as much as the socket takes right now, if no request is queued
+// ahead of this write; true if everything was written.
+bool
+tcp_channel_uv::try_write(uv_buf_t const* bufs, unsigned int count, std::size_t total, std::size_t& written)
+{
+	written = 0;
+	if (m_writes_in_flight > 0 || uv_is_closing(get_handle()))
+	{
+		return false;
+	}
+	auto status = uv_try_write(get_stream_handle(), bufs, count);
+	if (status > 0)
+	{
+		written = static_cast<std::size_t>(status);
+	}
+	return status >= 0 && written == total;
+}
+
+// Returns the batch holding writes completed on the spot, registering for
+// a run of their handlers if it was empty.
+tcp_write_batch_req_uv*
+tcp_channel_uv::get_finished_writes()
+{
+	if (!m_finished_writes)
+	{
+		m_finished_writes = new tcp_write_batch_req_uv;
+	}
+	if (m_finished_writes->empty())
+	{
+		reinterpret_cast<loop_data*>(get_handle()->loop->data)
+				->m_write_coalescer.schedule(
+						get_handle()->loop, util::dynamic_pointer_cast<tcp_channel_uv>(m_data.m_self_ptr));
+	}
+	return m_finished_writes;
+}
+
+template<class Request>
+void
+tcp_channel_uv::start_request(Request* request, std::size_t written, std::error_code& err)
+{
+	auto status = request->start(get_stream_handle(), written);
+	if (status < 0)
+	{
+		if (written > 0)
+		{
+			// The peer already has part of this write, so the stream is torn.
+			// Fail the write from the loop, as if it had failed in flight,
+			// and close the channel rather than let later writes follow it.
+			auto failed = new tcp_write_batch_req_uv;
+			request->hand_off(failed);
+			failed->fail(get_stream_handle(), status);
+			really_close();
+		}
+		else
+		{
+			err = map_uv_error(status);
+		}
+		delete request;
+		return;
+	}
+	++m_writes_in_flight;
+
+	// writes finished on the spot must report before this one
+	if (m_finished_writes && !m_finished_writes->empty())
+	{
+		request->finish_after(m_finished_writes);
+		m_finished_writes = nullptr;
+	}
+}
+
+// Fails the write if the channel is under pressure and set to fail fast.
+bool
+tcp_channel_uv::is_write_refused(std::error_code& err)
+{
+	if (m_is_under_pressure && m_pressure_policy == praktor::write_pressure_policy::fail_fast)
+	{
+		err = make_error_code(praktor::errc::write_queue_full);
+		return true;
+	}
+	return false;
+}
+
+void
+tcp_channel_uv::check_write_pressure()
+{
+	if (m_high_watermark == 0 || m_is_under_pressure)
+	{
+		return;
+	}
+	auto queued = get_queue_size();
+	if (queued >= m_high_watermark)
+	{
+		m_is_under_pressure = true;
+		if (m_pressure_policy == praktor::write_pressure_policy::pause_read && m_is_reading)
+		{
+			uv_read_stop(get_stream_handle());
+			m_is_read_paused = true;
+		}
+		if (m_pressure_handler)
+		{
+			m_pressure_handler(util::dynamic_pointer_cast<tcp_channel_uv>(m_data.m_self_ptr), queued);
+		}
+	}
+}
+
+void
+tcp_channel_uv::write_request_done()
+{
+	--m_writes_in_flight;
+	if (!m_is_under_pressure || uv_is_closing(get_handle()) || get_queue_size() > m_low_watermark)
+	{
+		return;
+	}
+	m_is_under_pressure = false;
+	if (m_is_read_paused)
+	{
+		m_is_read_paused = false;
+		start_reading();
+	}
+	if (m_drain_handler)
+	{
+		m_drain_handler(util::dynamic_pointer_cast<tcp_channel_uv>(m_data.m_self_ptr));
+	}
+}
+
+void
+tcp_channel_uv::run_deferred_writes(ptr const& self)
 {
-	err.clear();
-	auto request = new tcp_write_buf_req_uv{std::move(buf), std::move(handler)};
-	auto status  = request->start(get_stream_handle());
-	if (status < 0)
+	if (m_finished_writes && !m_finished_writes->empty())
 	{
-		err = map_uv_error(status);
-		delete request;
+		m_finished_writes->run_handlers(self, 0);
 	}
+	flush_writes();
 }
 
 void
-tcp_channel_uv::really_write(
-		std::deque<util::mutable_buffer>&&      bufs,
-		std::error_code&                        err,
-		praktor::channel::write_buffers_handler&& handler)
+tcp_channel_uv::flush_writes()
 {
-	err.clear();
-	auto request = new tcp_write_bufs_req_uv{std::move(bufs), std::move(handler)};
-	auto status  = request->start(get_stream_handle());
-	if (status < 0)
+	if (m_pending_writes)
 	{
-		err = map_uv_error(status);
-		delete request;
+		auto request     = m_pending_writes;
+		m_pending_writes = nullptr;
+		auto status      = request->start(get_stream_handle());
+		if (status < 0)
+		{
+			request->fail(get_stream_handle(), status);
+		}
+		else
+		{
+			++m_writes_in_flight;
+		}
 	}
 }
 
@@ -290,127 +889,140 @@ tcp_framed_channel_uv::on_read(uv_stream_t* stream_handle, ssize_t nread, const
 	std::error_code err;
 	ptr             channel_ptr = util::dynamic_pointer_cast<tcp_framed_channel_uv>(get_base_shared_ptr(stream_handle));
 	assert(channel_ptr);
+	if (nread > 0)
+	{
+		channel_ptr->read_to_frame(
+				channel_ptr, reinterpret_cast<util::byte_type*>(buf->base), static_cast<std::size_t>(nread));
+		return;
+	}
+
+	if (buf->base)
+	{
+		read_buffer_pool::release(reinterpret_cast<util::byte_type*>(buf->base));
+	}
 	if (nread < 0)
 	{
-		if (buf->base)
-		{
-			delete[] reinterpret_cast<util::byte_type*>(buf->base);
-		}
 		err = map_uv_error(nread);
-		channel_ptr->m_read_handler(channel_ptr, util::const_buffer{}, err);
+		channel_ptr->report_read_error(channel_ptr, err);
 	}
-	else if (nread > 0)
+}
+
+void
+tcp_framed_channel_uv::configure(praktor::options const& opts)
+{
+	tcp_channel_uv::configure(opts);
+	m_codec          = frame_header_codec{opts.frame_header()};
+	m_max_frame_size = std::min<std::uint64_t>(m_codec.max_frame_size(), std::numeric_limits<frame_size_type>::max());
+	if (opts.max_frame_size() > 0)
 	{
-		channel_ptr->read_to_frame(
-				channel_ptr,
-				util::const_buffer{reinterpret_cast<util::byte_type*>(buf->base),
-								   static_cast<util::size_type>(nread),
-								   std::default_delete<util::byte_type[]>{}});
+		m_max_frame_size = std::min<std::uint64_t>(m_max_frame_size, opts.max_frame_size());
 	}
 }
 
+// A frame lying whole within the block is delivered as a slice sharing
+// it; only frames that straddle reads are copied into m_payload_buffer.
+
 void
-tcp_framed_channel_uv::read_to_frame(ptr channel_ptr, util::const_buffer&& buf)
+tcp_framed_channel_uv::read_to_frame(ptr const& channel_ptr, util::byte_type* data, std::size_t size)
 {
-	assert((is_frame_size_valid() && (m_payload_buffer.size() < m_frame_size)) || (!is_frame_size_valid()));
+	assert((is_frame_size_valid() && (m_payload_buffer.size() < static_cast<std::size_t>(m_frame_size)))
+		   || (!is_frame_size_valid()));
 
-	std::size_t current_buffer_position{0};
-	std::size_t remaining_in_buffer{buf.size()};
+	praktor::channel::ptr chan{channel_ptr};
+	std::size_t           position{0};
 
-	while (remaining_in_buffer > 0)
+	while (position < size)
 	{
 		if (!is_frame_size_valid())
 		{
-			assert(!is_header_complete());
-			std::size_t nbytes_to_move{0};
-			auto        needed_to_complete = sizeof(m_header_buf) - m_header_byte_count;
-			if (buf.size() >= needed_to_complete)
-			{
-				nbytes_to_move = needed_to_complete;
-			}
-			else
+			position += m_codec.decode(data + position, size - position);
+			if (!m_codec.is_complete())
 			{
-				nbytes_to_move = buf.size();
+				break;
 			}
-			// util::mutable_buffer hbuf{const_cast<const util::byte_type*>(m_header_buf), 8};
-			::memcpy(&m_header_buf[m_header_byte_count], buf.data() + current_buffer_position, nbytes_to_move);
-			m_header_byte_count += nbytes_to_move;
-			current_buffer_position += nbytes_to_move;
-			remaining_in_buffer -= nbytes_to_move;
-			if (is_header_complete())
+			if (m_codec.frame_size() > m_max_frame_size)
 			{
-				m_frame_size = unpack_frame_header(&m_header_buf);
-				assert(m_frame_size >= 0);
-
-				assert(m_payload_buffer.size() == 0);
-				if (m_frame_size > 0)
-				{
-					m_payload_buffer.expand(m_frame_size);
-				}
+				reject_frame(chan);
+				break;
 			}
-		}
 
-		assert((is_frame_size_valid() || remaining_in_buffer < 1));
-
-		if (is_frame_size_valid())
-		{
-			assert(m_payload_buffer.size() <= m_frame_size);
-			std::size_t needed_to_complete{m_frame_size - m_payload_buffer.size()};
-			if (needed_to_complete > 0 && remaining_in_buffer > 0)
+			m_frame_size = static_cast<frame_size_type>(m_codec.frame_size());
+			assert(m_payload_buffer.size() == 0);
+			if (m_frame_size > 0 && static_cast<std::size_t>(m_frame_size) <= size - position)
 			{
-				assert(m_payload_buffer.capacity() == m_frame_size);
-				std::size_t nbytes_to_move = std::min(remaining_in_buffer, needed_to_complete);
-				assert(nbytes_to_move > 0);
-				m_payload_buffer.putn(m_payload_buffer.size(), buf.data() + current_buffer_position, nbytes_to_move);
-				needed_to_complete -= nbytes_to_move;
-				current_buffer_position += nbytes_to_move;
-				remaining_in_buffer -= nbytes_to_move;
-				m_payload_buffer.size(m_payload_buffer.size() + nbytes_to_move);
+				auto frame_size = static_cast<std::size_t>(m_frame_size);
+				deliver_frame(chan, read_buffer_pool::make_slice(data, position, frame_size));
+				position += frame_size;
+				continue;
 			}
-			if (needed_to_complete < 1)
+			if (m_frame_size > 0)
 			{
-				std::error_code err;
-				m_read_handler(channel_ptr, std::move(m_payload_buffer), err);
-				m_header_byte_count = 0;
-				assert(m_payload_buffer.size() == 0);
-				m_frame_size = -1;
+				m_payload_buffer.expand(m_frame_size);
 			}
 		}
+
+		auto frame_size = static_cast<std::size_t>(m_frame_size);
+		assert(m_payload_buffer.size() <= frame_size);
+		std::size_t needed_to_complete{frame_size - m_payload_buffer.size()};
+		if (needed_to_complete > 0 && position < size)
+		{
+			assert(m_payload_buffer.capacity() == frame_size);
+			std::size_t nbytes_to_move = std::min(size - position, needed_to_complete);
+			m_payload_buffer.putn(m_payload_buffer.size(), data + position, nbytes_to_move);
+			m_payload_buffer.size(m_payload_buffer.size() + nbytes_to_move);
+			needed_to_complete -= nbytes_to_move;
+			position += nbytes_to_move;
+		}
+		if (needed_to_complete < 1)
+		{
+			deliver_frame(chan, std::move(m_payload_buffer));
+			assert(m_payload_buffer.size() == 0);
+		}
+	}
+	if (!m_read_batch.empty())
+	{
+		deliver_read_batch(chan);
 	}
+	read_buffer_pool::release(data);
 }
 
 void
-tcp_framed_channel_uv::really_start_read(std::error_code& err, praktor::channel::read_handler&& handler)
+tcp_framed_channel_uv::deliver_frame(praktor::channel::ptr const& chan, util::const_buffer&& frame)
 {
-	err.clear();
-	m_read_handler = std::move(handler);
-	auto stat      = uv_read_start(get_stream_handle(), on_allocate, on_read);
-	if (stat < 0)
+	m_codec.reset();
+	m_frame_size = -1;
+	deliver_read(chan, std::move(frame));
+}
+
+void
+tcp_framed_channel_uv::reject_frame(praktor::channel::ptr const& chan)
+{
+	stop_read();
+	m_codec.reset();
+	if (!m_read_batch.empty())
 	{
-		err = map_uv_error(stat);
+		deliver_read_batch(chan);
 	}
+	report_read_error(chan, make_error_code(praktor::errc::frame_too_large));
 }
 
-class on_write_buffers
+int
+tcp_framed_channel_uv::start_reading()
 {
-public:
-
-	on_write_buffers(praktor::channel::write_buffer_handler handler) : m_handler{std::move(handler)}
-	{}
+	return uv_read_start(get_stream_handle(), on_allocate, on_read);
+}
 
-	void
-	operator()(praktor::channel::ptr const& chan, std::deque<util::mutable_buffer>&& bufs, std::error_code const& err)
+bool
+tcp_framed_channel_uv::make_frame_header(std::uint64_t frame_size, write_header& header, std::error_code& err) const
+{
+	if (frame_size > m_max_frame_size)
 	{
-		if (m_handler)
-		{
-			m_handler(chan, std::move(bufs.back()), err);
-		}
+		err = make_error_code(praktor::errc::frame_too_large);
+		return false;
 	}
-
-private:
-	praktor::channel::write_buffer_handler m_handler;
-};
-
+	header.m_size = m_codec.encode(frame_size, header.m_data);
+	return true;
+}
 
 void
 tcp_framed_channel_uv::really_write(
@@ -419,17 +1031,10 @@ tcp_framed_channel_uv::really_write(
 		praktor::channel::write_buffer_handler&& handler)
 {
 	err.clear();
-	std::deque<util::mutable_buffer> frame_bufs;
-	frame_bufs.emplace_back(pack_frame_header(buf.size()));
-	frame_bufs.emplace_back(std::move(buf));
-
-	auto request = new tcp_write_bufs_req_uv{std::move(frame_bufs), on_write_buffers{std::move(handler)}};
-
-	auto status = request->start(get_stream_handle());
-	if (status < 0)
+	write_header header;
+	if (make_frame_header(buf.size(), header, err))
 	{
-		err = map_uv_error(status);
-		delete request;
+		submit_write(std::move(buf), err, std::move(handler), header);
 	}
 }
 
@@ -445,14 +1050,200 @@ tcp_framed_channel_uv::really_write(
 	{
 		frame_size += buf.size();
 	}
-	bufs.emplace_front(pack_frame_header(frame_size));
-	auto request = new tcp_write_bufs_req_uv{std::move(bufs), std::move(handler)};
-	auto status  = request->start(get_stream_handle());
-	if (status < 0)
+	write_header header;
+	if (make_frame_header(frame_size, header, err))
 	{
-		err = map_uv_error(status);
-		delete request;
+		submit_write(std::move(bufs), err, std::move(handler), header);
+	}
+}
+
+// tcp_delimited_channel_uv
+
+void
+tcp_delimited_channel_uv::configure(praktor::options const& opts)
+{
+	tcp_channel_uv::configure(opts);
+	m_delimiter       = opts.delimiter();
+	m_max_record_size = opts.max_frame_size();
+}
+
+void
+tcp_delimited_channel_uv::on_read(uv_stream_t* stream_handle, ssize_t nread, const uv_buf_t* buf)
+{
+	std::error_code err;
+	ptr channel_ptr = util::dynamic_pointer_cast<tcp_delimited_channel_uv>(get_base_shared_ptr(stream_handle));
+	assert(channel_ptr);
+	if (nread > 0)
+	{
+		channel_ptr->read_to_record(
+				channel_ptr, reinterpret_cast<util::byte_type*>(buf->base), static_cast<std::size_t>(nread));
+		return;
+	}
+
+	if (buf->base)
+	{
+		read_buffer_pool::release(reinterpret_cast<util::byte_type*>(buf->base));
+	}
+	if (nread < 0)
+	{
+		err = map_uv_error(nread);
+		channel_ptr->report_read_error(channel_ptr, err);
+	}
+}
+
+int
+tcp_delimited_channel_uv::start_reading()
+{
+	return uv_read_start(get_stream_handle(), on_allocate, on_read);
+}
+
+// Records lying whole within the block are delivered as slices sharing
+// it; the tail of the block, if it ends mid-record, is copied into
+// m_record and completed by later reads.
+
+void
+tcp_delimited_channel_uv::read_to_record(ptr const& channel_ptr, util::byte_type* data, std::size_t size)
+{
+	praktor::channel::ptr chan{channel_ptr};
+	std::size_t           position{0};
+
+	if (m_record.size() > 0)
+	{
+		std::size_t record_end{0};
+		if (find_straddling_delimiter(data, size, record_end, position))
+		{
+			m_record.size(record_end);
+		}
+		else
+		{
+			auto end = find_delimiter(data, 0, size);
+			if (!append_to_record(data, end))
+			{
+				reject_record(chan);
+				goto exit;
+			}
+			if (end == size)
+			{
+				goto exit;
+			}
+			position = end + m_delimiter.size();
+		}
+		if (is_record_too_large(m_record.size()))
+		{
+			reject_record(chan);
+			goto exit;
+		}
+		deliver_read(chan, std::move(m_record));
+		assert(m_record.size() == 0);
+	}
+
+	while (position < size)
+	{
+		auto end = find_delimiter(data, position, size);
+		if (end == size)
+		{
+			if (!append_to_record(data + position, size - position))
+			{
+				reject_record(chan);
+				goto exit;
+			}
+			break;
+		}
+		if (is_record_too_large(end - position))
+		{
+			reject_record(chan);
+			goto exit;
+		}
+		deliver_read(chan, read_buffer_pool::make_slice(data, position, end - position));
+		position = end + m_delimiter.size();
+	}
+
+	if (!m_read_batch.empty())
+	{
+		deliver_read_batch(chan);
+	}
+exit:
+	read_buffer_pool::release(data);
+}
+
+std::size_t
+tcp_delimited_channel_uv::find_delimiter(util::byte_type const* data, std::size_t position, std::size_t size) const
+{
+	auto const* delimiter      = reinterpret_cast<util::byte_type const*>(m_delimiter.data());
+	std::size_t delimiter_size = m_delimiter.size();
+
+	while (size - position >= delimiter_size)
+	{
+		auto found = static_cast<util::byte_type const*>(
+				::memchr(data + position, delimiter[0], size - position - delimiter_size + 1));
+		if (!found)
+		{
+			break;
+		}
+		if (::memcmp(found + 1, delimiter + 1, delimiter_size - 1) == 0)
+		{
+			return static_cast<std::size_t>(found - data);
+		}
+		position = static_cast<std::size_t>(found - data) + 1;
+	}
+	return size;
+}
+
+bool
+tcp_delimited_channel_uv::find_straddling_delimiter(
+		util::byte_type const* data,
+		std::size_t            size,
+		std::size_t&           record_end,
+		std::size_t&           data_start) const
+{
+	auto const* delimiter      = reinterpret_cast<util::byte_type const*>(m_delimiter.data());
+	std::size_t delimiter_size = m_delimiter.size();
+	auto const* record         = m_record.data();
+
+	// the longest tail first, as it starts earliest
+	for (std::size_t tail = std::min(delimiter_size - 1, m_record.size()); tail > 0; --tail)
+	{
+		std::size_t rest = delimiter_size - tail;
+		if (rest <= size && ::memcmp(record + m_record.size() - tail, delimiter, tail) == 0
+			&& ::memcmp(data, delimiter + tail, rest) == 0)
+		{
+			record_end = m_record.size() - tail;
+			data_start = rest;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+tcp_delimited_channel_uv::append_to_record(util::byte_type const* data, std::size_t size)
+{
+	std::size_t record_size = m_record.size() + size;
+
+	// the tail may hold the start of a delimiter, not yet known to be one
+	if (is_record_too_large(record_size - std::min(record_size, m_delimiter.size() - 1)))
+	{
+		return false;
+	}
+	if (m_record.capacity() < record_size)
+	{
+		m_record.expand(std::max(record_size, 2 * m_record.capacity()));
+	}
+	m_record.putn(m_record.size(), data, size);
+	m_record.size(record_size);
+	return true;
+}
+
+void
+tcp_delimited_channel_uv::reject_record(praktor::channel::ptr const& chan)
+{
+	stop_read();
+	m_record = mutable_buffer{};
+	if (!m_read_batch.empty())
+	{
+		deliver_read_batch(chan);
 	}
+	report_read_error(chan, make_error_code(praktor::errc::frame_too_large));
 }
 
 // tcp_acceptor_uv
@@ -482,7 +1273,7 @@ tcp_acceptor_uv::on_connection(uv_stream_t* handle, int stat)
 	else
 	{
 		std::error_code err;
-		auto            channel_ptr = util::make_shared<tcp_channel_uv>();
+		auto            channel_ptr = tcp_channel_uv::create(acceptor_ptr->m_channel_options);
 		channel_ptr->init(acceptor_ptr->get_handle()->loop, channel_ptr, err);
 		if (err)
 		{
@@ -495,41 +1286,159 @@ tcp_acceptor_uv::on_connection(uv_stream_t* handle, int stat)
 			{
 				err = map_uv_error(status);
 			}
+			else
+			{
+				channel_ptr->apply_socket_options(acceptor_ptr->m_channel_options, err);
+			}
 			acceptor_ptr->m_connection_handler(acceptor_ptr, channel_ptr, err);
 		}
 	}
 }
 
-void
-tcp_acceptor_uv::on_framing_connection(uv_stream_t* handle, int stat)
+namespace
 {
 
-	auto acceptor_ptr = util::dynamic_pointer_cast<tcp_acceptor_uv>(get_base_shared_ptr(handle));
+// Owns an accepted socket on its way to the target loop, and closes it if
+// the handoff never completes (e.g. the target loop closes first).
+class detached_socket_uv
+{
+public:
+	explicit detached_socket_uv(uv_os_sock_t sock) : m_sock{sock} {}
+
+	detached_socket_uv(detached_socket_uv&& rhs) : m_sock{rhs.release()} {}
+
+	detached_socket_uv(detached_socket_uv const&) = delete;
+
+	~detached_socket_uv()
+	{
+		if (m_sock >= 0)
+		{
+			::close(m_sock);
+		}
+	}
+
+	uv_os_sock_t
+	get() const
+	{
+		return m_sock;
+	}
+
+	uv_os_sock_t
+	release()
+	{
+		auto sock = m_sock;
+		m_sock    = -1;
+		return sock;
+	}
+
+private:
+	uv_os_sock_t m_sock;
+};
+
+}    // namespace
+
+// libuv can only accept into a handle on the listener's own loop, so accept
+// into a temporary handle, keep a duplicate of its socket, and close it.
+
+uv_os_sock_t
+tcp_acceptor_uv::accept_detached(std::error_code& err)
+{
+	err.clear();
+	uv_os_sock_t result{-1};
+#if !defined(_WIN32)
+	int        stat{0};
+	uv_os_fd_t fd;
+	auto       temp = new uv_tcp_t;
 
+	stat = uv_tcp_init(get_handle()->loop, temp);
 	if (stat < 0)
 	{
-		std::error_code err = map_uv_error(stat);
-		acceptor_ptr->m_connection_handler(acceptor_ptr, nullptr, err);
+		delete temp;
+		UV_ERROR_CHECK(stat, err, exit);
 	}
-	else
+
+	stat = uv_accept(get_stream_handle(), reinterpret_cast<uv_stream_t*>(temp));
+	if (stat == 0)
 	{
-		std::error_code err;
-		auto            channel_ptr = util::make_shared<tcp_framed_channel_uv>();
-		channel_ptr->init(acceptor_ptr->get_handle()->loop, channel_ptr, err);
-		if (err)
+		stat = uv_fileno(reinterpret_cast<uv_handle_t*>(temp), &fd);
+	}
+	if (stat == 0)
+	{
+		result = ::dup(fd);
+		if (result < 0)
 		{
-			acceptor_ptr->m_connection_handler(acceptor_ptr, channel_ptr, err);
+			err = std::error_code{errno, std::generic_category()};
 		}
-		else
+	}
+	uv_close(reinterpret_cast<uv_handle_t*>(temp), [](uv_handle_t* handle) {
+		delete reinterpret_cast<uv_tcp_t*>(handle);
+	});
+	UV_ERROR_CHECK(stat, err, exit);
+exit:
+#else
+	err = make_error_code(std::errc::operation_not_supported);
+#endif
+	return result;
+}
+
+void
+tcp_acceptor_uv::on_handoff_connection(uv_stream_t* handle, int stat)
+{
+	auto                           acceptor_ptr = get_shared_acceptor(handle);
+	auto                           handler      = acceptor_ptr->m_shared_handler;
+	auto const&                    opts         = acceptor_ptr->m_channel_options;
+	std::error_code                err          = map_uv_error(stat);
+	std::shared_ptr<praktor::loop> target;
+	uv_os_sock_t                   sock{-1};
+
+	if (err) goto fail;
+
+	target = acceptor_ptr->m_loop_selector();
+	if (!target || target == acceptor_ptr->get_loop())
+	{
+		auto channel_ptr = tcp_channel_uv::create(opts);
+		channel_ptr->init(handle->loop, channel_ptr, err);
+		if (!err)
 		{
-			int status = uv_accept(acceptor_ptr->get_stream_handle(), channel_ptr->get_stream_handle());
+			int status = uv_accept(handle, channel_ptr->get_stream_handle());
 			if (status)
 			{
 				err = map_uv_error(status);
 			}
-			acceptor_ptr->m_connection_handler(acceptor_ptr, channel_ptr, err);
+			else
+			{
+				channel_ptr->apply_socket_options(opts, err);
+			}
 		}
+		(*handler)(acceptor_ptr, channel_ptr, err);
+		return;
 	}
+
+	sock = acceptor_ptr->accept_detached(err);
+	if (err) goto fail;
+
+	target->dispatch(
+			err,
+			[acceptor_ptr, handler, opts, detached{detached_socket_uv{sock}}](praktor::loop::ptr const& lp) mutable {
+				std::error_code ec;
+				auto            channel_ptr = tcp_channel_uv::create(opts);
+				channel_ptr->init(std::dynamic_pointer_cast<loop_uv>(lp)->get_uv_loop(), channel_ptr, ec);
+				if (!ec)
+				{
+					channel_ptr->open(detached.get(), ec);
+					if (!ec)
+					{
+						detached.release();
+						channel_ptr->apply_socket_options(opts, ec);
+					}
+				}
+				(*handler)(acceptor_ptr, channel_ptr, ec);
+			});
+	if (err) goto fail;
+	return;
+
+fail:
+	(*handler)(acceptor_ptr, nullptr, err);
 }
 
 bool
@@ -561,31 +1470,82 @@ void
 tcp_acceptor_uv::really_bind(praktor::options const& opts, std::error_code& err)
 {
 	err.clear();
-	m_is_framing = opts.framing();
+	int stat{0};
+	m_channel_options = opts;
 	sockaddr_storage saddr;
 	opts.endpoint().to_sockaddr(saddr);
-	auto stat = uv_tcp_bind(get_tcp_handle(), reinterpret_cast<sockaddr*>(&saddr), 0);
+	if (opts.reuse_port())
+	{
+		open_reuse_port_socket(saddr.ss_family, err);
+		if (err) goto exit;
+	}
+	stat = uv_tcp_bind(get_tcp_handle(), reinterpret_cast<sockaddr*>(&saddr), opts.v6only() ? UV_TCP_IPV6ONLY : 0);
 	UV_ERROR_CHECK(stat, err, exit);
+	apply_socket_options(opts, err);
 exit:
 	return;
 }
 
+// libuv (before 1.49) creates the socket inside uv_tcp_bind, too late to set
+// SO_REUSEPORT, so create it here and hand it to the handle with uv_tcp_open.
+
 void
-tcp_acceptor_uv::really_listen(std::error_code& err, connection_handler&& handler)
+tcp_acceptor_uv::open_reuse_port_socket(int family, std::error_code& err)
 {
 	err.clear();
-	m_connection_handler = std::move(handler);
+#if defined(SO_REUSEPORT) && !defined(_WIN32)
+	int on{1};
 	int stat{0};
-	if (m_is_framing)
+	int fd = ::socket(family, SOCK_STREAM, 0);
+	if (fd < 0)
 	{
-		stat = uv_listen(reinterpret_cast<uv_stream_t*>(get_tcp_handle()), 128, on_framing_connection);
+		err = std::error_code{errno, std::generic_category()};
+		goto exit;
 	}
-	else
+	if (::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &on, sizeof(on)) < 0)
+	{
+		err = std::error_code{errno, std::generic_category()};
+		::close(fd);
+		goto exit;
+	}
+	stat = uv_tcp_open(get_tcp_handle(), fd);
+	if (stat < 0)
 	{
-		stat = uv_listen(reinterpret_cast<uv_stream_t*>(get_tcp_handle()), 128, on_connection);
+		::close(fd);
 	}
 	UV_ERROR_CHECK(stat, err, exit);
 exit:
 	return;
+#else
+	err = make_error_code(std::errc::operation_not_supported);
+#endif
+}
+
+void
+tcp_acceptor_uv::really_listen(std::error_code& err, connection_handler&& handler)
+{
+	err.clear();
+	m_connection_handler = std::move(handler);
+	auto stat = uv_listen(reinterpret_cast<uv_stream_t*>(get_tcp_handle()), m_channel_options.backlog(), on_connection);
+	UV_ERROR_CHECK(stat, err, exit);
+exit:
+	return;
 }
 
+void
+tcp_acceptor_uv::really_listen(std::error_code& err, loop_selector&& selector, connection_handler&& handler)
+{
+	err.clear();
+	int stat{0};
+	if (!selector || !handler)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		goto exit;
+	}
+	m_loop_selector  = std::move(selector);
+	m_shared_handler = std::make_shared<connection_handler>(std::move(handler));
+	stat             = uv_listen(reinterpret_cast<uv_stream_t*>(get_tcp_handle()), m_channel_options.backlog(), on_handoff_connection);
+	UV_ERROR_CHECK(stat, err, exit);
+exit:
+	return;
+}
@@ -25,15 +25,22 @@
 #ifndef PRAKTOR_TCP_UV_H
 #define PRAKTOR_TCP_UV_H
 
+#include "frame_header_codec.h"
+#include "request_pool.h"
 #include "uv_error.h"
-#include <boost/endian/conversion.hpp>
+#include <algorithm>
+#include <limits>
 #include <praktor/endpoint.h>
 #include <praktor/options.h>
 #include <praktor/tcp.h>
+#include <string>
 #include <uv.h>
+#include <variant>
+#include <vector>
 
 class tcp_channel_uv;
 class tcp_acceptor_uv;
+class tcp_write_batch_req_uv;
 
 using praktor::ip::endpoint;
 using util::mutable_buffer;
@@ -45,7 +52,7 @@ using util::mutable_buffer;
  * that will be invoked when the connect request completes.
  * 
  */
-class connect_request_uv
+class connect_request_uv : public pooled_request
 {
 public:
 	/** \brief Constructor
@@ -92,23 +99,62 @@ private:
 	get_channel_shared_ptr(uv_connect_t* req);
 };
 
-class tcp_write_buf_req_uv
+/** \brief A frame header sent ahead of a write's buffers; empty for unframed writes.
+ *
+ * Write requests keep a copy, so framing a write needs no buffer of its own.
+ */
+struct write_header
+{
+	write_header() : m_size{0} {}
+
+	util::byte_type m_data[frame_header_codec::max_header_size];
+	std::size_t     m_size;
+};
+
+class tcp_write_buf_req_uv : public pooled_request
 {
 public:
-	tcp_write_buf_req_uv(mutable_buffer&& buf, praktor::channel::write_buffer_handler handler)
-		: m_write_handler{std::move(handler)},
+	tcp_write_buf_req_uv(
+			write_header const& header, mutable_buffer&& buf, praktor::channel::write_buffer_handler handler)
+		: m_header{header},
 		  m_buffer{std::move(buf)},
-		  m_uv_buffer{reinterpret_cast<char*>(m_buffer.data()), m_buffer.size()}
+		  m_write_handler{std::move(handler)},
+		  m_finished{nullptr}
 	{
 		assert(reinterpret_cast<uv_write_t*>(this) == &m_uv_write_request);
+		m_uv_buffers[0] = uv_buf_init(reinterpret_cast<char*>(m_header.m_data), m_header.m_size);
+		m_uv_buffers[1] = uv_buf_init(reinterpret_cast<char*>(m_buffer.data()), m_buffer.size());
 	}
 
+	/** \brief Writes the header and buffer from offset written on, the rest having been written already.
+	 */
 	int
-	start(uv_stream_t* chan)
+	start(uv_stream_t* chan, std::size_t written = 0)
 	{
-		return uv_write(&m_uv_write_request, chan, &m_uv_buffer, 1, on_write);
+		std::size_t first = m_header.m_size > 0 ? 0 : 1;
+		while (first < 1 && written >= m_uv_buffers[first].len)
+		{
+			written -= m_uv_buffers[first].len;
+			++first;
+		}
+		m_uv_buffers[first].base += written;
+		m_uv_buffers[first].len -= written;
+		return uv_write(&m_uv_write_request, chan, m_uv_buffers + first, 2 - first, on_write);
 	}
 
+	/** \brief Takes writes that completed before this one; their handlers run first.
+	 */
+	void
+	finish_after(tcp_write_batch_req_uv* finished)
+	{
+		m_finished = finished;
+	}
+
+	/** \brief Moves the write into failed, for a write that could not be started.
+	 */
+	void
+	hand_off(tcp_write_batch_req_uv* failed);
+
 	~tcp_write_buf_req_uv() {}
 
 private:
@@ -119,24 +165,36 @@ private:
 	static void
 	on_write(uv_write_t* req, int status);
 
-	uv_write_t                                      m_uv_write_request;
-	mutable_buffer                                  m_buffer;
-	uv_buf_t                                        m_uv_buffer;
+	uv_write_t                             m_uv_write_request;
+	write_header                           m_header;
+	mutable_buffer                         m_buffer;
+	uv_buf_t                               m_uv_buffers[2];
 	praktor::channel::write_buffer_handler m_write_handler;
+	tcp_write_batch_req_uv*                m_finished;
 };
 
 
-class tcp_write_bufs_req_uv
+class tcp_write_bufs_req_uv : public pooled_request
 {
 public:
-	tcp_write_bufs_req_uv(std::deque<mutable_buffer>&& bufs, praktor::channel::write_buffers_handler handler)
-		: m_write_handler{std::move(handler)},
+	// writes of up to this many buffers need no separate uv_buf_t array
+	static constexpr std::size_t inline_buffer_count = 8;
+
+	tcp_write_bufs_req_uv(
+			write_header const&                       header,
+			std::deque<mutable_buffer>&&              bufs,
+			praktor::channel::write_buffers_handler handler)
+		: m_header{header},
 		  m_buffers{std::move(bufs)},
-		  m_uv_buffers{new uv_buf_t[m_buffers.size()]}
+		  m_uv_buffers{m_buffers.size() <= inline_buffer_count ? m_inline_buffers : new uv_buf_t[m_buffers.size() + 1]},
+		  m_write_handler{std::move(handler)},
+		  m_finished{nullptr}
 	{
 		assert(reinterpret_cast<uv_write_t*>(this) == &m_uv_write_request);
 
-		std::size_t i = 0;
+		// slot 0 holds the header, left empty for unframed writes
+		m_uv_buffers[0] = uv_buf_init(reinterpret_cast<char*>(m_header.m_data), m_header.m_size);
+		std::size_t i = 1;
 		for (auto it = m_buffers.begin(); it != m_buffers.end(); ++it)
 		{
 			m_uv_buffers[i].base = reinterpret_cast<char*>(it->data());
@@ -145,15 +203,38 @@ public:
 		}
 	}
 
+	/** \brief Writes the header and buffers from byte offset written on, the rest having been written already.
+	 */
 	int
-	start(uv_stream_t* chan)
+	start(uv_stream_t* chan, std::size_t written = 0)
+	{
+		std::size_t first = m_header.m_size > 0 ? 0 : 1;
+		while (first < m_buffers.size() && written >= m_uv_buffers[first].len)
+		{
+			written -= m_uv_buffers[first].len;
+			++first;
+		}
+		m_uv_buffers[first].base += written;
+		m_uv_buffers[first].len -= written;
+		return uv_write(&m_uv_write_request, chan, m_uv_buffers + first, m_buffers.size() + 1 - first, on_write);
+	}
+
+	/** \brief Takes writes that completed before this one; their handlers run first.
+	 */
+	void
+	finish_after(tcp_write_batch_req_uv* finished)
 	{
-		return uv_write(&m_uv_write_request, chan, m_uv_buffers, m_buffers.size(), on_write);
+		m_finished = finished;
 	}
 
+	/** \brief Moves the write into failed, for a write that could not be started.
+	 */
+	void
+	hand_off(tcp_write_batch_req_uv* failed);
+
 	~tcp_write_bufs_req_uv()
 	{
-		if (m_uv_buffers)
+		if (m_uv_buffers != m_inline_buffers)
 		{
 			delete[] m_uv_buffers;
 		}
@@ -167,10 +248,105 @@ private:
 	static void
 	on_write(uv_write_t* req, int status);
 
-	uv_write_t                                       m_uv_write_request;
-	std::deque<mutable_buffer>                       m_buffers;
-	uv_buf_t*                                        m_uv_buffers;
+	uv_write_t                              m_uv_write_request;
+	write_header                            m_header;
+	std::deque<mutable_buffer>              m_buffers;
+	uv_buf_t*                               m_uv_buffers;
 	praktor::channel::write_buffers_handler m_write_handler;
+	tcp_write_batch_req_uv*                 m_finished;
+	uv_buf_t                                m_inline_buffers[inline_buffer_count + 1];
+};
+
+/** \brief Several channel writes gathered into a single uv_write.
+ *
+ * Used by channels with write coalescing enabled. Each write keeps its own
+ * buffers and handler; when the gathered write completes every handler is
+ * called, in the order the writes were made, with the common status.
+ *
+ * Channels also use one, never started, to hold writes that uv_try_write
+ * completed on the spot until their handlers can run from the loop.
+ */
+class tcp_write_batch_req_uv
+{
+public:
+	tcp_write_batch_req_uv() : m_byte_count{0}
+	{
+		assert(reinterpret_cast<uv_write_t*>(this) == &m_uv_write_request);
+	}
+
+	~tcp_write_batch_req_uv() {}
+
+	void
+	add(write_header const& header, mutable_buffer&& buf, praktor::channel::write_buffer_handler&& handler);
+
+	void
+	add(write_header const& header,
+		std::deque<mutable_buffer>&&              bufs,
+		praktor::channel::write_buffers_handler&& handler);
+
+	std::size_t
+	byte_count() const
+	{
+		return m_byte_count;
+	}
+
+	bool
+	empty() const
+	{
+		return m_writes.empty();
+	}
+
+	int
+	start(uv_stream_t* chan);
+
+	/** \brief Completes every write with status from the loop, for a batch that could not be started.
+	 *
+	 * The batch is deleted unrun if the loop closes before it completes.
+	 */
+	void
+	fail(uv_stream_t* chan, int status);
+
+	/** \brief Calls every handler with status and empties the batch for reuse.
+	 */
+	void
+	run_handlers(util::shared_ptr<tcp_channel_uv> const& chan, int status);
+
+	/** \brief Calls every handler with status, then deletes the batch.
+	 */
+	void
+	complete(util::shared_ptr<tcp_channel_uv> const& chan, int status);
+
+private:
+	struct buffer_write
+	{
+		mutable_buffer                         m_buffer;
+		praktor::channel::write_buffer_handler m_handler;
+	};
+
+	struct buffers_write
+	{
+		std::deque<mutable_buffer>              m_buffers;
+		praktor::channel::write_buffers_handler m_handler;
+	};
+
+	using write = std::variant<buffer_write, buffers_write>;
+
+	static void
+	on_write(uv_write_t* req, int status);
+
+	void
+	add_header(write_header const& header);
+
+	uv_write_t            m_uv_write_request;
+	std::vector<uv_buf_t> m_uv_buffers;
+	std::vector<write>    m_writes;
+	std::vector<write>    m_spare_writes;
+	std::size_t           m_byte_count;
+
+	// frame headers, back to back; m_header_slots index their uv_buf_t
+	// entries, which point into m_header_bytes once the batch starts
+	std::vector<util::byte_type> m_header_bytes;
+	std::vector<std::size_t>     m_header_slots;
 };
 
 class tcp_base_uv
@@ -206,6 +382,14 @@ public:
 	endpoint
 	really_get_endpoint(std::error_code& err);
 
+	/** \brief Applies the socket options set in opts to this handle's socket.
+	 *
+	 * nodelay and keepalive are kept by libuv until a socket exists; the
+	 * others need one, and are skipped if there is none yet.
+	 */
+	void
+	apply_socket_options(praktor::options const& opts, std::error_code& err);
+
 protected:
 	using ptr = util::shared_ptr<tcp_base_uv>;
 
@@ -293,8 +477,61 @@ class tcp_channel_uv : public tcp_base_uv, public praktor::tcp_channel
 public:
 	using ptr = util::shared_ptr<tcp_channel_uv>;
 
+	tcp_channel_uv()
+		: m_is_reading{false},
+		  m_coalesce_threshold{0},
+		  m_pending_writes{nullptr},
+		  m_finished_writes{nullptr},
+		  m_writes_in_flight{0},
+		  m_high_watermark{0},
+		  m_low_watermark{0},
+		  m_pressure_policy{praktor::write_pressure_policy::notify},
+		  m_is_under_pressure{false},
+		  m_is_read_paused{false}
+	{}
+
+	virtual ~tcp_channel_uv()
+	{
+		// pending writes are only left over if the loop closed before a flush
+		delete m_pending_writes;
+		delete m_finished_writes;
+	}
+
+	/** \brief Creates a channel of the kind opts calls for (plain, framed or delimited), configured by opts.
+	 */
+	static ptr
+	create(praktor::options const& opts);
+
+	/** \brief Initializes the handle; a family other than AF_UNSPEC creates its socket right away.
+	 */
+	void
+	init(uv_loop_t* lp, ptr const& self, std::error_code& err, unsigned int family = AF_UNSPEC);
+
+	/** \brief Applies the channel-level settings of opts.
+	 */
+	virtual void
+	configure(praktor::options const& opts)
+	{
+		m_coalesce_threshold = opts.coalesce_writes();
+		m_high_watermark     = opts.high_watermark();
+		m_low_watermark      = std::min(opts.low_watermark(), opts.high_watermark());
+		m_pressure_policy    = opts.pressure_policy();
+	}
+
+	/** \brief Submits writes gathered since the last flush.
+	 */
 	void
-	init(uv_loop_t* lp, ptr const& self, std::error_code& err);
+	flush_writes();
+
+	/** \brief Runs the handlers of writes completed on the spot, then flushes; called by the loop's write_coalescer.
+	 */
+	void
+	run_deferred_writes(ptr const& self);
+
+	/** \brief Called by write requests once their handlers have run.
+	 */
+	void
+	write_request_done();
 
 	void
 	connect(praktor::ip::endpoint const& ep, std::error_code& err, praktor::channel::connect_handler handler)
@@ -302,7 +539,7 @@ public:
 		err.clear();
 		sockaddr_storage saddr;
 		ep.to_sockaddr(saddr);
-		auto req  = new connect_request_uv(std::move(handler));
+		auto req  = new (request_pool::of(get_handle()->loop)) connect_request_uv(std::move(handler));
 		int  stat = uv_tcp_connect(
                 req->get_uv_connect_request(),
                 get_tcp_handle(),
@@ -342,10 +579,31 @@ public:
 	virtual endpoint
 	get_peer_endpoint() override;
 
+	/** \brief Adopts an already-connected socket.
+	 *
+	 * On success the channel owns sock; on failure the caller still does.
+	 */
+	void
+	open(uv_os_sock_t sock, std::error_code& err)
+	{
+		err.clear();
+		auto stat = uv_tcp_open(get_tcp_handle(), sock);
+		UV_ERROR_CHECK(stat, err, exit);
+	exit:
+		return;
+	}
+
 	virtual std::size_t
 	get_queue_size() const override
 	{
-		return get_stream_handle()->write_queue_size;
+		// includes writes gathered for coalescing, not yet handed to libuv
+		return get_stream_handle()->write_queue_size + (m_pending_writes ? m_pending_writes->byte_count() : 0);
+	}
+
+	virtual bool
+	is_under_pressure() const override
+	{
+		return m_is_under_pressure;
 	}
 
 	virtual void
@@ -354,6 +612,18 @@ public:
 		m_close_handler = std::move(handler);
 	}
 
+	virtual void
+	set_pressure_handler(praktor::channel::pressure_handler&& handler) override
+	{
+		m_pressure_handler = std::move(handler);
+	}
+
+	virtual void
+	set_drain_handler(praktor::channel::drain_handler&& handler) override
+	{
+		m_drain_handler = std::move(handler);
+	}
+
 protected:
 	virtual void
 	clear_handler() override;
@@ -370,6 +640,29 @@ protected:
 	virtual void
 	really_start_read(std::error_code& err, praktor::channel::read_handler&& handler) override;
 
+	virtual void
+	really_start_read_batch(std::error_code& err, praktor::channel::read_batch_handler&& handler) override;
+
+	/** \brief Starts libuv reading with this kind of channel's callbacks.
+	 */
+	virtual int
+	start_reading();
+
+	/** \brief Passes a read failure to whichever read handler is set.
+	 */
+	void
+	report_read_error(praktor::channel::ptr const& chan, std::error_code const& err);
+
+	/** \brief Passes a buffer to the read handler, or holds it for the batch read handler.
+	 */
+	void
+	deliver_read(praktor::channel::ptr const& chan, util::const_buffer&& buf);
+
+	/** \brief Passes the buffers held since the last batch to the batch read handler.
+	 */
+	void
+	deliver_read_batch(praktor::channel::ptr const& chan);
+
 	virtual void
 	stop_read() override;
 
@@ -399,40 +692,88 @@ protected:
 	virtual bool
 	really_close() override;
 
-	praktor::channel::read_handler  m_read_handler;
-	praktor::channel::close_handler m_close_handler;
+	void
+	submit_write(
+			mutable_buffer&&                         buf,
+			std::error_code&                         err,
+			praktor::channel::write_buffer_handler&& handler,
+			write_header const&                      header = write_header{});
+
+	void
+	submit_write(
+			std::deque<mutable_buffer>&&              bufs,
+			std::error_code&                          err,
+			praktor::channel::write_buffers_handler&& handler,
+			write_header const&                       header = write_header{});
+
+	tcp_write_batch_req_uv*
+	get_pending_writes(std::error_code& err);
+
+	bool
+	try_write(uv_buf_t const* bufs, unsigned int count, std::size_t total, std::size_t& written);
+
+	tcp_write_batch_req_uv*
+	get_finished_writes();
+
+	template<class Request>
+	void
+	start_request(Request* request, std::size_t written, std::error_code& err);
+
+	bool
+	is_write_refused(std::error_code& err);
+
+	void
+	check_write_pressure();
+
+	praktor::channel::read_handler       m_read_handler;
+	praktor::channel::read_batch_handler m_read_batch_handler;
+	praktor::channel::close_handler      m_close_handler;
+	praktor::channel::pressure_handler   m_pressure_handler;
+	praktor::channel::drain_handler      m_drain_handler;
+	bool                                 m_is_reading;
+
+	// buffers split out of the current read, for the batch read handler
+	std::vector<util::const_buffer> m_read_batch;
+
+	// write coalescing; m_pending_writes gathers writes until the next flush
+	std::size_t             m_coalesce_threshold;
+	tcp_write_batch_req_uv* m_pending_writes;
+
+	// writes uv_try_write completed, waiting for their handlers to run; the
+	// fast path is only taken with no requests in flight, to keep handlers
+	// in write order
+	tcp_write_batch_req_uv* m_finished_writes;
+	std::size_t             m_writes_in_flight;
+
+	// write queue watermarks; a channel is under pressure from reaching the
+	// high watermark until it drains to the low one
+	std::size_t                    m_high_watermark;
+	std::size_t                    m_low_watermark;
+	praktor::write_pressure_policy m_pressure_policy;
+	bool                           m_is_under_pressure;
+	bool                           m_is_read_paused;
 };
 
 class tcp_framed_channel_uv : public tcp_channel_uv
 {
 public:
-	tcp_framed_channel_uv() : m_header_byte_count{0}, m_frame_size{-1} {}
+	tcp_framed_channel_uv() : m_frame_size{-1}, m_max_frame_size{std::numeric_limits<frame_size_type>::max()} {}
 	using ptr = util::shared_ptr<tcp_framed_channel_uv>;
 
-private:
-	using frame_size_type               = std::int64_t;
-	static constexpr bool reverse_order = boost::endian::order::native != boost::endian::order::big;
+	virtual void
+	configure(praktor::options const& opts) override;
 
-	static mutable_buffer
-	pack_frame_header(std::uint64_t frame_size)
-	{
-		const std::uint64_t packed_frame_size = boost::endian::native_to_big(frame_size);
-		return mutable_buffer{&packed_frame_size, sizeof(frame_size)};
-	}
+private:
+	using frame_size_type = std::int64_t;
 
-	static std::uint64_t
-	unpack_frame_header(const void* buf_ptr)
-	{
-		std::uint64_t packed_frame_size{0};
-		::memcpy(&packed_frame_size, buf_ptr, sizeof(packed_frame_size));
-		return boost::endian::big_to_native(packed_frame_size);
-	}
+	bool
+	make_frame_header(std::uint64_t frame_size, write_header& header, std::error_code& err) const;
 
 	static void
 	on_read(uv_stream_t* stream_handle, ssize_t nread, const uv_buf_t* buf);
 
-	virtual void
-	really_start_read(std::error_code& err, praktor::channel::read_handler&& handler) override;
+	virtual int
+	start_reading() override;
 
 	virtual void
 	really_write(mutable_buffer&& buf, std::error_code& err, praktor::channel::write_buffer_handler&& handler)
@@ -444,8 +785,18 @@ private:
 			std::error_code&                                   err,
 			praktor::channel::write_buffers_handler&& handler) override;
 
+	/** \brief Parses frames out of size bytes read into a read_buffer_pool block, then releases it.
+	 */
+	void
+	read_to_frame(ptr const& channel_ptr, util::byte_type* data, std::size_t size);
+
+	void
+	deliver_frame(praktor::channel::ptr const& chan, util::const_buffer&& frame);
+
+	/** \brief Stops reading and reports a frame over the size limit; the stream cannot be resynchronized.
+	 */
 	void
-	read_to_frame(ptr channel_ptr, util::const_buffer&& buf);
+	reject_frame(praktor::channel::ptr const& chan);
 
 	bool
 	is_frame_size_valid() const
@@ -453,17 +804,76 @@ private:
 		return m_frame_size >= 0;
 	}
 
+	frame_header_codec m_codec;
+	frame_size_type    m_frame_size;
+	std::uint64_t      m_max_frame_size;
+	mutable_buffer     m_payload_buffer;
+};
+
+/** \brief A channel that splits its input into records ending in a delimiter.
+ *
+ * Records lying whole within a read block are delivered as slices sharing
+ * it; a record that straddles reads is gathered into a buffer of its own.
+ * The scan looks for the delimiter's first byte with memchr, which the C
+ * library vectorizes, and compares the rest in place.
+ */
+class tcp_delimited_channel_uv : public tcp_channel_uv
+{
+public:
+	tcp_delimited_channel_uv() : m_max_record_size{0} {}
+	using ptr = util::shared_ptr<tcp_delimited_channel_uv>;
+
+	virtual void
+	configure(praktor::options const& opts) override;
+
+private:
+	static void
+	on_read(uv_stream_t* stream_handle, ssize_t nread, const uv_buf_t* buf);
+
+	virtual int
+	start_reading() override;
+
+	/** \brief Splits size bytes read into a read_buffer_pool block into records, then releases it.
+	 */
+	void
+	read_to_record(ptr const& channel_ptr, util::byte_type* data, std::size_t size);
+
+	/** \brief Finds the delimiter in [position, size) of data; size if it is not there whole.
+	 */
+	std::size_t
+	find_delimiter(util::byte_type const* data, std::size_t position, std::size_t size) const;
+
+	/** \brief Finds a delimiter that starts in m_record and ends in data.
+	 *
+	 * \return true if found, with record_end set to where it starts in
+	 * m_record, and data_start to where it ends in data.
+	 */
+	bool
+	find_straddling_delimiter(
+			util::byte_type const* data,
+			std::size_t            size,
+			std::size_t&           record_end,
+			std::size_t&           data_start) const;
+
+	/** \brief Appends to the gathered record; false if that takes it over the size limit.
+	 */
+	bool
+	append_to_record(util::byte_type const* data, std::size_t size);
+
 	bool
-	is_header_complete() const
+	is_record_too_large(std::size_t size) const
 	{
-		assert(m_header_byte_count <= sizeof(frame_size_type));
-		return m_header_byte_count == sizeof(frame_size_type);
+		return m_max_record_size > 0 && size > m_max_record_size;
 	}
 
-	std::size_t          m_header_byte_count;
-	frame_size_type      m_frame_size;
-	util::byte_type m_header_buf[sizeof(frame_size_type)];
-	mutable_buffer       m_payload_buffer;
+	/** \brief Stops reading and reports a record over the size limit.
+	 */
+	void
+	reject_record(praktor::channel::ptr const& chan);
+
+	std::string    m_delimiter;
+	std::size_t    m_max_record_size;
+	mutable_buffer m_record;
 };
 
 class tcp_acceptor_uv : public tcp_base_uv, public praktor::tcp_acceptor
@@ -472,7 +882,7 @@ public:
 	using ptr = util::shared_ptr<tcp_acceptor_uv>;
 
 	tcp_acceptor_uv()
-	: m_is_framing{false}
+	: m_channel_options{praktor::ip::endpoint{}}
 	{}
 
 	void
@@ -487,6 +897,8 @@ public:
 			m_close_handler = nullptr;
 		}
 		m_connection_handler = nullptr;
+		m_loop_selector      = nullptr;
+		m_shared_handler.reset();
 	}
 
 	virtual endpoint
@@ -543,7 +955,10 @@ private:
 	on_connection(uv_stream_t* handle, int stat);
 
 	static void
-	on_framing_connection(uv_stream_t* handle, int stat);
+	on_handoff_connection(uv_stream_t* handle, int stat);
+
+	uv_os_sock_t
+	accept_detached(std::error_code& err);
 
 	virtual std::shared_ptr<praktor::loop>
 	loop() override
@@ -560,12 +975,22 @@ private:
 	virtual void
 	really_bind(praktor::options const& opts, std::error_code& err) override;
 
+	void
+	open_reuse_port_socket(int family, std::error_code& err);
+
 	virtual void
 	really_listen(std::error_code& err, connection_handler&& handler) override;
 
+	virtual void
+	really_listen(std::error_code& err, loop_selector&& selector, connection_handler&& handler) override;
+
 	praktor::acceptor::connection_handler m_connection_handler;
 	praktor::acceptor::close_handler      m_close_handler;
-	bool	m_is_framing;
+	praktor::options                      m_channel_options;
+
+	// handoff mode; the handler is shared with connections in flight to other loops
+	praktor::acceptor::loop_selector                       m_loop_selector;
+	std::shared_ptr<praktor::acceptor::connection_handler> m_shared_handler;
 };
 
 #endif    // PRAKTOR_TCP_UV_H
\ No newline at end of file
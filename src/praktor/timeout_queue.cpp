@@ -0,0 +1,54 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "timeout_queue.h"
+
+bool
+praktor::timeout::is_pending() const
+{
+	return m_entry && m_entry->m_generation.load(std::memory_order_relaxed) == m_generation;
+}
+
+bool
+praktor::timeout::cancel()
+{
+	if (!is_pending())
+	{
+		return false;
+	}
+	m_entry->m_queue->cancel(m_entry);
+	return true;
+}
+
+bool
+praktor::timeout::restart(std::chrono::microseconds delay)
+{
+	if (!is_pending())
+	{
+		return false;
+	}
+	m_entry->m_queue->restart(m_entry, delay);
+	return true;
+}
@@ -0,0 +1,192 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef PRAKTOR_TIMEOUT_QUEUE_H
+#define PRAKTOR_TIMEOUT_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <praktor/timeout.h>
+#include <vector>
+
+struct timeout_entry
+{
+	timeout_queue*             m_queue;
+	timeout_entry*             m_next_free;
+	std::atomic<std::uint64_t> m_generation{0};    // bumped on release; stale handles stop matching
+	praktor::timeout::handler  m_handler;
+
+	// only the owning loop's thread writes; a stale handle elsewhere may still read
+	void
+	bump_generation()
+	{
+		m_generation.store(m_generation.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	}
+};
+
+/** \brief A per-loop structure that praktor::timeout handles refer to.
+ */
+class timeout_queue
+{
+public:
+	virtual void
+	cancel(timeout_entry* entry)
+			= 0;
+
+	virtual void
+	restart(timeout_entry* entry, std::chrono::microseconds delay)
+			= 0;
+
+protected:
+	~timeout_queue() = default;
+
+	static praktor::timeout
+	make_handle(timeout_entry* entry)
+	{
+		return praktor::timeout{entry, entry->m_generation.load(std::memory_order_relaxed)};
+	}
+};
+
+/** \brief Chunked, recycling allocator for a queue's entries.
+ *
+ * Entries are never freed while the process runs. A praktor::timeout can
+ * outlive its loop, for instance inside a promise settled after the loop
+ * is gone, so a destroyed pool parks its chunks in a process-wide store
+ * for later pools to reuse. Every generation is bumped on the way, so any
+ * handle still referring to them reads a valid entry that no longer
+ * matches.
+ */
+template<class Entry>
+class timeout_entry_pool
+{
+public:
+	explicit timeout_entry_pool(timeout_queue* queue) : m_queue{queue}, m_free{nullptr} {}
+
+	~timeout_entry_pool()
+	{
+		for (auto& chunk : m_chunks)
+		{
+			for (std::size_t i = 0; i < chunk_size; ++i)
+			{
+				chunk[i].bump_generation();
+				auto handler = std::move(chunk[i].m_handler);
+			}
+		}
+
+		auto&                       store = retired();
+		std::lock_guard<std::mutex> guard(store.m_mutex);
+		for (auto& chunk : m_chunks)
+		{
+			store.m_chunks.emplace_back(std::move(chunk));
+		}
+	}
+
+	timeout_entry_pool(timeout_entry_pool const&) = delete;
+	timeout_entry_pool(timeout_entry_pool&&)      = delete;
+
+	timeout_entry_pool&
+	operator=(timeout_entry_pool const&)
+			= delete;
+
+	timeout_entry_pool&
+	operator=(timeout_entry_pool&&)
+			= delete;
+
+	Entry*
+	acquire()
+	{
+		if (!m_free)
+		{
+			auto chunk = take_retired();
+			if (!chunk)
+			{
+				chunk = std::make_unique<Entry[]>(chunk_size);
+			}
+			for (std::size_t i = 0; i < chunk_size; ++i)
+			{
+				chunk[i].m_queue     = m_queue;
+				chunk[i].m_next_free = m_free;
+				m_free               = &chunk[i];
+			}
+			m_chunks.emplace_back(std::move(chunk));
+		}
+		auto entry = static_cast<Entry*>(m_free);
+		m_free     = entry->m_next_free;
+		return entry;
+	}
+
+	/* The handler is destroyed last: anything its captures do on the way
+	 * out already sees a stale handle and an entry back on the free list.
+	 */
+	void
+	release(Entry* entry)
+	{
+		entry->bump_generation();
+		auto handler       = std::move(entry->m_handler);
+		entry->m_next_free = m_free;
+		m_free             = entry;
+	}
+
+private:
+	static constexpr std::size_t chunk_size = 256;
+
+	struct retired_chunks
+	{
+		std::mutex                            m_mutex;
+		std::vector<std::unique_ptr<Entry[]>> m_chunks;
+	};
+
+	// deliberately never destroyed, so loops torn down during static
+	// destruction can still retire their chunks
+	static retired_chunks&
+	retired()
+	{
+		static auto store = new retired_chunks;
+		return *store;
+	}
+
+	static std::unique_ptr<Entry[]>
+	take_retired()
+	{
+		std::unique_ptr<Entry[]>    chunk;
+		auto&                       store = retired();
+		std::lock_guard<std::mutex> guard(store.m_mutex);
+		if (!store.m_chunks.empty())
+		{
+			chunk = std::move(store.m_chunks.back());
+			store.m_chunks.pop_back();
+		}
+		return chunk;
+	}
+
+	timeout_queue*                        m_queue;
+	timeout_entry*                        m_free;
+	std::vector<std::unique_ptr<Entry[]>> m_chunks;
+};
+
+#endif    // PRAKTOR_TIMEOUT_QUEUE_H
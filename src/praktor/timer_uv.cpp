@@ -26,7 +26,13 @@
 #include "loop_uv.h"
 #include <iostream>
 
-timer_uv::timer_uv(uv_loop_t* lp, std::error_code& err) : m_handler{}
+timer_uv::timer_uv(uv_loop_t* lp, std::error_code& err)
+	: m_handler{},
+	  m_is_fixed_rate{false},
+	  m_interval{0},
+	  m_next_due{0},
+	  m_has_slack{false},
+	  m_requested_deadline{0}
 {
 	err.clear();;
 	auto status = uv_timer_init(lp, &m_uv_timer);
@@ -35,7 +41,43 @@ exit:
 	return;
 }
 
-timer_uv::timer_uv(uv_loop_t* lp, std::error_code& err, praktor::timer::handler handler) : m_handler{std::move(handler)}
+timer_uv::timer_uv(uv_loop_t* lp, std::error_code& err, praktor::timer::handler handler)
+	: m_handler{std::in_place_type<praktor::timer::handler>, std::move(handler)},
+	  m_is_fixed_rate{false},
+	  m_interval{0},
+	  m_next_due{0},
+	  m_has_slack{false},
+	  m_requested_deadline{0}
+{
+	err.clear();
+	auto status = uv_timer_init(lp, &m_uv_timer);
+	UV_ERROR_CHECK(status, err, exit);
+exit:
+	return;
+}
+
+timer_uv::timer_uv(uv_loop_t* lp, std::error_code& err, praktor::timer::void_handler handler)
+	: m_handler{std::in_place_type<praktor::timer::void_handler>, std::move(handler)},
+	  m_is_fixed_rate{false},
+	  m_interval{0},
+	  m_next_due{0},
+	  m_has_slack{false},
+	  m_requested_deadline{0}
+{
+	err.clear();
+	auto status = uv_timer_init(lp, &m_uv_timer);
+	UV_ERROR_CHECK(status, err, exit);
+exit:
+	return;
+}
+
+timer_uv::timer_uv(uv_loop_t* lp, std::error_code& err, loop_handler handler)
+	: m_handler{std::in_place_type<loop_handler>, std::move(handler)},
+	  m_is_fixed_rate{false},
+	  m_interval{0},
+	  m_next_due{0},
+	  m_has_slack{false},
+	  m_requested_deadline{0}
 {
 	err.clear();
 	auto status = uv_timer_init(lp, &m_uv_timer);
@@ -63,7 +105,7 @@ timer_uv::start(std::chrono::milliseconds timeout, std::error_code& err)
 	int status = 0;
 	err.clear();
 
-	if (!m_handler)
+	if (!has_handler())
 	{
 		err = make_error_code(std::errc::invalid_argument);
 		goto exit;
@@ -75,7 +117,7 @@ timer_uv::start(std::chrono::milliseconds timeout, std::error_code& err)
 		goto exit;
 	}
 
-	status = uv_timer_start(&m_uv_timer, on_timer_expire, timeout.count(), 0);
+	status = arm(timeout, std::chrono::milliseconds{0});
 	UV_ERROR_CHECK(status, err, exit);
 
 exit:
@@ -87,7 +129,7 @@ timer_uv::start(std::chrono::milliseconds timeout)
 {
 	int status = 0;
 
-	if (!m_handler)
+	if (!has_handler())
 	{
 		throw std::system_error{make_error_code(std::errc::invalid_argument)};
 	}
@@ -97,10 +139,46 @@ timer_uv::start(std::chrono::milliseconds timeout)
 		throw std::system_error{make_error_code(std::errc::operation_in_progress)};
 	}
 
-	status = uv_timer_start(&m_uv_timer, on_timer_expire, timeout.count(), 0);
+	status = arm(timeout, std::chrono::milliseconds{0});
 	UV_ERROR_THROW(status);
 }
 
+void
+timer_uv::start(std::chrono::milliseconds timeout, std::chrono::milliseconds slack, std::error_code& err)
+{
+	int status = 0;
+	err.clear();
+
+	if (!has_handler() || slack.count() < 0)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		goto exit;
+	}
+
+	if (is_active())
+	{
+		err = make_error_code(std::errc::operation_in_progress);
+		goto exit;
+	}
+
+	status = arm(timeout, slack);
+	UV_ERROR_CHECK(status, err, exit);
+
+exit:
+	return;
+}
+
+void
+timer_uv::start(std::chrono::milliseconds timeout, std::chrono::milliseconds slack)
+{
+	std::error_code err;
+	start(timeout, slack, err);
+	if (err)
+	{
+		throw std::system_error{err};
+	}
+}
+
 void
 timer_uv::start(std::chrono::milliseconds timeout, std::error_code& err, praktor::timer::handler handler)
 {
@@ -119,8 +197,8 @@ timer_uv::start(std::chrono::milliseconds timeout, std::error_code& err, praktor
 		goto exit;
 	}
 
-	m_handler = std::move(handler);
-	status = uv_timer_start(&m_uv_timer, on_timer_expire, timeout.count(), 0);
+	m_handler.emplace<praktor::timer::handler>(std::move(handler));
+	status    = arm(timeout, std::chrono::milliseconds{0});
 	UV_ERROR_CHECK(status, err, exit);
 
 exit:
@@ -142,8 +220,8 @@ timer_uv::start(std::chrono::milliseconds timeout, praktor::timer::handler handl
 		throw std::system_error{make_error_code(std::errc::operation_in_progress)};
 	}
 
-	m_handler = std::move(handler);
-	status = uv_timer_start(&m_uv_timer, on_timer_expire, timeout.count(), 0);
+	m_handler.emplace<praktor::timer::handler>(std::move(handler));
+	status    = arm(timeout, std::chrono::milliseconds{0});
 	UV_ERROR_THROW(status);
 }
 
@@ -165,8 +243,8 @@ timer_uv::start(std::chrono::milliseconds timeout, std::error_code& err, praktor
 		goto exit;
 	}
 
-	m_handler = [=, handler{std::move(handler)}](praktor::timer::ptr) { handler(); };
-	status = uv_timer_start(&m_uv_timer, on_timer_expire, timeout.count(), 0);
+	m_handler.emplace<praktor::timer::void_handler>(std::move(handler));
+	status    = arm(timeout, std::chrono::milliseconds{0});
 	UV_ERROR_CHECK(status, err, exit);
 
 exit:
@@ -188,15 +266,70 @@ timer_uv::start(std::chrono::milliseconds timeout, praktor::timer::void_handler
 		throw std::system_error{make_error_code(std::errc::operation_in_progress)};
 	}
 
-	m_handler = [=, handler{std::move(handler)}](praktor::timer::ptr) { handler(); };
-	status = uv_timer_start(&m_uv_timer, on_timer_expire, timeout.count(), 0);
+	m_handler.emplace<praktor::timer::void_handler>(std::move(handler));
+	status    = arm(timeout, std::chrono::milliseconds{0});
 	UV_ERROR_THROW(status);
 }
 
+void
+timer_uv::start_periodic(
+		std::chrono::milliseconds     initial,
+		std::chrono::milliseconds     interval,
+		praktor::timer::periodic_mode mode,
+		std::error_code&              err)
+{
+	int status = 0;
+	err.clear();
+
+	if (!has_handler() || interval.count() <= 0 || initial.count() < 0)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		goto exit;
+	}
+
+	if (is_active())
+	{
+		err = make_error_code(std::errc::operation_in_progress);
+		goto exit;
+	}
+
+	m_has_slack = false;
+	if (mode == praktor::timer::periodic_mode::fixed_rate)
+	{
+		m_is_fixed_rate = true;
+		m_interval      = interval.count();
+		m_next_due      = uv_now(m_uv_timer.loop) + initial.count();
+		status          = uv_timer_start(&m_uv_timer, on_timer_expire, initial.count(), 0);
+	}
+	else
+	{
+		status = uv_timer_start(&m_uv_timer, on_timer_expire, initial.count(), interval.count());
+	}
+	UV_ERROR_CHECK(status, err, exit);
+
+exit:
+	return;
+}
+
+void
+timer_uv::start_periodic(
+		std::chrono::milliseconds     initial,
+		std::chrono::milliseconds     interval,
+		praktor::timer::periodic_mode mode)
+{
+	std::error_code err;
+	start_periodic(initial, interval, mode, err);
+	if (err)
+	{
+		throw std::system_error{err};
+	}
+}
+
 void
 timer_uv::stop(std::error_code& err)
 {
 	err.clear();
+	m_is_fixed_rate = false;
 
 	if (is_active())
 	{
@@ -211,6 +344,7 @@ exit:
 void
 timer_uv::stop()
 {
+	m_is_fixed_rate = false;
 	if (is_active())
 	{
 		auto status = uv_timer_stop(&m_uv_timer);
@@ -248,10 +382,33 @@ timer_uv::is_pending() const
 void
 timer_uv::clear()
 {
-	m_handler = nullptr;          // clear handler--possibly a closure holding shared references
+	m_handler = handler_slot{};    // clear handler--possibly a closure holding shared references
 	m_data.m_impl_ptr.reset();    // release shared self-reference
 }
 
+bool
+timer_uv::has_handler() const
+{
+	return std::visit([](auto const& handler) { return static_cast<bool>(handler); }, m_handler);
+}
+
+void
+timer_uv::invoke_handler()
+{
+	if (auto handler = std::get_if<praktor::timer::handler>(&m_handler))
+	{
+		(*handler)(m_data.m_impl_ptr);
+	}
+	else if (auto handler = std::get_if<praktor::timer::void_handler>(&m_handler))
+	{
+		(*handler)();
+	}
+	else if (auto handler = std::get_if<loop_handler>(&m_handler))
+	{
+		(*handler)(loop());
+	}
+}
+
 void
 timer_uv::on_timer_close(uv_handle_t* handle)
 {
@@ -266,7 +423,13 @@ timer_uv::on_timer_expire(uv_timer_t* handle)
 {
 	timer_handle_data* const data
 			= reinterpret_cast<timer_handle_data*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(handle)));
-	data->m_impl_ptr->m_handler(data->m_impl_ptr);
+	data->m_impl_ptr->count_expiration();
+	if (data->m_impl_ptr->m_is_fixed_rate)
+	{
+		// re-arm before the handler runs, so the handler may stop or restart the timer
+		data->m_impl_ptr->rearm_fixed_rate();
+	}
+	data->m_impl_ptr->invoke_handler();
 
 	if (!uv_is_active(reinterpret_cast<uv_handle_t*>(handle)))
 	{
@@ -280,3 +443,58 @@ timer_uv::on_timer_expire(uv_timer_t* handle)
 		}
 	}
 }
+
+void
+timer_uv::rearm_fixed_rate()
+{
+	auto now = uv_now(m_uv_timer.loop);
+	m_next_due += m_interval;
+	if (m_next_due < now)
+	{
+		m_next_due += ((now - m_next_due + m_interval - 1) / m_interval) * m_interval;
+	}
+	uv_timer_start(&m_uv_timer, on_timer_expire, m_next_due - now, 0);
+}
+
+int
+timer_uv::arm(std::chrono::milliseconds timeout, std::chrono::milliseconds slack)
+{
+	auto now      = uv_now(m_uv_timer.loop);
+	auto delay    = static_cast<std::uint64_t>(timeout.count() > 0 ? timeout.count() : 0);
+	auto deadline = now + delay;
+
+	m_has_slack          = slack.count() > 0;
+	m_requested_deadline = deadline;
+	if (m_has_slack)
+	{
+		// round up to a multiple of the largest power of two within slack;
+		// timers whose windows overlap share the boundary, since a coarser
+		// boundary is also a multiple of every finer one
+		std::uint64_t grain = 1;
+		while (grain * 2 <= static_cast<std::uint64_t>(slack.count()))
+		{
+			grain *= 2;
+		}
+		delay = (deadline + grain - 1) / grain * grain - now;
+	}
+	return uv_timer_start(&m_uv_timer, on_timer_expire, delay, 0);
+}
+
+void
+timer_uv::count_expiration()
+{
+	auto& data  = *reinterpret_cast<loop_data*>(m_uv_timer.loop->data);
+	auto  now   = uv_now(m_uv_timer.loop);
+	auto& stats = data.m_timer_stats;
+
+	++stats.expirations;
+	if (now != data.m_last_timer_wakeup)
+	{
+		data.m_last_timer_wakeup = now;
+	}
+	else if (m_has_slack && m_requested_deadline < now)
+	{
+		// deferred past its own deadline into a wakeup another timer started
+		++stats.wakeups_saved;
+	}
+}
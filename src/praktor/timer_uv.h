@@ -26,8 +26,10 @@
 #define PRAKTOR_TIMER_UV_H
 
 #include "uv_error.h"
+#include <memory>
 #include <praktor/timer.h>
 #include <uv.h>
+#include <variant>
 
 class timer_uv;
 
@@ -41,10 +43,17 @@ class timer_uv : public praktor::timer
 public:
 	using ptr = util::shared_ptr<timer_uv>;
 
+	// the signature of loop::scheduled_handler, which loop.h cannot provide here
+	using loop_handler = praktor::unique_function<void(std::shared_ptr<praktor::loop> const&)>;
+
 	timer_uv(uv_loop_t* lp, std::error_code& err);
 
 	timer_uv(uv_loop_t* lp, std::error_code& err, praktor::timer::handler handler);
 
+	timer_uv(uv_loop_t* lp, std::error_code& err, praktor::timer::void_handler handler);
+
+	timer_uv(uv_loop_t* lp, std::error_code& err, loop_handler handler);
+
 	virtual ~timer_uv();
 
 	void
@@ -60,6 +69,12 @@ private:
 	virtual void
 	start(std::chrono::milliseconds timeout) override;
 
+	virtual void
+	start(std::chrono::milliseconds timeout, std::chrono::milliseconds slack, std::error_code& err) override;
+
+	virtual void
+	start(std::chrono::milliseconds timeout, std::chrono::milliseconds slack) override;
+
 	virtual void
 	start(std::chrono::milliseconds timeout, std::error_code& err, praktor::timer::handler handler) override;
 
@@ -72,6 +87,19 @@ private:
 	virtual void
 	start(std::chrono::milliseconds timeout, praktor::timer::void_handler handler) override;
 
+	virtual void
+	start_periodic(
+			std::chrono::milliseconds     initial,
+			std::chrono::milliseconds     interval,
+			praktor::timer::periodic_mode mode,
+			std::error_code&              err) override;
+
+	virtual void
+	start_periodic(
+			std::chrono::milliseconds     initial,
+			std::chrono::milliseconds     interval,
+			praktor::timer::periodic_mode mode) override;
+
 	virtual void
 	stop(std::error_code& err) override;
 
@@ -93,12 +121,36 @@ private:
 	void
 	clear();
 
+	bool
+	has_handler() const;
+
+	void
+	invoke_handler();
+
 	static void
 	on_timer_expire(uv_timer_t* handle);
 
-	uv_timer_t                       m_uv_timer;
-	timer_handle_data                m_data;
-	praktor::timer::handler m_handler;
+	void
+	rearm_fixed_rate();
+
+	int
+	arm(std::chrono::milliseconds timeout, std::chrono::milliseconds slack);
+
+	void
+	count_expiration();
+
+	// each signature is stored as given; wrapping one in another would
+	// outgrow unique_function's inline storage
+	using handler_slot = std::variant<praktor::timer::handler, praktor::timer::void_handler, loop_handler>;
+
+	uv_timer_t        m_uv_timer;
+	timer_handle_data m_data;
+	handler_slot      m_handler;
+	bool              m_is_fixed_rate;         // re-armed by rearm_fixed_rate(), not libuv's repeat
+	std::uint64_t     m_interval;
+	std::uint64_t     m_next_due;              // in loop milliseconds
+	bool              m_has_slack;
+	std::uint64_t     m_requested_deadline;    // before rounding for slack
 };
 
 #endif    // PRAKTOR_TIMER_UV_H
\ No newline at end of file
@@ -0,0 +1,305 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "timing_wheel.h"
+#include <algorithm>
+
+timing_wheel::timing_wheel()
+	: m_loop{nullptr},
+	  m_is_initialized{false},
+	  m_current{0},
+	  m_armed_for{no_deadline},
+	  m_count{0},
+	  m_pool{this}
+{
+	for (auto& slot : m_slots)
+	{
+		slot.m_next = slot.m_prev = &slot;
+	}
+	m_expired.m_next = m_expired.m_prev = &m_expired;
+}
+
+praktor::timeout
+timing_wheel::add(uv_loop_t* lp, std::chrono::milliseconds delay, praktor::timeout::handler&& handler)
+{
+	if (!m_is_initialized)
+	{
+		uv_timer_init(lp, &m_timer);
+		uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_timer), this);
+		m_loop           = lp;
+		m_current        = uv_now(lp);
+		m_is_initialized = true;
+	}
+
+	auto now = uv_now(m_loop);
+	if (m_count == 0 && now > m_current)
+	{
+		m_current = now;    // nothing to expire on the way
+	}
+
+	auto entry        = m_pool.acquire();
+	entry->m_deadline = now + (delay.count() > 0 ? static_cast<std::uint64_t>(delay.count()) : 0);
+	entry->m_handler  = std::move(handler);
+	link(entry);
+	++m_count;
+
+	if (entry->m_deadline < m_armed_for)
+	{
+		arm_timer();
+	}
+	return make_handle(entry);
+}
+
+void
+timing_wheel::cancel(timeout_entry* base)
+{
+	auto entry = static_cast<timing_wheel_entry*>(base);
+	unlink(entry);
+	auto handler = std::move(entry->m_handler);
+	release(entry);
+	if (m_count == 0)
+	{
+		uv_timer_stop(&m_timer);
+		m_armed_for = no_deadline;
+	}
+}
+
+void
+timing_wheel::restart(timeout_entry* base, std::chrono::microseconds delay)
+{
+	auto entry = static_cast<timing_wheel_entry*>(base);
+	auto ms    = std::chrono::ceil<std::chrono::milliseconds>(delay).count();
+	unlink(entry);
+	entry->m_deadline = uv_now(m_loop) + (ms > 0 ? static_cast<std::uint64_t>(ms) : 0);
+	link(entry);
+	if (entry->m_deadline < m_armed_for)
+	{
+		arm_timer();
+	}
+}
+
+void
+timing_wheel::clear()
+{
+	auto drain = [this](timing_wheel_link& list) {
+		while (!is_empty(list))
+		{
+			auto entry = static_cast<timing_wheel_entry*>(list.m_next);
+			unlink(entry);
+			auto handler = std::move(entry->m_handler);
+			release(entry);
+		}
+	};
+
+	for (auto& slot : m_slots)
+	{
+		drain(slot);
+	}
+	drain(m_expired);
+
+	if (m_is_initialized)
+	{
+		uv_timer_stop(&m_timer);
+	}
+	m_armed_for = no_deadline;
+}
+
+void
+timing_wheel::release(timing_wheel_entry* entry)
+{
+	m_pool.release(entry);
+	--m_count;
+}
+
+void
+timing_wheel::link(timing_wheel_entry* entry)
+{
+	timing_wheel_link* slot = nullptr;
+
+	if (entry->m_deadline <= m_current)
+	{
+		slot = &m_slots[m_current & (root_size - 1)];
+	}
+	else
+	{
+		auto delta = entry->m_deadline - m_current;
+		if (delta < root_size)
+		{
+			slot = &m_slots[entry->m_deadline & (root_size - 1)];
+		}
+		else
+		{
+			// beyond the top level's reach, park in its furthest slot; the
+			// entry is placed again by its true deadline when that slot cascades
+			auto placement = delta > max_span ? m_current + max_span : entry->m_deadline;
+			for (unsigned level = 1; level <= level_count; ++level)
+			{
+				if (delta < (std::uint64_t{1} << (level_shift(level) + level_bits)) || level == level_count)
+				{
+					slot = &m_slots[level_slot(level, placement)];
+					break;
+				}
+			}
+		}
+	}
+
+	entry->m_next        = slot;
+	entry->m_prev        = slot->m_prev;
+	slot->m_prev->m_next = entry;
+	slot->m_prev         = entry;
+}
+
+void
+timing_wheel::unlink(timing_wheel_entry* entry)
+{
+	entry->m_prev->m_next = entry->m_next;
+	entry->m_next->m_prev = entry->m_prev;
+}
+
+void
+timing_wheel::cascade(unsigned level)
+{
+	auto& slot = m_slots[level_slot(level, m_current)];
+	while (!is_empty(slot))
+	{
+		auto entry = static_cast<timing_wheel_entry*>(slot.m_next);
+		unlink(entry);
+		link(entry);
+	}
+}
+
+void
+timing_wheel::advance(std::uint64_t now)
+{
+	while (m_count > 0)
+	{
+		auto next = next_expiry();
+		if (next > now)
+		{
+			break;
+		}
+
+		// no slot expires or cascades before next, so jump straight to it
+		m_current = next;
+
+		unsigned top = 0;
+		while (top < level_count && (m_current & ((std::uint64_t{1} << level_shift(top + 1)) - 1)) == 0)
+		{
+			++top;
+		}
+		for (auto level = top; level > 0; --level)
+		{
+			cascade(level);
+		}
+
+		auto& slot = m_slots[m_current & (root_size - 1)];
+		if (!is_empty(slot))
+		{
+			m_expired.m_next         = slot.m_next;
+			m_expired.m_prev         = slot.m_prev;
+			m_expired.m_next->m_prev = &m_expired;
+			m_expired.m_prev->m_next = &m_expired;
+			slot.m_next = slot.m_prev = &slot;
+		}
+		++m_current;
+
+		// handlers may arm, cancel or restart anything, including entries
+		// still waiting on m_expired, or clear the wheel outright
+		while (!is_empty(m_expired))
+		{
+			auto entry = static_cast<timing_wheel_entry*>(m_expired.m_next);
+			unlink(entry);
+			auto handler = std::move(entry->m_handler);
+			release(entry);
+			handler();
+		}
+	}
+
+	if (m_current <= now)
+	{
+		m_current = now + 1;
+	}
+}
+
+std::uint64_t
+timing_wheel::next_expiry() const
+{
+	auto result = no_deadline;
+
+	for (unsigned i = 0; i < root_size; ++i)
+	{
+		if (!is_empty(m_slots[(m_current + i) & (root_size - 1)]))
+		{
+			result = m_current + i;
+			break;
+		}
+	}
+
+	for (unsigned level = 1; level <= level_count; ++level)
+	{
+		// the first boundary at or after m_current; when m_current sits on a
+		// boundary, that boundary's slot has not been cascaded yet
+		auto shift = level_shift(level);
+		auto first = (m_current + (std::uint64_t{1} << shift) - 1) >> shift;
+		if ((first << shift) >= result)
+		{
+			break;    // this level's boundaries, and every higher level's, come too late
+		}
+		for (unsigned k = 0; k < level_size; ++k)
+		{
+			auto boundary = (first + k) << shift;
+			if (!is_empty(m_slots[level_slot(level, boundary)]))
+			{
+				result = std::min(result, boundary);
+				break;
+			}
+		}
+	}
+	return result;
+}
+
+void
+timing_wheel::arm_timer()
+{
+	auto next = next_expiry();
+	if (next == no_deadline)
+	{
+		uv_timer_stop(&m_timer);
+		m_armed_for = no_deadline;
+		return;
+	}
+	auto now = uv_now(m_loop);
+	uv_timer_start(&m_timer, on_timer, next > now ? next - now : 0, 0);
+	m_armed_for = next;
+}
+
+void
+timing_wheel::on_timer(uv_timer_t* handle)
+{
+	auto self         = reinterpret_cast<timing_wheel*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(handle)));
+	self->m_armed_for = no_deadline;
+	self->advance(uv_now(self->m_loop));
+	self->arm_timer();
+}
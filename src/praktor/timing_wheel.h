@@ -0,0 +1,165 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef PRAKTOR_TIMING_WHEEL_H
+#define PRAKTOR_TIMING_WHEEL_H
+
+#include "timeout_queue.h"
+#include <chrono>
+#include <cstdint>
+#include <uv.h>
+
+struct timing_wheel_link
+{
+	timing_wheel_link* m_next;
+	timing_wheel_link* m_prev;
+};
+
+struct timing_wheel_entry : timing_wheel_link, timeout_entry
+{
+	std::uint64_t m_deadline;
+};
+
+/** \brief Per-loop hierarchical timing wheel backing loop::set_timeout().
+ *
+ * Deadlines are kept in loop milliseconds. The wheel has a 256-slot root
+ * level of 1 ms slots and four 64-slot levels above it, each slot of which
+ * spans the whole of the level below, covering 2^32 ms (about 49 days);
+ * later deadlines sit in the top level until they come within range. Each
+ * slot is an intrusive doubly-linked list, so arming and cancelling are
+ * O(1); entries in the upper levels are redistributed downward as the
+ * wheel's time reaches their slot.
+ *
+ * A single uv_timer_t, created on first use, is armed for the earliest
+ * slot that holds anything.
+ */
+class timing_wheel : public timeout_queue
+{
+public:
+	timing_wheel();
+
+	timing_wheel(timing_wheel const&) = delete;
+	timing_wheel(timing_wheel&&)      = delete;
+
+	timing_wheel&
+	operator=(timing_wheel const&)
+			= delete;
+
+	timing_wheel&
+	operator=(timing_wheel&&)
+			= delete;
+
+	praktor::timeout
+	add(uv_loop_t* lp, std::chrono::milliseconds delay, praktor::timeout::handler&& handler);
+
+	virtual void
+	cancel(timeout_entry* entry) override;
+
+	virtual void
+	restart(timeout_entry* entry, std::chrono::microseconds delay) override;
+
+	/** \brief Destroys pending handlers without invoking them; for loop close.
+	 *
+	 * The timer handle itself is closed by the loop's handle walk.
+	 */
+	void
+	clear();
+
+	bool
+	owns(uv_handle_t const* handle) const
+	{
+		return m_is_initialized && handle == reinterpret_cast<uv_handle_t const*>(&m_timer);
+	}
+
+	std::size_t
+	size() const
+	{
+		return m_count;
+	}
+
+private:
+	static constexpr unsigned root_bits   = 8;
+	static constexpr unsigned root_size   = 1u << root_bits;
+	static constexpr unsigned level_bits  = 6;
+	static constexpr unsigned level_size  = 1u << level_bits;
+	static constexpr unsigned level_count = 4;    // above the root
+	static constexpr unsigned slot_count  = root_size + level_count * level_size;
+	static constexpr std::uint64_t max_span = (std::uint64_t{1} << (root_bits + level_count * level_bits)) - 1;
+	static constexpr std::uint64_t no_deadline = ~std::uint64_t{0};
+
+	static unsigned
+	level_shift(unsigned level)    // level is 1-based
+	{
+		return root_bits + (level - 1) * level_bits;
+	}
+
+	static unsigned
+	level_slot(unsigned level, std::uint64_t t)
+	{
+		return root_size + (level - 1) * level_size + ((t >> level_shift(level)) & (level_size - 1));
+	}
+
+	static bool
+	is_empty(timing_wheel_link const& slot)
+	{
+		return slot.m_next == &slot;
+	}
+
+	static void
+	on_timer(uv_timer_t* handle);
+
+	void
+	release(timing_wheel_entry* entry);
+
+	void
+	link(timing_wheel_entry* entry);
+
+	static void
+	unlink(timing_wheel_entry* entry);
+
+	void
+	cascade(unsigned level);
+
+	void
+	advance(std::uint64_t now);
+
+	std::uint64_t
+	next_expiry() const;
+
+	void
+	arm_timer();
+
+	uv_loop_t*                             m_loop;
+	uv_timer_t                             m_timer;
+	bool                                   m_is_initialized;
+	std::uint64_t                          m_current;    // the next millisecond to expire
+	std::uint64_t                          m_armed_for;
+	std::size_t                            m_count;
+	timing_wheel_link                      m_slots[slot_count];
+	timing_wheel_link                      m_expired;    // the slot being fired
+	timeout_entry_pool<timing_wheel_entry> m_pool;
+};
+
+#endif    // PRAKTOR_TIMING_WHEEL_H
@@ -24,6 +24,9 @@
 
 #include "udp_uv.h"
 #include "loop_uv.h"
+#include <algorithm>
+#include <cerrno>
+#include <unistd.h>
 #include <memory>
 
 udp_transceiver_uv::ptr
@@ -64,20 +67,227 @@ udp_send_bufs_req_uv::on_send(uv_udp_send_t* req, int status)
 	delete target;
 }
 
+/* udp_send_batch_req_uv */
+
+// inline slots included, a request must still fit the pool's largest class,
+// or every one would come from the heap
+static_assert(
+		sizeof(udp_send_batch_req_uv) <= request_pool::class_count * request_pool::class_granularity,
+		"udp_send_batch_req_uv outgrows the request pool");
+
+void
+udp_send_batch_req_uv::start(uv_udp_t* trans, std::size_t first)
+{
+	if (first < m_batch.size())
+	{
+		if (m_batch.size() - first > inline_slot_count)
+		{
+			m_slots = new send_slot[m_batch.size() - first];
+		}
+		for (auto i = first; i < m_batch.size(); ++i)
+		{
+			auto& dgram      = m_batch[i];
+			auto& slot       = m_slots[i - first];
+			slot.m_uv_buffer = uv_buf_init(reinterpret_cast<char*>(dgram.buffer.data()), dgram.buffer.size());
+			slot.m_index     = i;
+			slot.m_owner     = this;
+
+			auto stat = uv_udp_send(
+					&slot.m_uv_send_request, trans, &slot.m_uv_buffer, 1, dgram.destination.get_sockaddr_ptr(), on_send);
+			if (stat < 0)
+			{
+				dgram.error = map_uv_error(stat);
+			}
+			else
+			{
+				++m_pending;
+			}
+		}
+	}
+
+	if (m_pending == 0)
+	{
+		// nothing was left for libuv; still complete from the loop, as a send
+		// callback would. The handler owns the request, so a loop that closes
+		// before running it destroys the request rather than leaking it.
+		auto            self = udp_transceiver_uv::get_shared_ptr(trans);
+		auto            lp   = reinterpret_cast<loop_data*>(trans->loop->data)->get_loop_ptr();
+		std::error_code err;
+		lp->dispatch(err, [self, request{std::unique_ptr<udp_send_batch_req_uv, deleter>{this}}]() mutable {
+			request.release()->complete(self);
+		});
+	}
+}
+
+void
+udp_send_batch_req_uv::on_send(uv_udp_send_t* req, int status)
+{
+	auto slot  = reinterpret_cast<send_slot*>(req);
+	auto owner = slot->m_owner;
+
+	owner->m_batch[slot->m_index].error = map_uv_error(status);
+	if (--owner->m_pending == 0)
+	{
+		owner->complete(udp_transceiver_uv::get_shared_ptr(req->handle));
+	}
+}
+
+void
+udp_send_batch_req_uv::complete(udp_transceiver_uv::ptr const& trans)
+{
+	if (m_send_handler)
+	{
+		std::error_code err;
+		for (auto& dgram : m_batch)
+		{
+			if (dgram.error)
+			{
+				err = dgram.error;
+				break;
+			}
+		}
+		m_send_handler(trans, std::move(m_batch), err);
+	}
+	delete this;
+}
+
+/* udp_send_segmented_req_uv */
+
+static_assert(
+		sizeof(udp_send_segmented_req_uv) <= request_pool::class_count * request_pool::class_granularity,
+		"udp_send_segmented_req_uv outgrows the request pool");
+
+void
+udp_send_segmented_req_uv::start(uv_udp_t* trans, std::size_t first, std::error_code const& err)
+{
+	m_error = err;
+	auto count = segment_count();
+	if (!m_error && first < count)
+	{
+		if (count - first > inline_slot_count)
+		{
+			m_slots = new send_slot[count - first];
+		}
+		auto data = reinterpret_cast<char*>(m_buffer.data());
+		for (auto i = first; i < count; ++i)
+		{
+			auto  offset     = i * m_segment_size;
+			auto& slot       = m_slots[i - first];
+			slot.m_uv_buffer = uv_buf_init(data + offset, std::min(m_segment_size, m_buffer.size() - offset));
+			slot.m_owner     = this;
+
+			auto stat = uv_udp_send(
+					&slot.m_uv_send_request, trans, &slot.m_uv_buffer, 1, m_endpoint.get_sockaddr_ptr(), on_send);
+			if (stat < 0)
+			{
+				if (!m_error)
+				{
+					m_error = map_uv_error(stat);
+				}
+			}
+			else
+			{
+				++m_pending;
+			}
+		}
+	}
+
+	if (m_pending == 0)
+	{
+		// as for a batch, the handler owns the request until it completes it
+		auto            self = udp_transceiver_uv::get_shared_ptr(trans);
+		auto            lp   = reinterpret_cast<loop_data*>(trans->loop->data)->get_loop_ptr();
+		std::error_code dispatch_err;
+		lp->dispatch(dispatch_err, [self, request{std::unique_ptr<udp_send_segmented_req_uv, deleter>{this}}]() mutable {
+			request.release()->complete(self);
+		});
+	}
+}
+
+void
+udp_send_segmented_req_uv::on_send(uv_udp_send_t* req, int status)
+{
+	auto slot  = reinterpret_cast<send_slot*>(req);
+	auto owner = slot->m_owner;
+
+	if (status < 0 && !owner->m_error)
+	{
+		owner->m_error = map_uv_error(status);
+	}
+	if (--owner->m_pending == 0)
+	{
+		owner->complete(udp_transceiver_uv::get_shared_ptr(req->handle));
+	}
+}
+
+void
+udp_send_segmented_req_uv::complete(udp_transceiver_uv::ptr const& trans)
+{
+	if (m_send_handler)
+	{
+		m_send_handler(trans, std::move(m_buffer), m_endpoint, m_error);
+	}
+	delete this;
+}
+
 std::shared_ptr<praktor::loop>
 udp_transceiver_uv::loop()
 {
 	return reinterpret_cast<loop_data*>(reinterpret_cast<uv_handle_t*>(&m_udp_handle)->loop->data)->get_loop_ptr();
 }
 
+namespace
+{
+
+// libuv gives each datagram of a recvmmsg batch its own 64 KiB slice of
+// the receive buffer, and reads at most 20 per call
+constexpr std::size_t recvmmsg_slice_size = 64 * 1024;
+constexpr std::size_t recvmmsg_max_batch  = 20;
+
+// the kernel caps a single sendmmsg call at UIO_MAXIOV messages
+constexpr std::size_t sendmmsg_max_batch = 1024;
+
+// UDP_SEGMENT sends carry at most 64 segments (UDP_MAX_SEGMENTS), within
+// the 64 KiB limit of a single IPv4 datagram
+constexpr std::size_t gso_max_segments = 64;
+constexpr std::size_t gso_max_payload  = 65507;
+
+// a GRO read returns at most 64 KiB of coalesced datagrams; reading is
+// bounded per wakeup so one busy socket cannot starve the loop
+constexpr std::size_t gro_buffer_size        = 64 * 1024;
+constexpr std::size_t gro_max_reads_per_poll = 16;
+
+}    // namespace
+
 void
-udp_transceiver_uv::init(uv_loop_t* lp, ptr const& self, std::error_code& err)
+udp_transceiver_uv::init(uv_loop_t* lp, ptr const& self, options const& opts, std::error_code& err)
 {
 	err.clear();
-	auto stat = uv_udp_init(lp, get_udp_handle());
+	int stat{0};
+#if defined(PRAKTOR_UDP_RECVMMSG)
+	if (opts.receive_batch() > 1)
+	{
+		stat = uv_udp_init_ex(lp, get_udp_handle(), AF_UNSPEC | UV_UDP_RECVMMSG);
+	}
+	else
+	{
+		stat = uv_udp_init(lp, get_udp_handle());
+	}
+#else
+	stat = uv_udp_init(lp, get_udp_handle());
+#endif
 	uv_handle_set_data(get_handle(), get_handle_data());
 	set_self_ptr(self);
 	UV_ERROR_CHECK(stat, err, exit);
+	m_gro = opts.gro();
+#if defined(PRAKTOR_UDP_RECVMMSG)
+	if (uv_udp_using_recvmmsg(get_udp_handle()))
+	{
+		m_batch_buffer_size = std::min(opts.receive_batch(), recvmmsg_max_batch) * recvmmsg_slice_size;
+		m_batch_buffer.reset(new util::byte_type[m_batch_buffer_size]);
+		m_batch.reserve(recvmmsg_max_batch);
+	}
+#endif
 exit:
 	return;
 }
@@ -92,52 +302,141 @@ udp_transceiver_uv::on_receive(
 {
 	ptr transceiver_ptr = util::dynamic_pointer_cast<udp_transceiver_uv>(get_shared_ptr(udp_handle));
 	assert(transceiver_ptr);
-	if (nread < 0)
+
+#if defined(PRAKTOR_UDP_RECVMMSG)
+	if (flags & UV_UDP_MMSG_FREE)
+	{
+		// end of a recvmmsg batch; the buffer is ours to keep
+		transceiver_ptr->flush_batch(transceiver_ptr);
+		return;
+	}
+#endif
+
+	bool                  from_batch_buffer = transceiver_ptr->is_batch_buffer(buf->base);
+	bool                  in_batch{false};
+	praktor::ip::endpoint source;
+#if defined(PRAKTOR_UDP_RECVMMSG)
+	in_batch = (flags & UV_UDP_MMSG_CHUNK) != 0;
+#endif
+	if (addr)
 	{
-		if (buf->base)
+		source = praktor::ip::endpoint{*reinterpret_cast<const sockaddr_storage*>(addr)};
+	}
+
+	if (nread <= 0)
+	{
+		if (buf->base && !from_batch_buffer)
 		{
-			delete[] reinterpret_cast<util::byte_type*>(buf->base);
+			receive_slab::release(reinterpret_cast<util::byte_type*>(buf->base));
+		}
+		if (nread < 0)
+		{
+			transceiver_ptr->deliver_error(transceiver_ptr, source, map_uv_error(nread));
+		}
+		else if (addr)
+		{
+			transceiver_ptr->deliver(transceiver_ptr, util::const_buffer{}, source, std::error_code{});
+			if (!in_batch)
+			{
+				transceiver_ptr->flush_batch(transceiver_ptr);
+			}
 		}
-		transceiver_ptr->m_receive_handler(
-				transceiver_ptr,
-				util::const_buffer{},
-				praktor::ip::endpoint{*reinterpret_cast<const sockaddr_storage*>(addr)},
-				map_uv_error(nread));
 	}
-	else if (nread == 0)
+	else
 	{
-		if (buf->base)
+		std::error_code    err;
+		util::const_buffer data;
+		if (flags & UV_UDP_PARTIAL)
 		{
-			delete[] reinterpret_cast<util::byte_type*>(buf->base);
+			err = make_error_code(std::errc::message_size);
 		}
-		if (addr)
+		if (from_batch_buffer)
 		{
-			transceiver_ptr->m_receive_handler(
-					transceiver_ptr,
-					util::const_buffer{},
-					praktor::ip::endpoint{*reinterpret_cast<const sockaddr_storage*>(addr)},
-					std::error_code{});
+			data = transceiver_ptr->copy_to_slot(buf->base, static_cast<std::size_t>(nread), err);
+		}
+		else
+		{
+			data = receive_slab::make_buffer(
+					reinterpret_cast<util::byte_type*>(buf->base), static_cast<util::size_type>(nread));
+		}
+		transceiver_ptr->deliver(transceiver_ptr, std::move(data), source, err);
+		if (!in_batch)
+		{
+			transceiver_ptr->flush_batch(transceiver_ptr);
 		}
 	}
-	else if (nread > 0)
+}
+
+void
+udp_transceiver_uv::on_allocate(uv_handle_t* handle, size_t, uv_buf_t* buf)
+{
+	auto self = get_raw_ptr(handle);
+	if (self->m_batch_buffer)
+	{
+		buf->base = reinterpret_cast<char*>(self->m_batch_buffer.get());
+		buf->len  = self->m_batch_buffer_size;
+	}
+	else
+	{
+		// suggested_size is 64 KiB; no datagram we accept can use more than a slot
+		buf->base = reinterpret_cast<char*>(self->m_receive_slab->acquire());
+		buf->len  = self->m_receive_slab->slot_size();
+	}
+}
+
+// A recvmmsg batch lands in one shared buffer with a 64 KiB slice per
+// datagram; each datagram is copied into its own slot so the batch buffer
+// can be reused by the next read.
+
+util::const_buffer
+udp_transceiver_uv::copy_to_slot(const char* data, std::size_t size, std::error_code& err)
+{
+	if (size > m_receive_slab->slot_size())
 	{
-		transceiver_ptr->m_receive_handler(
-				transceiver_ptr,
-				util::const_buffer{reinterpret_cast<util::byte_type*>(buf->base),
-								   static_cast<util::size_type>(nread),
-								   std::default_delete<util::byte_type[]>{}},
-				praktor::ip::endpoint{*reinterpret_cast<const sockaddr_storage*>(addr)},
-				std::error_code{});
+		size = m_receive_slab->slot_size();
+		err  = make_error_code(std::errc::message_size);
 	}
+	auto slot = m_receive_slab->acquire();
+	::memcpy(slot, data, size);
+	return receive_slab::make_buffer(slot, size);
 }
 
 void
-udp_transceiver_uv::on_allocate(uv_handle_t* handle, size_t suggested_size, uv_buf_t* buf)
+udp_transceiver_uv::deliver(ptr const& self, util::const_buffer&& buf, endpoint const& source, std::error_code const& err)
 {
-	// static buffer::memory_broker::ptr broker = buffer::default_broker::get();
-	// buf->base = reinterpret_cast<char*>(std::allocator<util::byte_type>{}.allocate(suggested_size));
-	buf->base = reinterpret_cast<char*>(new util::byte_type[suggested_size]);
-	buf->len  = suggested_size;
+	if (m_receive_handler)
+	{
+		m_receive_handler(self, std::move(buf), source, err);
+	}
+	else
+	{
+		m_batch.emplace_back(praktor::received_datagram{std::move(buf), source, err});
+	}
+}
+
+void
+udp_transceiver_uv::deliver_error(ptr const& self, endpoint const& source, std::error_code const& err)
+{
+	if (m_receive_handler)
+	{
+		m_receive_handler(self, util::const_buffer{}, source, err);
+	}
+	else if (m_receive_batch_handler)
+	{
+		flush_batch(self);
+		m_receive_batch_handler(self, m_batch, err);
+		m_batch.clear();
+	}
+}
+
+void
+udp_transceiver_uv::flush_batch(ptr const& self)
+{
+	if (m_receive_batch_handler && !m_batch.empty())
+	{
+		m_receive_batch_handler(self, m_batch, std::error_code{});
+	}
+	m_batch.clear();
 }
 
 bool
@@ -147,6 +446,7 @@ udp_transceiver_uv::really_close(transceiver::close_handler&& handler)
 	if (!uv_is_closing(get_handle()))
 	{
 		m_close_handler = std::move(handler);
+		close_gro_poll();
 		uv_close(get_handle(), udp_transceiver_uv::on_close);
 	}
 	else
@@ -164,23 +464,214 @@ udp_transceiver_uv::is_closing()
 
 void
 udp_transceiver_uv::really_start_receive(std::error_code& err, transceiver::receive_handler&& handler)
+{
+	start_receiving(err);
+	if (!err)
+	{
+		m_receive_handler       = std::move(handler);
+		m_receive_batch_handler = nullptr;
+	}
+}
+
+void
+udp_transceiver_uv::really_start_receive(std::error_code& err, transceiver::receive_batch_handler&& handler)
+{
+	start_receiving(err);
+	if (!err)
+	{
+		m_receive_batch_handler = std::move(handler);
+		m_receive_handler       = nullptr;
+	}
+}
+
+void
+udp_transceiver_uv::start_receiving(std::error_code& err)
 {
 	err.clear();
-	auto stat = uv_udp_recv_start(get_udp_handle(), on_allocate, on_receive);
-	if (stat < 0)
+	int stat{0};
+	if (!m_receive_slab)
+	{
+		m_receive_slab = std::make_shared<receive_slab>(m_mtu);
+	}
+	if (m_gro && !m_gro_poll && !enable_gro())
 	{
-		err = map_uv_error(stat);
+		m_gro = false;
+	}
+	if (m_gro_poll)
+	{
+		stat = uv_poll_start(&m_gro_poll->m_poll, UV_READABLE, on_gro_readable);
 	}
 	else
 	{
-		m_receive_handler = std::move(handler);
+		stat = uv_udp_recv_start(get_udp_handle(), on_allocate, on_receive);
 	}
+	UV_ERROR_CHECK(stat, err, exit);
+exit:
+	return;
 }
 
 void
 udp_transceiver_uv::stop_receive()
 {
-	uv_udp_recv_stop(get_udp_handle());
+	if (m_gro_poll)
+	{
+		uv_poll_stop(&m_gro_poll->m_poll);
+	}
+	else
+	{
+		uv_udp_recv_stop(get_udp_handle());
+	}
+	m_batch.clear();
+}
+
+// Turns on UDP_GRO and sets up the reader; false leaves the transceiver
+// receiving through libuv as usual.
+bool
+udp_transceiver_uv::enable_gro()
+{
+#if defined(PRAKTOR_UDP_GRO)
+	uv_os_fd_t   fd;
+	uv_os_sock_t dup_fd{-1};
+	int          on{1};
+	int          off{0};
+
+	if (uv_fileno(get_handle(), &fd) < 0 || ::setsockopt(fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) < 0)
+	{
+		return false;
+	}
+
+	// the duplicate shares the socket, and its non-blocking mode, but gives
+	// the poll handle a descriptor libuv is not already watching
+	dup_fd = ::dup(fd);
+	if (dup_fd >= 0)
+	{
+		auto reader  = new udp_gro_poll_uv;
+		reader->m_fd = dup_fd;
+		if (uv_poll_init_socket(get_handle()->loop, &reader->m_poll, dup_fd) == 0)
+		{
+			reader->m_owner = util::dynamic_pointer_cast<udp_transceiver_uv>(m_data.m_self_ptr);
+			m_gro_poll      = reader;
+			m_gro_buffer.reset(new util::byte_type[gro_buffer_size]);
+			return true;
+		}
+		delete reader;
+		::close(dup_fd);
+	}
+	::setsockopt(fd, SOL_UDP, UDP_GRO, &off, sizeof(off));
+#endif
+	return false;
+}
+
+void
+udp_transceiver_uv::close_gro_poll()
+{
+	if (m_gro_poll && !uv_is_closing(reinterpret_cast<uv_handle_t*>(&m_gro_poll->m_poll)))
+	{
+		uv_close(reinterpret_cast<uv_handle_t*>(&m_gro_poll->m_poll), on_gro_poll_close);
+	}
+}
+
+void
+udp_transceiver_uv::on_gro_poll_close(uv_handle_t* handle)
+{
+	// the descriptor may only be closed once the poll handle is
+	auto reader = reinterpret_cast<udp_gro_poll_uv*>(handle);
+	::close(reader->m_fd);
+	reader->m_owner->m_gro_poll = nullptr;
+	delete reader;
+}
+
+void
+udp_transceiver_uv::on_gro_readable(uv_poll_t* handle, int status, int events)
+{
+	auto self = reinterpret_cast<udp_gro_poll_uv*>(handle)->m_owner;
+	if (status < 0)
+	{
+		self->deliver_error(self, endpoint{}, map_uv_error(status));
+	}
+	else if (events & UV_READABLE)
+	{
+		self->read_gro(self);
+	}
+}
+
+// Each read returns either one datagram or a run of equal-sized datagrams
+// (the last may be shorter) coalesced by the kernel, with the segment size
+// in a UDP_GRO control message. The run is split into slab slots, as a
+// recvmmsg batch is, and delivered as one batch.
+void
+udp_transceiver_uv::read_gro(ptr const& self)
+{
+#if defined(PRAKTOR_UDP_GRO)
+	auto poll = reinterpret_cast<uv_handle_t*>(&m_gro_poll->m_poll);
+	for (std::size_t reads = 0; reads < gro_max_reads_per_poll && uv_is_active(poll); ++reads)
+	{
+		sockaddr_storage addr;
+		iovec            iov;
+		iov.iov_base = m_gro_buffer.get();
+		iov.iov_len  = gro_buffer_size;
+
+		alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+		msghdr                msg{};
+		msg.msg_name       = &addr;
+		msg.msg_namelen    = sizeof(addr);
+		msg.msg_iov        = &iov;
+		msg.msg_iovlen     = 1;
+		msg.msg_control    = control;
+		msg.msg_controllen = sizeof(control);
+
+		ssize_t n;
+		do
+		{
+			n = ::recvmsg(m_gro_poll->m_fd, &msg, 0);
+		}
+		while (n < 0 && errno == EINTR);
+
+		if (n < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+			{
+				deliver_error(self, endpoint{}, map_uv_error(-errno));
+			}
+			break;
+		}
+
+		auto size         = static_cast<std::size_t>(n);
+		auto segment_size = size;
+		for (auto cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO)
+			{
+				int gso_size;
+				::memcpy(&gso_size, CMSG_DATA(cmsg), sizeof(gso_size));
+				if (gso_size > 0)
+				{
+					segment_size = static_cast<std::size_t>(gso_size);
+				}
+			}
+		}
+
+		praktor::ip::endpoint source{addr};
+		std::error_code       truncated;
+		if (msg.msg_flags & MSG_TRUNC)
+		{
+			truncated = make_error_code(std::errc::message_size);
+		}
+
+		if (size == 0)
+		{
+			deliver(self, util::const_buffer{}, source, truncated);
+		}
+		for (std::size_t offset = 0; offset < size && uv_is_active(poll); offset += segment_size)
+		{
+			std::error_code err{truncated};
+			auto            segment = reinterpret_cast<const char*>(m_gro_buffer.get()) + offset;
+			auto            data    = copy_to_slot(segment, std::min(segment_size, size - offset), err);
+			deliver(self, std::move(data), source, err);
+		}
+		flush_batch(self);
+	}
+#endif
 }
 
 void
@@ -191,7 +682,7 @@ udp_transceiver_uv::really_send(
 		transceiver::send_buffer_handler&& handler)
 {
 	err.clear();
-	auto request = new udp_send_buf_req_uv{std::move(buf), dest, std::move(handler)};
+	auto request = new (request_pool::of(get_udp_handle()->loop)) udp_send_buf_req_uv{std::move(buf), dest, std::move(handler)};
 	auto status  = request->start(get_udp_handle());
 	if (status < 0)
 	{
@@ -207,10 +698,253 @@ udp_transceiver_uv::really_send(
 		transceiver::send_buffers_handler&& handler)
 {
 	err.clear();
-	auto request = new udp_send_bufs_req_uv{std::move(bufs), dest, std::move(handler)};
+	auto request = new (request_pool::of(get_udp_handle()->loop)) udp_send_bufs_req_uv{std::move(bufs), dest, std::move(handler)};
 	auto status  = request->start(get_udp_handle());
 	if (status < 0)
 	{
 		err = map_uv_error(status);
 	}
 }
+
+void
+udp_transceiver_uv::really_emit_batch(
+		std::vector<praktor::outgoing_datagram>&& batch,
+		std::error_code&                          err,
+		transceiver::send_batch_handler&&         handler)
+{
+	err.clear();
+	for (auto& dgram : batch)
+	{
+		dgram.error.clear();
+	}
+	auto sent    = send_immediate(batch);
+	auto request = new (request_pool::of(get_udp_handle()->loop)) udp_send_batch_req_uv{std::move(batch), std::move(handler)};
+	request->start(get_udp_handle(), sent);
+}
+
+// Writes messages [first, last) with sendmmsg for as long as the socket
+// takes them without blocking, and returns the index of the first message
+// left for libuv to queue. describe(i, iov, addr) fills in message i;
+// fail(i, err) records a message the kernel rejected.
+template<class Describe, class Fail>
+std::size_t
+udp_transceiver_uv::send_messages(std::size_t first, std::size_t last, Describe&& describe, Fail&& fail)
+{
+	std::size_t next{first};
+#if defined(PRAKTOR_UDP_SENDMMSG)
+	uv_os_fd_t fd;
+
+	// sends already queued in libuv must go out first to keep datagrams in
+	// order, and a closing handle has no descriptor
+	if (uv_udp_get_send_queue_count(get_udp_handle()) > 0 || uv_fileno(get_handle(), &fd) < 0)
+	{
+		return next;
+	}
+
+	while (next < last)
+	{
+		auto count = std::min(last - next, sendmmsg_max_batch);
+		if (m_send_msgs.size() < count)
+		{
+			m_send_msgs.resize(count);
+			m_send_iovs.resize(count);
+			m_send_addrs.resize(count);
+		}
+
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			describe(next + i, m_send_iovs[i], m_send_addrs[i]);
+
+			auto& hdr       = m_send_msgs[i].msg_hdr;
+			hdr             = msghdr{};
+			hdr.msg_name    = &m_send_addrs[i];
+			hdr.msg_namelen = m_send_addrs[i].ss_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+			hdr.msg_iov     = &m_send_iovs[i];
+			hdr.msg_iovlen  = 1;
+		}
+
+		int n;
+		do
+		{
+			n = ::sendmmsg(fd, m_send_msgs.data(), count, 0);
+		}
+		while (n < 0 && errno == EINTR);
+
+		if (n < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)
+			{
+				// the socket is full; libuv queues the rest and sends when writable
+				break;
+			}
+
+			// sendmmsg fails on the first message it could not send; record it
+			// and carry on with the next
+			fail(next, map_uv_error(-errno));
+			++next;
+		}
+		else
+		{
+			next += n;
+		}
+	}
+#endif
+	return next;
+}
+
+std::size_t
+udp_transceiver_uv::send_immediate(std::vector<praktor::outgoing_datagram>& batch)
+{
+	return send_messages(
+			0,
+			batch.size(),
+			[&](std::size_t i, iovec& iov, sockaddr_storage& addr) {
+				batch[i].destination.to_sockaddr(addr);
+				iov.iov_base = batch[i].buffer.data();
+				iov.iov_len  = batch[i].buffer.size();
+			},
+			[&](std::size_t i, std::error_code const& err) { batch[i].error = err; });
+}
+
+void
+udp_transceiver_uv::really_send_segmented(
+		util::mutable_buffer&&             buf,
+		std::size_t                        segment_size,
+		endpoint const&                    dest,
+		std::error_code&                   err,
+		transceiver::send_buffer_handler&& handler)
+{
+	err.clear();
+	std::error_code            send_err;
+	std::size_t                next{0};
+	udp_send_segmented_req_uv* request{nullptr};
+
+	if (segment_size == 0)
+	{
+		err = make_error_code(std::errc::invalid_argument);
+		goto exit;
+	}
+
+	// whole runs go out together, so only the very last segment can be short
+	next = (send_gso(buf, segment_size, dest, send_err) + segment_size - 1) / segment_size;
+	if (!send_err)
+	{
+		sockaddr_storage dest_addr;
+		dest.to_sockaddr(dest_addr);
+		auto data  = reinterpret_cast<char*>(buf.data());
+		auto size  = buf.size();
+		auto count = (size + segment_size - 1) / segment_size;
+		next       = send_messages(
+				next,
+				count,
+				[&](std::size_t i, iovec& iov, sockaddr_storage& addr) {
+					addr         = dest_addr;
+					iov.iov_base = data + i * segment_size;
+					iov.iov_len  = std::min(segment_size, size - i * segment_size);
+				},
+				[&](std::size_t, std::error_code const& err) {
+					if (!send_err)
+					{
+						send_err = err;
+					}
+				});
+	}
+
+	request = new (request_pool::of(get_udp_handle()->loop))
+			udp_send_segmented_req_uv{std::move(buf), segment_size, dest, std::move(handler)};
+	request->start(get_udp_handle(), next, send_err);
+
+exit:
+	return;
+}
+
+// Sends whole runs of segments with UDP_SEGMENT, up to the kernel's limits
+// of 64 segments and 64 KiB per send, and returns the number of bytes sent.
+// Returns early, leaving the rest to the caller, if the socket is full or
+// the kernel does not offer segmentation offload.
+std::size_t
+udp_transceiver_uv::send_gso(
+		util::mutable_buffer const& buf,
+		std::size_t                 segment_size,
+		endpoint const&             dest,
+		std::error_code&            err)
+{
+	std::size_t offset{0};
+#if defined(PRAKTOR_UDP_GSO)
+	uv_os_fd_t       fd;
+	sockaddr_storage addr;
+	auto             per_send = std::min(gso_max_segments, gso_max_payload / segment_size) * segment_size;
+
+	// a single segment gains nothing from offload
+	if (m_gso == gso_state::unavailable || per_send == 0 || buf.size() <= segment_size
+		|| uv_udp_get_send_queue_count(get_udp_handle()) > 0 || uv_fileno(get_handle(), &fd) < 0)
+	{
+		return offset;
+	}
+	if (m_gso == gso_state::unknown)
+	{
+		// kernels without UDP_SEGMENT ignore the control message and would
+		// send the whole run as one datagram, so ask first
+		int       value{0};
+		socklen_t length{sizeof(value)};
+		m_gso = ::getsockopt(fd, SOL_UDP, UDP_SEGMENT, &value, &length) == 0 ? gso_state::available
+																				: gso_state::unavailable;
+		if (m_gso == gso_state::unavailable)
+		{
+			return offset;
+		}
+	}
+	dest.to_sockaddr(addr);
+
+	while (offset < buf.size())
+	{
+		iovec iov;
+		iov.iov_base = const_cast<util::byte_type*>(buf.data()) + offset;
+		iov.iov_len  = std::min(per_send, buf.size() - offset);
+
+		alignas(cmsghdr) char control[CMSG_SPACE(sizeof(std::uint16_t))] = {};
+		msghdr                msg{};
+		msg.msg_name       = &addr;
+		msg.msg_namelen    = addr.ss_family == AF_INET6 ? sizeof(sockaddr_in6) : sizeof(sockaddr_in);
+		msg.msg_iov        = &iov;
+		msg.msg_iovlen     = 1;
+		msg.msg_control    = control;
+		msg.msg_controllen = sizeof(control);
+
+		auto cmsg        = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_UDP;
+		cmsg->cmsg_type  = UDP_SEGMENT;
+		cmsg->cmsg_len   = CMSG_LEN(sizeof(std::uint16_t));
+		auto gso_size    = static_cast<std::uint16_t>(segment_size);
+		::memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+
+		ssize_t n;
+		do
+		{
+			n = ::sendmsg(fd, &msg, 0);
+		}
+		while (n < 0 && errno == EINTR);
+
+		if (n < 0)
+		{
+			if (errno == EIO || errno == EOPNOTSUPP)
+			{
+				// the device cannot offload; stop trying
+				m_gso = gso_state::unavailable;
+			}
+			else if (errno == EINVAL)
+			{
+				// e.g. segments larger than the path allows; sending them one by
+				// one reports the real error per segment
+			}
+			else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != ENOBUFS)
+			{
+				err = map_uv_error(-errno);
+			}
+			break;
+		}
+		offset += iov.iov_len;
+	}
+#endif
+	return offset;
+}
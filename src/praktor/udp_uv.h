@@ -25,12 +25,37 @@
 #ifndef PRAKTOR_UDP_UV_H
 #define PRAKTOR_UDP_UV_H
 
+#include "receive_slab.h"
+#include "request_pool.h"
 #include "uv_error.h"
 #include <boost/endian/conversion.hpp>
 #include <praktor/endpoint.h>
 #include <praktor/options.h>
 #include <praktor/transceiver.h>
+#include <memory>
 #include <uv.h>
+#include <vector>
+
+#if defined(__linux__)
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#define PRAKTOR_UDP_SENDMMSG 1
+#endif
+
+// segmentation offload: UDP_SEGMENT (GSO) from Linux 4.18, UDP_GRO from 5.0;
+// older kernels reject them at run time and the transceiver falls back
+#if defined(UDP_SEGMENT)
+#define PRAKTOR_UDP_GSO 1
+#endif
+#if defined(UDP_GRO)
+#define PRAKTOR_UDP_GRO 1
+#endif
+
+// UV_UDP_RECVMMSG arrived in 1.37; UV_UDP_MMSG_FREE, which marks the end of
+// a batch, in 1.40.
+#if UV_VERSION_HEX >= 0x012800
+#define PRAKTOR_UDP_RECVMMSG 1
+#endif
 
 using praktor::ip::endpoint;
 using util::mutable_buffer;
@@ -39,7 +64,7 @@ using praktor::options;
 
 class udp_transceiver_uv;
 
-class udp_send_buf_req_uv
+class udp_send_buf_req_uv : public pooled_request
 {
 public:
 
@@ -75,13 +100,16 @@ private:
 };
 
 
-class udp_send_bufs_req_uv
+class udp_send_bufs_req_uv : public pooled_request
 {
 public:
+	// sends of up to this many buffers need no separate uv_buf_t array
+	static constexpr std::size_t inline_buffer_count = 8;
+
 	udp_send_bufs_req_uv(std::deque<mutable_buffer>&& bufs, endpoint const& ep, praktor::transceiver::send_buffers_handler handler)
 		: m_send_handler{std::move(handler)},
 		  m_buffers{std::move(bufs)},
-		  m_uv_buffers{new uv_buf_t[m_buffers.size()]}
+		  m_uv_buffers{m_buffers.size() <= inline_buffer_count ? m_inline_buffers : new uv_buf_t[m_buffers.size()]}
 	{
 		assert(reinterpret_cast<uv_udp_send_t*>(this) == &m_uv_send_request);
 
@@ -104,7 +132,7 @@ public:
 private:
 	~udp_send_bufs_req_uv()
 	{
-		if (m_uv_buffers)
+		if (m_uv_buffers != m_inline_buffers)
 		{
 			delete[] m_uv_buffers;
 		}
@@ -121,6 +149,160 @@ private:
 	uv_buf_t*                         m_uv_buffers;
 	endpoint                          m_endpoint;
 	transceiver::send_buffers_handler m_send_handler;
+	uv_buf_t                          m_inline_buffers[inline_buffer_count];
+};
+
+/** \brief Tracks one emit_batch call until every datagram has completed.
+ *
+ * Datagrams the socket accepted immediately are already done when the
+ * request is created; the rest are queued on libuv with one send slot
+ * each. The handler runs, and the request deletes itself, once the last
+ * slot completes.
+ */
+class udp_send_batch_req_uv : public pooled_request
+{
+public:
+	// up to this many datagrams left for libuv need no separate slot array
+	static constexpr std::size_t inline_slot_count = 2;
+
+	udp_send_batch_req_uv(std::vector<praktor::outgoing_datagram>&& batch, transceiver::send_batch_handler&& handler)
+		: m_batch{std::move(batch)}, m_send_handler{std::move(handler)}, m_slots{m_inline_slots}, m_pending{0}
+	{}
+
+	/** \brief Queues the datagrams from first onward; completion is always deferred.
+	 */
+	void
+	start(uv_udp_t* trans, std::size_t first);
+
+private:
+	~udp_send_batch_req_uv()
+	{
+		if (m_slots != m_inline_slots)
+		{
+			delete[] m_slots;
+		}
+	}
+
+	struct send_slot
+	{
+		uv_udp_send_t          m_uv_send_request;
+		uv_buf_t               m_uv_buffer;
+		std::size_t            m_index;
+		udp_send_batch_req_uv* m_owner;
+	};
+
+	// lets a deferred completion own the request
+	struct deleter
+	{
+		void
+		operator()(udp_send_batch_req_uv* request) const
+		{
+			delete request;
+		}
+	};
+
+	static void
+	on_send(uv_udp_send_t* req, int status);
+
+	void
+	complete(util::shared_ptr<udp_transceiver_uv> const& trans);
+
+	std::vector<praktor::outgoing_datagram> m_batch;
+	transceiver::send_batch_handler         m_send_handler;
+	send_slot*                              m_slots;
+	std::size_t                             m_pending;
+	send_slot                               m_inline_slots[inline_slot_count];
+};
+
+/** \brief Tracks one emit_segmented call until every segment has been sent.
+ *
+ * Segments before the start index were written directly by the
+ * transceiver; the rest are queued on libuv as datagrams of their own.
+ */
+class udp_send_segmented_req_uv : public pooled_request
+{
+public:
+	// up to this many segments left for libuv need no separate slot array
+	static constexpr std::size_t inline_slot_count = 2;
+
+	udp_send_segmented_req_uv(
+			mutable_buffer&&                   buf,
+			std::size_t                        segment_size,
+			endpoint const&                    ep,
+			transceiver::send_buffer_handler&& handler)
+		: m_buffer{std::move(buf)},
+		  m_segment_size{segment_size},
+		  m_endpoint{ep},
+		  m_send_handler{std::move(handler)},
+		  m_slots{m_inline_slots},
+		  m_pending{0}
+	{}
+
+	std::size_t
+	segment_count() const
+	{
+		return (m_buffer.size() + m_segment_size - 1) / m_segment_size;
+	}
+
+	/** \brief Queues segments from first onward, unless err is set; completion is always deferred.
+	 */
+	void
+	start(uv_udp_t* trans, std::size_t first, std::error_code const& err);
+
+private:
+	~udp_send_segmented_req_uv()
+	{
+		if (m_slots != m_inline_slots)
+		{
+			delete[] m_slots;
+		}
+	}
+
+	struct send_slot
+	{
+		uv_udp_send_t              m_uv_send_request;
+		uv_buf_t                   m_uv_buffer;
+		udp_send_segmented_req_uv* m_owner;
+	};
+
+	// lets a deferred completion own the request
+	struct deleter
+	{
+		void
+		operator()(udp_send_segmented_req_uv* request) const
+		{
+			delete request;
+		}
+	};
+
+	static void
+	on_send(uv_udp_send_t* req, int status);
+
+	void
+	complete(util::shared_ptr<udp_transceiver_uv> const& trans);
+
+	mutable_buffer                   m_buffer;
+	std::size_t                      m_segment_size;
+	endpoint                         m_endpoint;
+	transceiver::send_buffer_handler m_send_handler;
+	send_slot*                       m_slots;
+	std::size_t                      m_pending;
+	std::error_code                  m_error;
+	send_slot                        m_inline_slots[inline_slot_count];
+};
+
+/** \brief Reader for a transceiver receiving with UDP_GRO.
+ *
+ * libuv does not pass control messages up, and the segment size of a
+ * coalesced read arrives in one, so a GRO transceiver reads for itself
+ * through a poll handle on a duplicate of its socket. The reader holds a
+ * reference to the transceiver until the poll handle has closed.
+ */
+struct udp_gro_poll_uv
+{
+	uv_poll_t                            m_poll;
+	uv_os_sock_t                         m_fd;
+	util::shared_ptr<udp_transceiver_uv> m_owner;
 };
 
 class udp_transceiver_uv : public transceiver
@@ -128,8 +310,16 @@ class udp_transceiver_uv : public transceiver
 public:
 	using ptr = util::shared_ptr<udp_transceiver_uv>;
 
+	udp_transceiver_uv()
+		: m_mtu{payload_size_limit},
+		  m_batch_buffer_size{0},
+		  m_gro{false},
+		  m_gro_poll{nullptr},
+		  m_gso{gso_state::unknown}
+	{}
+
 	void
-	init(uv_loop_t* lp, ptr const& self, std::error_code& err);
+	init(uv_loop_t* lp, ptr const& self, options const& opts, std::error_code& err);
 
 	static ptr
 	get_shared_ptr(uv_handle_t* handle)
@@ -159,6 +349,7 @@ public:
 	bind(options const& opts, std::error_code& err)
 	{
 		err.clear();
+		m_mtu     = opts.mtu() > 0 ? opts.mtu() : payload_size_limit;
 		auto stat = uv_udp_bind(&m_udp_handle, opts.endpoint().get_sockaddr_ptr(), 0);
 		if (stat < 0)
 		{
@@ -174,9 +365,13 @@ public:
 		assert(uv_handle_get_type(handle) == uv_handle_type::UV_UDP);
 		auto trans = get_raw_ptr(handle);
 		assert(trans->get_handle() == handle);
+		trans->close_gro_poll();
 		trans->clear();
 	}
 
+	static void
+	on_gro_poll_close(uv_handle_t* handle);
+
 protected:
 	void
 	clear_handler()
@@ -186,7 +381,8 @@ protected:
 			m_close_handler(util::dynamic_pointer_cast<udp_transceiver_uv>(m_data.m_self_ptr));
 			m_close_handler = nullptr;
 		}
-		m_receive_handler = nullptr;
+		m_receive_handler       = nullptr;
+		m_receive_batch_handler = nullptr;
 	}
 
 	static void
@@ -198,9 +394,47 @@ protected:
 	virtual void
 	really_start_receive(std::error_code& err, transceiver::receive_handler&& handler) override;
 
+	virtual void
+	really_start_receive(std::error_code& err, transceiver::receive_batch_handler&& handler) override;
+
+	void
+	start_receiving(std::error_code& err);
+
+	bool
+	enable_gro();
+
+	void
+	close_gro_poll();
+
+	static void
+	on_gro_readable(uv_poll_t* handle, int status, int events);
+
+	void
+	read_gro(ptr const& self);
+
 	virtual void
 	stop_receive() override;
 
+	bool
+	is_batch_buffer(const char* base) const
+	{
+		// recvmmsg hands each datagram a slice from inside the batch buffer
+		auto begin = reinterpret_cast<const char*>(m_batch_buffer.get());
+		return m_batch_buffer && base >= begin && base < begin + m_batch_buffer_size;
+	}
+
+	util::const_buffer
+	copy_to_slot(const char* data, std::size_t size, std::error_code& err);
+
+	void
+	deliver(ptr const& self, util::const_buffer&& buf, endpoint const& source, std::error_code const& err);
+
+	void
+	deliver_error(ptr const& self, endpoint const& source, std::error_code const& err);
+
+	void
+	flush_batch(ptr const& self);
+
 	virtual std::shared_ptr<praktor::loop>
 	loop() override;
 
@@ -218,6 +452,37 @@ protected:
 			std::error_code&             err,
 			send_buffers_handler&&       handler) override;
 
+	virtual void
+	really_emit_batch(
+			std::vector<praktor::outgoing_datagram>&& batch,
+			std::error_code&                          err,
+			send_batch_handler&&                      handler) override;
+
+	std::size_t
+	send_immediate(std::vector<praktor::outgoing_datagram>& batch);
+
+	virtual void
+	really_send_segmented(
+			mutable_buffer&&      buf,
+			std::size_t           segment_size,
+			endpoint const&       dest,
+			std::error_code&      err,
+			send_buffer_handler&& handler) override;
+
+	std::size_t
+	send_gso(mutable_buffer const& buf, std::size_t segment_size, endpoint const& dest, std::error_code& err);
+
+	enum class gso_state
+	{
+		unknown,
+		available,
+		unavailable
+	};
+
+	template<class Describe, class Fail>
+	std::size_t
+	send_messages(std::size_t first, std::size_t last, Describe&& describe, Fail&& fail);
+
 	virtual bool
 	really_close(close_handler&& handler) override;
 
@@ -279,6 +544,27 @@ protected:
 	transceiver::close_handler   m_close_handler;
 	handle_data                  m_data;
 	uv_udp_t                     m_udp_handle;
+	std::size_t                  m_mtu;
+	receive_slab::ptr            m_receive_slab;
+
+	// batch receive; m_batch_buffer is set only when libuv reads with recvmmsg
+	transceiver::receive_batch_handler      m_receive_batch_handler;
+	std::vector<praktor::received_datagram> m_batch;
+	std::unique_ptr<util::byte_type[]>      m_batch_buffer;
+	std::size_t                             m_batch_buffer_size;
+
+#if defined(PRAKTOR_UDP_SENDMMSG)
+	// sendmmsg scratch, reused across emit_batch calls
+	std::vector<mmsghdr>          m_send_msgs;
+	std::vector<iovec>            m_send_iovs;
+	std::vector<sockaddr_storage> m_send_addrs;
+#endif
+
+	// segmentation offload; m_gro_poll is set while receiving with UDP_GRO
+	bool                               m_gro;
+	udp_gro_poll_uv*                   m_gro_poll;
+	std::unique_ptr<util::byte_type[]> m_gro_buffer;
+	gso_state                          m_gso;
 };
 
 #endif    // PRAKTOR_UDP_UV_H
\ No newline at end of file
@@ -0,0 +1,80 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "write_coalescer.h"
+#include "tcp_uv.h"
+
+void
+write_coalescer::schedule(uv_loop_t* lp, util::shared_ptr<tcp_channel_uv> const& chan)
+{
+	if (!m_is_initialized)
+	{
+		uv_check_init(lp, &m_check);
+		uv_idle_init(lp, &m_idle);
+		uv_handle_set_data(reinterpret_cast<uv_handle_t*>(&m_check), this);
+		m_is_initialized = true;
+	}
+	if (m_scheduled.empty())
+	{
+		uv_check_start(&m_check, on_check);
+		uv_idle_start(&m_idle, on_idle);
+	}
+	m_scheduled.push_back(chan);
+}
+
+void
+write_coalescer::clear()
+{
+	m_scheduled.clear();
+	m_flushing.clear();
+}
+
+void
+write_coalescer::on_check(uv_check_t* handle)
+{
+	reinterpret_cast<write_coalescer*>(uv_handle_get_data(reinterpret_cast<uv_handle_t*>(handle)))->flush();
+}
+
+void
+write_coalescer::on_idle(uv_idle_t*)
+{}
+
+void
+write_coalescer::flush()
+{
+	// channels may be registered again from write handlers run here; they
+	// go on the emptied list, for the next iteration
+	m_flushing.swap(m_scheduled);
+	for (auto& chan : m_flushing)
+	{
+		chan->run_deferred_writes(chan);
+	}
+	m_flushing.clear();
+	if (m_scheduled.empty())
+	{
+		uv_check_stop(&m_check);
+		uv_idle_stop(&m_idle);
+	}
+}
@@ -0,0 +1,96 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#ifndef PRAKTOR_WRITE_COALESCER_H
+#define PRAKTOR_WRITE_COALESCER_H
+
+#include <util/shared_ptr.h>
+#include <uv.h>
+#include <vector>
+
+class tcp_channel_uv;
+
+/** \brief Flushes coalesced channel writes once per loop iteration.
+ *
+ * A channel with coalescing enabled gathers its writes into one pending
+ * request and registers with its loop's coalescer; the coalescer's check
+ * handle, which runs after the loop has processed I/O, then submits each
+ * registered channel's request with a single uv_write. While anything is
+ * registered an idle handle keeps the loop from blocking in poll, so
+ * writes made from timer callbacks are not held back until the next I/O
+ * event.
+ *
+ * Channels also register writes that uv_try_write completed on the spot;
+ * the flush runs their handlers, keeping write handlers asynchronous.
+ *
+ * The handles are created on first use, so loops that never coalesce
+ * carry none.
+ */
+class write_coalescer
+{
+public:
+	write_coalescer() : m_is_initialized{false} {}
+
+	write_coalescer(write_coalescer const&) = delete;
+	write_coalescer(write_coalescer&&)      = delete;
+
+	write_coalescer&
+	operator=(write_coalescer const&)
+			= delete;
+
+	write_coalescer&
+	operator=(write_coalescer&&)
+			= delete;
+
+	/** \brief Registers chan for a flush at the end of this loop iteration.
+	 *
+	 * The caller registers a channel once per pending request.
+	 */
+	void
+	schedule(uv_loop_t* lp, util::shared_ptr<tcp_channel_uv> const& chan);
+
+	/** \brief Drops registered channels without flushing; for loop close.
+	 */
+	void
+	clear();
+
+private:
+	static void
+	on_check(uv_check_t* handle);
+
+	static void
+	on_idle(uv_idle_t* handle);
+
+	void
+	flush();
+
+	uv_check_t                                    m_check;
+	uv_idle_t                                     m_idle;
+	bool                                          m_is_initialized;
+	std::vector<util::shared_ptr<tcp_channel_uv>> m_scheduled;
+	std::vector<util::shared_ptr<tcp_channel_uv>> m_flushing;
+};
+
+#endif    // PRAKTOR_WRITE_COALESCER_H
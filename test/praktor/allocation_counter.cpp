@@ -0,0 +1,77 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include "allocation_counter.h"
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+thread_local std::size_t allocation_count{0};
+thread_local std::size_t counting_scopes{0};    // nonzero while a test is measuring
+}    // namespace
+
+allocation_scope::allocation_scope(bool counting, std::size_t& total)
+	: m_counting{counting}, m_total{total}, m_start{allocation_count}
+{
+	if (m_counting)
+	{
+		++counting_scopes;
+	}
+}
+
+allocation_scope::~allocation_scope()
+{
+	if (m_counting)
+	{
+		--counting_scopes;
+		m_total += allocation_count - m_start;
+	}
+}
+
+void*
+operator new(std::size_t size)
+{
+	if (counting_scopes > 0)
+	{
+		++allocation_count;
+	}
+	if (auto p = std::malloc(size ? size : 1))
+	{
+		return p;
+	}
+	throw std::bad_alloc{};
+}
+
+void
+operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+void
+operator delete(void* p, std::size_t) noexcept
+{
+	std::free(p);
+}
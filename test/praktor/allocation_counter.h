@@ -0,0 +1,56 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#ifndef PRAKTOR_TEST_ALLOCATION_COUNTER_H
+#define PRAKTOR_TEST_ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+/** \brief Counts the heap allocations this thread makes while in scope.
+ *
+ * allocation_counter.cpp replaces the global operator new and operator
+ * delete, so every test in the executable allocates through them. Outside
+ * a counting scope they only defer to malloc and free; a scope constructed
+ * with counting false measures nothing, which lets a test skip its warm-up.
+ */
+class allocation_scope
+{
+public:
+	allocation_scope(bool counting, std::size_t& total);
+
+	~allocation_scope();
+
+	allocation_scope(allocation_scope const&) = delete;
+
+	allocation_scope&
+	operator=(allocation_scope const&)
+			= delete;
+
+private:
+	bool         m_counting;
+	std::size_t& m_total;
+	std::size_t  m_start;
+};
+
+#endif    // PRAKTOR_TEST_ALLOCATION_COUNTER_H
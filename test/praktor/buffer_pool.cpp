@@ -0,0 +1,181 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <doctest.h>
+#include <praktor/loop.h>
+#include <praktor/tcp.h>
+#include <thread>
+#include <util/buffer.h>
+#include <vector>
+
+using namespace praktor;
+
+TEST_CASE("praktor::buffer_pool [ smoke ] { configuration }")
+{
+	auto lp = loop::create();
+
+	std::error_code err;
+	lp->configure_buffer_pool(buffer_pool_config{}.min_block_size(4096).max_block_size(1024), err);
+	CHECK(err == std::errc::invalid_argument);
+	lp->configure_buffer_pool(buffer_pool_config{}.read_size(0), err);
+	CHECK(err == std::errc::invalid_argument);
+	lp->configure_buffer_pool(buffer_pool_config{}.min_block_size(1024).max_block_size(8192).read_size(4096), err);
+	CHECK(!err);
+
+	auto stats = lp->get_buffer_pool_stats();
+	CHECK(stats.allocations == 0);
+	CHECK(stats.outstanding == 0);
+	CHECK(stats.cached_blocks == 0);
+
+	lp->close();
+}
+
+TEST_CASE("praktor::buffer_pool [ smoke ] { reads recycle pooled blocks }")
+{
+	constexpr std::size_t message_count = 8;
+
+	std::error_code err;
+	auto            lp = loop::create();
+	lp->configure_buffer_pool(buffer_pool_config{}.min_block_size(1024).max_block_size(8192).read_size(4096));
+
+	praktor::ip::endpoint ep{praktor::ip::address::v4_loopback(), 7005};
+	auto                  lstnr = lp->create_acceptor(
+            praktor::options{ep}, err, [&](acceptor::ptr const&, channel::ptr const& chan, std::error_code const& ec) {
+                CHECK(!ec);
+                chan->start_read([](channel::ptr const& chan, util::const_buffer&& buf, std::error_code const& ec) {
+                    if (ec)
+                    {
+                        chan->close();
+                        return;
+                    }
+                    chan->write(util::mutable_buffer{buf.data(), buf.size()});
+                });
+            });
+	REQUIRE(!err);
+
+	std::size_t        replies{0};
+	util::const_buffer held;
+	lp->connect_channel(praktor::options{ep}, err, [&](channel::ptr const& chan, std::error_code const& ec) {
+		REQUIRE(!ec);
+		chan->start_read([&](channel::ptr const& chan, util::const_buffer&& buf, std::error_code const& ec) {
+			REQUIRE(!ec);
+			CHECK(buf.as_string() == "hello");
+			if (++replies < message_count)
+			{
+				chan->write(util::mutable_buffer{"hello"});
+				return;
+			}
+			held = std::move(buf);
+			chan->close();
+			lstnr->close();
+			lp->schedule(std::chrono::milliseconds{100}, [](loop::ptr const& lp) { lp->stop(); });
+		});
+		chan->write(util::mutable_buffer{"hello"});
+	});
+	REQUIRE(!err);
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(replies == message_count);
+
+	auto stats = lp->get_buffer_pool_stats();
+	CHECK(stats.allocations >= 2 * message_count);
+	CHECK(stats.cache_hits > 0);
+	CHECK(stats.outstanding == 1);
+	CHECK(stats.returns == stats.allocations - 1);
+	CHECK(stats.cached_bytes == stats.cached_blocks * 4096);
+
+	// the last block is returned from another thread, after the loop has closed
+	lp->close(err);
+	CHECK(!err);
+	std::thread releaser([buf{std::move(held)}]() mutable { buf = util::const_buffer{}; });
+	releaser.join();
+
+	stats = lp->get_buffer_pool_stats();
+	CHECK(stats.outstanding == 0);
+	CHECK(stats.returns == stats.allocations);
+}
+
+TEST_CASE("praktor::buffer_pool [ smoke ] { framed reads share blocks }")
+{
+	constexpr std::size_t frame_count = 50;
+
+	std::error_code                 err;
+	auto                            lp = loop::create();
+	std::vector<util::const_buffer> frames;
+	std::size_t                     outstanding_while_held{0};
+
+	auto frame_contents = [](std::size_t i) { return std::string(100 + i, static_cast<char>('a' + i % 26)); };
+
+	// the frames reach the server together, several to a read, one
+	// straddling the two reads
+	praktor::ip::endpoint ep{praktor::ip::address::v4_loopback(), 7005};
+	auto                  lstnr = lp->create_acceptor(
+            praktor::options{ep}.framing(true),
+            err,
+            [&](acceptor::ptr const&, channel::ptr const& chan, std::error_code const& ec) {
+                CHECK(!ec);
+                chan->start_read([&](channel::ptr const& chan, util::const_buffer&& buf, std::error_code const& ec) {
+                    if (ec)
+                    {
+                        return;
+                    }
+                    frames.emplace_back(std::move(buf));
+                    if (frames.size() == frame_count)
+                    {
+                        outstanding_while_held = lp->get_buffer_pool_stats().outstanding;
+                        lp->stop();
+                    }
+                });
+            });
+	REQUIRE(!err);
+
+	lp->connect_channel(praktor::options{ep}.framing(true), err, [&](channel::ptr const& chan, std::error_code const& ec) {
+		REQUIRE(!ec);
+		for (std::size_t i = 0; i < frame_count; ++i)
+		{
+			chan->write(util::mutable_buffer{frame_contents(i)});
+		}
+	});
+	REQUIRE(!err);
+
+	lp->schedule(std::chrono::milliseconds{1000}, [](loop::ptr const& lp) { lp->stop(); });
+	lp->run(err);
+	CHECK(!err);
+	REQUIRE(frames.size() == frame_count);
+	for (std::size_t i = 0; i < frame_count; ++i)
+	{
+		CHECK(frames[i].as_string() == frame_contents(i));
+	}
+
+	// held frames keep their blocks; with copied payloads none would be
+	CHECK(outstanding_while_held > 0);
+	CHECK(outstanding_while_held < frame_count);
+
+	frames.clear();
+	CHECK(lp->get_buffer_pool_stats().outstanding == 0);
+
+	lp->close(err);
+	CHECK(!err);
+}
@@ -22,9 +22,13 @@
  * THE SOFTWARE.
  */
 
+#include "allocation_counter.h"
+#include <atomic>
 #include <doctest.h>
 #include <iostream>
 #include <praktor/loop.h>
+#include <thread>
+#include <vector>
 
 class stopwatch
 {
@@ -108,6 +112,115 @@ TEST_CASE("praktor::loop [ smoke ] { void dispatch }")
 	CHECK(!err);
 }
 
+TEST_CASE("praktor::loop [ smoke ] { dispatch while closing }")
+{
+	praktor::loop::ptr lp = praktor::loop::create();
+	std::atomic<std::size_t> ran{0};
+
+	std::thread loop_thread{[lp]() {
+		std::error_code err;
+		lp->run(err);
+		lp->close(err);
+	}};
+
+	std::vector<std::thread> producers;
+	std::atomic<std::size_t> accepted{0};
+	for (int i = 0; i < 4; ++i)
+	{
+		producers.emplace_back([&]() {
+			std::error_code err;
+			while (!err)
+			{
+				lp->dispatch(err, [&]() { ++ran; });
+				if (!err)
+				{
+					++accepted;
+				}
+			}
+			CHECK(err == praktor::errc::loop_closed);
+		});
+	}
+
+	std::this_thread::sleep_for(std::chrono::milliseconds{20});
+	lp->dispatch([](praktor::loop::ptr const& lp) { lp->stop(); });
+
+	for (auto& t : producers)
+	{
+		t.join();
+	}
+	loop_thread.join();
+	CHECK(ran.load() > 0);
+	CHECK(ran.load() <= accepted.load());
+}
+
+TEST_CASE("praktor::loop [ smoke ] { dispatch recycles its nodes }")
+{
+	constexpr std::size_t warm_up_count  = 10;
+	constexpr std::size_t dispatch_count = 1000;
+
+	praktor::loop::ptr lp = praktor::loop::create();
+	std::error_code    err;
+	std::size_t        ran{0};
+	std::size_t        allocations{0};
+
+	// each handler dispatches the next, taking the node its own came in
+	praktor::unique_function<void(praktor::loop::ptr const&)> next;
+	next = [&](praktor::loop::ptr const& loop_ptr) {
+		allocation_scope scope{ran >= warm_up_count, allocations};
+		if (++ran < warm_up_count + dispatch_count)
+		{
+			loop_ptr->dispatch([&](praktor::loop::ptr const& loop_ptr) { next(loop_ptr); });
+		}
+		else
+		{
+			loop_ptr->stop();
+		}
+	};
+	lp->dispatch([&](praktor::loop::ptr const& loop_ptr) { next(loop_ptr); });
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(ran == warm_up_count + dispatch_count);
+	CHECK(allocations == 0);
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::loop [ smoke ] { dispatch from another thread recycles its nodes }")
+{
+	constexpr std::size_t warm_up_count  = 10;
+	constexpr std::size_t dispatch_count = 1000;
+
+	praktor::loop::ptr       lp = praktor::loop::create();
+	std::atomic<std::size_t> ran{0};
+	std::size_t              allocations{0};
+
+	std::thread loop_thread{[lp]() {
+		std::error_code err;
+		lp->run(err);
+	}};
+
+	// one handler in flight at a time; each node goes back to the loop's
+	// cache before the next dispatch takes it
+	for (std::size_t i = 0; i < warm_up_count + dispatch_count; ++i)
+	{
+		{
+			allocation_scope scope{i >= warm_up_count, allocations};
+			lp->dispatch([&]() { ++ran; });
+		}
+		while (ran.load() <= i)
+		{
+			std::this_thread::yield();
+		}
+	}
+	lp->dispatch([](praktor::loop::ptr const& lp) { lp->stop(); });
+	loop_thread.join();
+
+	CHECK(ran.load() == warm_up_count + dispatch_count);
+	CHECK(allocations == 0);
+	lp->close();
+}
+
 TEST_CASE("praktor::loop [ smoke ] { basic }")
 {
 	praktor::loop::ptr lp = praktor::loop::create();
@@ -362,6 +475,410 @@ TEST_CASE("praktor::loop::timer [ smoke ] { close/cancel before expire }")
 }
 
 
+TEST_CASE("praktor::loop::timer [ smoke ] { periodic }")
+{
+	praktor::loop::ptr lp = praktor::loop::create();
+	int                ticks{0};
+
+	auto tp = lp->create_timer([&](praktor::timer::ptr t) {
+		if (++ticks == 5)
+		{
+			t->stop();
+			lp->stop();
+		}
+	});
+	stopwatch sw;
+	tp->start_periodic(std::chrono::milliseconds{10}, std::chrono::milliseconds{20});
+	CHECK(tp->is_pending());
+
+	lp->run();
+	CHECK(ticks == 5);
+	CHECK(!tp->is_pending());
+	CHECK(sw.elapsed<std::chrono::milliseconds>().count() >= 85);
+
+	std::error_code err;
+	tp->start_periodic(std::chrono::milliseconds{10}, std::chrono::milliseconds{0}, err);
+	CHECK(err == std::errc::invalid_argument);
+	tp->close();
+	lp->close();
+}
+
+TEST_CASE("praktor::loop::timer [ smoke ] { periodic fixed rate }")
+{
+	praktor::loop::ptr lp = praktor::loop::create();
+	int                ticks{0};
+	std::vector<long>  fired_at;
+	stopwatch          sw;
+
+	auto tp = lp->create_timer([&](praktor::timer::ptr t) {
+		fired_at.push_back(sw.elapsed<std::chrono::milliseconds>().count());
+		std::this_thread::sleep_for(std::chrono::milliseconds{7});
+		if (++ticks == 10)
+		{
+			t->stop();
+			lp->stop();
+		}
+	});
+	tp->start_periodic(
+			std::chrono::milliseconds{20}, std::chrono::milliseconds{20}, praktor::timer::periodic_mode::fixed_rate);
+
+	lp->run();
+	CHECK(ticks == 10);
+
+	// every tick stays on the 20 ms grid despite the handler's own run time
+	for (std::size_t k = 0; k < fired_at.size(); ++k)
+	{
+		CHECK(fired_at[k] >= static_cast<long>(20 * (k + 1)) - 2);
+		CHECK(fired_at[k] < static_cast<long>(20 * (k + 1)) + 15);
+	}
+	tp->close();
+	lp->close();
+}
+
+TEST_CASE("praktor::loop::timer [ smoke ] { schedule every }")
+{
+	praktor::loop::ptr lp = praktor::loop::create();
+	std::error_code    err;
+	int                ticks{0};
+	praktor::timer::ptr handle;
+
+	handle = lp->schedule_every(std::chrono::milliseconds{10}, err, [&]() {
+		if (++ticks == 3)
+		{
+			handle->close();
+		}
+	});
+	CHECK(!err);
+	CHECK(handle);
+
+	int loop_ticks{0};
+	auto loop_handle = lp->schedule_every(
+			std::chrono::milliseconds{15},
+			[&](praktor::loop::ptr const& l) {
+				if (++loop_ticks == 6)
+				{
+					l->stop();
+				}
+			},
+			praktor::timer::periodic_mode::fixed_rate);
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(ticks == 3);
+	CHECK(loop_ticks == 6);
+	loop_handle->close();
+	handle.reset();
+
+	auto bad = lp->schedule_every(std::chrono::milliseconds{0}, err, []() {});
+	CHECK(err == std::errc::invalid_argument);
+	CHECK(!bad);
+	lp->close();
+}
+
+TEST_CASE("praktor::loop::timer [ smoke ] { slack }")
+{
+	praktor::loop::ptr lp = praktor::loop::create();
+	int                fired{0};
+	bool               early{false};
+	long               latest_overrun{0};
+	stopwatch          sw;
+
+	// one timer per millisecond from 100 to 149 ms; with 64 ms of slack they
+	// gather on at most two 64 ms boundaries
+	for (int i = 0; i < 50; ++i)
+	{
+		auto timeout = std::chrono::milliseconds{100 + i};
+		lp->schedule(timeout, std::chrono::milliseconds{64}, [&, timeout]() {
+			auto elapsed   = sw.elapsed<std::chrono::milliseconds>();
+			early          = early || elapsed < timeout - std::chrono::milliseconds{1};
+			latest_overrun = std::max(latest_overrun, static_cast<long>((elapsed - timeout).count()));
+			++fired;
+		});
+	}
+
+	auto tp = lp->create_timer([&](praktor::timer::ptr) { lp->stop(); });
+	tp->start(std::chrono::milliseconds{260}, std::chrono::milliseconds{4});
+
+	lp->run();
+	CHECK(fired == 50);
+	CHECK(!early);
+	CHECK(latest_overrun <= 64 + 10);
+
+	auto stats = lp->get_timer_stats();
+	CHECK(stats.expirations == 51);
+	CHECK(stats.wakeups_saved >= 40);
+
+	std::error_code err;
+	lp->schedule(std::chrono::milliseconds{1}, std::chrono::milliseconds{-1}, err, []() {});
+	CHECK(err == std::errc::invalid_argument);
+	tp->close();
+	lp->close();
+}
+
+TEST_CASE("praktor::loop::timeout [ smoke ] { fire order }")
+{
+	praktor::loop::ptr lp = praktor::loop::create();
+	std::error_code    err;
+	std::vector<int>   fired;
+	stopwatch          sw;
+
+	// 300 and 600 ms land above the root level and must cascade down
+	lp->set_timeout(std::chrono::milliseconds{600}, err, [&]() {
+		fired.push_back(600);
+		lp->stop();
+	});
+	CHECK(!err);
+	lp->set_timeout(std::chrono::milliseconds{20}, [&]() { fired.push_back(20); });
+	lp->set_timeout(std::chrono::milliseconds{300}, [&]() { fired.push_back(300); });
+	lp->set_timeout(std::chrono::milliseconds{5}, [&]() { fired.push_back(5); });
+	lp->set_timeout(std::chrono::milliseconds{20}, [&]() { fired.push_back(21); });
+
+	lp->run(err);
+	CHECK(!err);
+	// deadlines count from the loop's cached time, which may trail the stopwatch slightly
+	CHECK(sw.elapsed<std::chrono::milliseconds>().count() >= 590);
+	CHECK(fired == std::vector<int>{5, 20, 21, 300, 600});
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::loop::timeout [ smoke ] { cancel and restart }")
+{
+	praktor::loop::ptr lp = praktor::loop::create();
+	std::error_code    err;
+	bool               cancelled_fired{false};
+	bool               far_fired{false};
+	int                restarted_fired{0};
+	stopwatch          sw;
+
+	auto cancelled = lp->set_timeout(std::chrono::milliseconds{50}, [&]() { cancelled_fired = true; });
+	auto copy      = cancelled;
+	auto far       = lp->set_timeout(std::chrono::hours{24 * 100}, [&]() { far_fired = true; });
+	auto restarted = lp->set_timeout(std::chrono::milliseconds{50}, [&]() { ++restarted_fired; });
+
+	CHECK(praktor::timeout{}.is_pending() == false);
+	CHECK(copy.is_pending());
+	CHECK(cancelled.cancel());
+	CHECK(!copy.is_pending());
+	CHECK(!copy.cancel());
+
+	lp->set_timeout(std::chrono::milliseconds{30}, [&]() {
+		CHECK(restarted.is_pending());
+		CHECK(restarted.restart(std::chrono::milliseconds{100}));
+		CHECK(far.cancel());
+
+		// the slot just released may be reused; the stale handle must not see it
+		auto reused = lp->set_timeout(std::chrono::milliseconds{1}, []() {});
+		CHECK(!cancelled.is_pending());
+		CHECK(!cancelled.cancel());
+		CHECK(reused.is_pending());
+	});
+	lp->set_timeout(std::chrono::milliseconds{200}, [&]() { lp->stop(); });
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(sw.elapsed<std::chrono::milliseconds>().count() >= 190);
+	CHECK(!cancelled_fired);
+	CHECK(!far_fired);
+	CHECK(restarted_fired == 1);
+	CHECK(!restarted.is_pending());
+	CHECK(!restarted.restart(std::chrono::milliseconds{10}));
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::loop::timeout [ smoke ] { rearm from handler and close }")
+{
+	praktor::loop::ptr lp = praktor::loop::create();
+	std::error_code    err;
+	int                ticks{0};
+	auto               token = std::make_shared<int>(0);
+
+	praktor::unique_function<void()> tick;
+	tick = [&]() {
+		if (++ticks < 5)
+		{
+			lp->set_timeout(std::chrono::milliseconds{2}, [&]() { tick(); });
+		}
+		else
+		{
+			lp->stop();
+		}
+	};
+	lp->set_timeout(std::chrono::milliseconds{2}, [&]() { tick(); });
+
+	// still pending at close; its handler must be destroyed, not invoked
+	lp->set_timeout(std::chrono::minutes{10}, [token]() { FAIL("fired after close"); });
+	CHECK(token.use_count() == 2);
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(ticks == 5);
+	lp->close(err);
+	CHECK(!err);
+	CHECK(token.use_count() == 1);
+
+	lp->set_timeout(std::chrono::milliseconds{1}, err, []() {});
+	CHECK(err == praktor::errc::loop_closed);
+}
+
+TEST_CASE("praktor::loop::timeout [ smoke ] { handles outlive the loop }")
+{
+	praktor::timeout wheel_timeout;
+	praktor::timeout precise_timeout;
+	{
+		praktor::loop::ptr lp = praktor::loop::create();
+		wheel_timeout         = lp->set_timeout(std::chrono::seconds{10}, []() { FAIL("fired after close"); });
+		precise_timeout       = lp->set_precise_timeout(std::chrono::seconds{10}, []() { FAIL("fired after close"); });
+		CHECK(wheel_timeout.is_pending());
+		CHECK(precise_timeout.is_pending());
+		lp->close();
+		CHECK(!wheel_timeout.is_pending());
+	}
+
+	// as a promise settled after its loop is gone would
+	CHECK(!wheel_timeout.cancel());
+	CHECK(!precise_timeout.cancel());
+	CHECK(!wheel_timeout.restart(std::chrono::milliseconds{1}));
+
+	// the next loop reuses the retired entries without reviving the old handles
+	praktor::loop::ptr lp = praktor::loop::create();
+	auto               fresh = lp->set_timeout(std::chrono::seconds{10}, []() {});
+	CHECK(fresh.is_pending());
+	CHECK(!wheel_timeout.is_pending());
+	lp->close();
+}
+
+// Real promises timed out through util::promise_timer<loop::ptr>: each
+// round settles half of them before their timeout and lets the other half
+// time out on the loop. Only the promises themselves are created outside
+// the counted scope.
+TEST_CASE("praktor::loop::timeout [ smoke ] { steady-state promise timeouts make no allocations }")
+{
+	constexpr std::size_t batch_size     = 500;
+	constexpr std::size_t round_count    = 20;
+	constexpr std::size_t warm_up_rounds = 2;
+
+	std::error_code                         err;
+	auto                                    lp = praktor::loop::create();
+	util::promise_timer<praktor::loop::ptr> settle_first{std::chrono::seconds{30}, lp};
+	util::promise_timer<praktor::loop::ptr> expire_first{std::chrono::milliseconds{1}, lp};
+	std::size_t                             allocations{0};
+	std::size_t                             unfinished{0};
+
+	for (std::size_t round = 0; round < round_count; ++round)
+	{
+		std::vector<util::promise<int>> settled(batch_size);
+		std::vector<util::promise<int>> expired(batch_size);
+		{
+			allocation_scope scope{round >= warm_up_rounds, allocations};
+			for (auto& p : settled)
+			{
+				settle_first(p);
+			}
+			for (auto& p : expired)
+			{
+				expire_first(p);
+			}
+
+			for (auto& p : settled)
+			{
+				p.cancel_timer();
+				p.reject(make_error_code(std::errc::operation_canceled));
+			}
+
+			// the wheel fires by deadline, so everything armed above has
+			// timed out by the time this stops the loop
+			lp->set_timeout(std::chrono::milliseconds{2}, [&]() { lp->stop(); });
+			lp->run(err);
+			CHECK(!err);
+		}
+
+		for (auto& p : expired)
+		{
+			unfinished += p.is_finished() ? 0 : 1;
+		}
+	}
+	CHECK(unfinished == 0);
+	CHECK(allocations == 0);
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::loop::timeout [ smoke ] { precise }")
+{
+	using clock = std::chrono::steady_clock;
+
+	praktor::loop::ptr lp = praktor::loop::create();
+	std::error_code    err;
+	int                chained{0};
+	bool               early{false};
+	auto               start = clock::now();
+
+	// 20 back-to-back 200 us waits; at millisecond resolution these would take at least 20 ms
+	praktor::unique_function<void()> next;
+	next = [&]() {
+		auto deadline = clock::now() + std::chrono::microseconds{200};
+		lp->set_precise_timeout(deadline, [&, deadline]() {
+			early = early || clock::now() < deadline;
+			if (++chained < 20)
+			{
+				next();
+			}
+			else
+			{
+				lp->stop();
+			}
+		});
+	};
+	next();
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(chained == 20);
+	CHECK(!early);
+	auto elapsed = clock::now() - start;
+	CHECK(elapsed >= std::chrono::microseconds{4000});
+	CHECK(elapsed < std::chrono::milliseconds{19});
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::loop::timeout [ smoke ] { precise deadlines }")
+{
+	using clock = std::chrono::steady_clock;
+
+	praktor::loop::ptr lp = praktor::loop::create();
+	std::error_code    err;
+	std::vector<int>   fired;
+	auto               base  = clock::now() + std::chrono::milliseconds{5};
+	auto               token = std::make_shared<int>(0);
+
+	lp->set_precise_timeout(base + std::chrono::microseconds{900}, err, [&]() { fired.push_back(3); });
+	CHECK(!err);
+	lp->set_precise_timeout(base + std::chrono::microseconds{300}, [&]() { fired.push_back(1); });
+	lp->set_precise_timeout(base + std::chrono::microseconds{300}, [&]() { fired.push_back(2); });
+	auto cancelled = lp->set_precise_timeout(base + std::chrono::microseconds{100}, [&]() { fired.push_back(0); });
+	auto moved     = lp->set_precise_timeout(base, [&]() { fired.push_back(4); });
+	lp->set_precise_timeout(base + std::chrono::milliseconds{5}, [&]() { lp->stop(); });
+	lp->set_precise_timeout(std::chrono::seconds{60}, [token]() { FAIL("fired after close"); });
+
+	CHECK(cancelled.cancel());
+	CHECK(!cancelled.is_pending());
+	CHECK(moved.restart(std::chrono::milliseconds{7}));
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(fired == std::vector<int>{1, 2, 3, 4});
+	CHECK(!moved.is_pending());
+
+	CHECK(token.use_count() == 2);
+	lp->close(err);
+	CHECK(!err);
+	CHECK(token.use_count() == 1);
+}
+
 TEST_CASE("praktor::resolver [ smoke ] { basic }")
 {
 	std::error_code err;
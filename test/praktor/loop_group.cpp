@@ -0,0 +1,211 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <doctest.h>
+#include <future>
+#include <iostream>
+#include <praktor/loop_group.h>
+#include <praktor/tcp.h>
+#include <set>
+
+TEST_CASE("praktor::loop_group [ smoke ] { dispatch to each loop }")
+{
+	std::error_code err;
+	auto            group = praktor::loop_group::create(3, praktor::loop_group::affinity::none, err);
+	REQUIRE(!err);
+	REQUIRE(group->size() == 3);
+	CHECK(group->is_running());
+
+	std::vector<std::promise<std::thread::id>> promises(group->size());
+	for (std::size_t i = 0; i < group->size(); ++i)
+	{
+		group->dispatch_to(i, err, [&, i](praktor::loop::ptr const& lp) {
+			CHECK(lp == group->get(i));
+			promises[i].set_value(std::this_thread::get_id());
+		});
+		CHECK(!err);
+	}
+
+	std::set<std::thread::id> ids;
+	for (auto& p : promises)
+	{
+		ids.insert(p.get_future().get());
+	}
+	CHECK(ids.size() == group->size());
+	CHECK(ids.count(std::this_thread::get_id()) == 0);
+	CHECK(!group->is_group_thread());
+
+	group->stop(err);
+	CHECK(!err);
+	group->join(err);
+	CHECK(!err);
+	CHECK(!group->is_running());
+
+	group->dispatch_to(0, err, []() {});
+	CHECK(err == praktor::errc::loop_closed);
+}
+
+TEST_CASE("praktor::loop_group [ smoke ] { selection }")
+{
+	auto group = praktor::loop_group::create(4);
+
+	std::set<praktor::loop*> seen;
+	for (std::size_t i = 0; i < group->size(); ++i)
+	{
+		seen.insert(group->next().get());
+	}
+	CHECK(seen.size() == group->size());
+	CHECK(group->next() == group->get(0));
+
+	CHECK(group->select(17) == group->select(17));
+	CHECK(group->select(17) == group->get(17 % group->size()));
+
+	std::error_code err;
+	group->dispatch_to(group->size(), err, []() {});
+	CHECK(err == std::errc::invalid_argument);
+
+	group->stop();
+	group->join();
+}
+
+TEST_CASE("praktor::loop_group [ smoke ] { pinned threads }")
+{
+	std::error_code err;
+	auto            group = praktor::loop_group::create(2, praktor::loop_group::affinity::pin_to_cores, err);
+	if (err)
+	{
+		std::cout << "thread pinning not available: " << err.message() << std::endl;
+		CHECK(!group);
+	}
+	else
+	{
+		std::promise<void> done;
+		group->dispatch_to(1, [&]() { done.set_value(); });
+		done.get_future().wait();
+		group->stop();
+		group->join();
+	}
+}
+
+TEST_CASE("praktor::loop_group [ smoke ] { destroy without explicit stop }")
+{
+	std::promise<void> done;
+	{
+		auto group = praktor::loop_group::create(2);
+		group->dispatch_to(0, [&]() { done.set_value(); });
+		done.get_future().wait();
+	}
+	CHECK(true);
+}
+
+TEST_CASE("praktor::loop_group [ smoke ] { loop stops while creating acceptors }")
+{
+	auto group = praktor::loop_group::create(2);
+
+	// Keep loop 0 busy while create_acceptors queues behind it, then stop it
+	// before the queued handler gets to run.
+	std::promise<void> busy;
+	group->dispatch_to(0, [&](praktor::loop::ptr const& lp) {
+		busy.set_value();
+		std::this_thread::sleep_for(std::chrono::milliseconds{200});
+		lp->stop();
+	});
+	busy.get_future().wait();
+
+	std::error_code err;
+	auto            acceptors = group->create_acceptors(
+            praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 0}},
+            err,
+            [](praktor::acceptor::ptr const&, praktor::channel::ptr const& chan, std::error_code const&) {
+                chan->close();
+            });
+	CHECK(err == praktor::errc::loop_closed);
+	CHECK(acceptors.empty());
+
+	group->stop();
+	group->join();
+}
+
+TEST_CASE("praktor::loop_group [ smoke ] { sharded acceptors }")
+{
+	std::error_code err;
+	auto            group = praktor::loop_group::create(2);
+
+	std::atomic<std::size_t> accepted{0};
+	praktor::ip::endpoint    listen_ep{praktor::ip::address::v4_loopback(), 0};
+	auto                     acceptors = group->create_acceptors(
+            praktor::options{listen_ep},
+            err,
+            [&](praktor::acceptor::ptr const& ap, praktor::channel::ptr const& chan, std::error_code const& ec) {
+                CHECK(!ec);
+                chan->close();
+                ++accepted;
+            });
+	if (err == std::errc::operation_not_supported)
+	{
+		std::cout << "SO_REUSEPORT not available" << std::endl;
+		return;
+	}
+	REQUIRE(!err);
+	REQUIRE(acceptors.size() == group->size());
+
+	std::promise<std::uint16_t> port_promise;
+	group->dispatch_to(1, [&]() { port_promise.set_value(acceptors[1]->get_endpoint().port()); });
+	auto port = port_promise.get_future().get();
+	CHECK(port != 0);
+	CHECK(port == acceptors[0]->get_endpoint().port());
+
+	auto        lp = praktor::loop::create();
+	std::size_t connected{0};
+	for (int i = 0; i < 8; ++i)
+	{
+		lp->connect_channel(
+				praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_loopback(), port}},
+				err,
+				[&](praktor::channel::ptr const& chan, std::error_code const& ec) {
+					CHECK(!ec);
+					chan->close();
+					if (++connected == 8)
+					{
+						chan->loop()->stop();
+					}
+				});
+		CHECK(!err);
+	}
+	lp->run(err);
+	CHECK(!err);
+	lp->close(err);
+	CHECK(connected == 8);
+
+	auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds{2};
+	while (accepted.load() < 8 && std::chrono::steady_clock::now() < deadline)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds{1});
+	}
+	CHECK(accepted.load() == 8);
+
+	group->stop();
+	group->join();
+}
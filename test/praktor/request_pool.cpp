@@ -0,0 +1,283 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "allocation_counter.h"
+#include <chrono>
+#include <cstring>
+#include <doctest.h>
+#include <praktor/loop.h>
+#include <praktor/tcp.h>
+#include <util/buffer.h>
+#include <vector>
+
+using namespace praktor;
+
+namespace
+{
+constexpr std::size_t warm_up_round_trips = 100;
+constexpr std::size_t counted_round_trips = 1000;
+constexpr std::size_t echo_message_size   = 64;
+constexpr std::size_t spare_buffer_count  = 4;
+
+// TCP echoes use messages far larger than the socket buffers, so
+// uv_try_write only takes part of each one and the rest goes out as a
+// pooled write request.
+constexpr std::size_t queued_message_size    = 64 * 1024;
+constexpr std::size_t small_socket_buffer    = 4096;
+constexpr std::size_t server_spare_buf_count = 128;
+
+// Buffers recycled through write and send handlers; a message only takes
+// one that was handed back.
+class spare_buffers
+{
+public:
+	spare_buffers(std::size_t count = spare_buffer_count, std::size_t size = echo_message_size)
+	{
+		m_buffers.reserve(count);
+		for (std::size_t i = 0; i < count; ++i)
+		{
+			m_buffers.emplace_back(util::mutable_buffer{size});
+		}
+	}
+
+	util::mutable_buffer
+	take(util::byte_type const* data, std::size_t size)
+	{
+		REQUIRE(!m_buffers.empty());
+		auto buf = std::move(m_buffers.back());
+		m_buffers.pop_back();
+		std::memcpy(buf.data(), data, size);
+		buf.size(size);
+		return buf;
+	}
+
+	void
+	put_back(util::mutable_buffer&& buf)
+	{
+		m_buffers.emplace_back(std::move(buf));
+	}
+
+private:
+	std::vector<util::mutable_buffer> m_buffers;
+};
+
+// Echoes message over one connection made with opts, counting the
+// allocations made from the handlers on once the warm-up is over.
+void
+check_tcp_echo_allocations(praktor::options const& opts, std::vector<util::byte_type> const& message)
+{
+	std::error_code err;
+	auto            lp = loop::create();
+	spare_buffers   server_buffers{server_spare_buf_count, message.size()};
+	spare_buffers   client_buffers{spare_buffer_count, message.size()};
+	std::size_t     round_trips{0};
+	std::size_t     echoed{0};
+	std::size_t     allocations{0};
+
+	praktor::request_pool_stats counted_from{};
+
+	auto counting = [&]() { return round_trips >= warm_up_round_trips; };
+
+	auto lstnr = lp->create_acceptor(
+			opts, err, [&](acceptor::ptr const&, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+					if (ec)
+					{
+						return;
+					}
+					allocation_scope scope{counting(), allocations};
+					cp->write(
+							server_buffers.take(buf.data(), buf.size()),
+							[&](channel::ptr const&, util::mutable_buffer&& buf, std::error_code const& ec) {
+								allocation_scope scope{counting(), allocations};
+								CHECK(!ec);
+								server_buffers.put_back(std::move(buf));
+							});
+				});
+			});
+	CHECK(!err);
+
+	auto send_ping = [&](channel::ptr const& chan) {
+		chan->write(
+				client_buffers.take(message.data(), message.size()),
+				[&](channel::ptr const&, util::mutable_buffer&& buf, std::error_code const& ec) {
+					allocation_scope scope{counting(), allocations};
+					CHECK(!ec);
+					client_buffers.put_back(std::move(buf));
+				});
+	};
+
+	lp->connect_channel(opts, err, [&](channel::ptr const& chan, std::error_code const& ec) {
+		CHECK(!ec);
+		chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+			if (ec)
+			{
+				return;
+			}
+			allocation_scope scope{counting(), allocations};
+			echoed += buf.size();
+			if (echoed == message.size())
+			{
+				echoed = 0;
+				if (++round_trips == warm_up_round_trips)
+				{
+					counted_from = cp->loop()->get_request_pool_stats();
+				}
+				if (round_trips == warm_up_round_trips + counted_round_trips)
+				{
+					cp->loop()->stop();
+				}
+				else
+				{
+					send_ping(cp);
+				}
+			}
+		});
+		send_ping(chan);
+	});
+	CHECK(!err);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{5000});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(round_trips == warm_up_round_trips + counted_round_trips);
+	CHECK(allocations == 0);
+
+	// every message's client write, at least, was queued as a request
+	auto stats = lp->get_request_pool_stats();
+	CHECK(stats.requests - counted_from.requests >= counted_round_trips);
+	CHECK(stats.cache_hits - counted_from.cache_hits == stats.requests - counted_from.requests);
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+praktor::options
+tcp_echo_options()
+{
+	return praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 7008}}
+			.send_buffer_size(small_socket_buffer)
+			.receive_buffer_size(small_socket_buffer);
+}
+}    // namespace
+
+// Buffers handed to read and receive handlers are wrapped before the
+// handler runs, by util; the counts cover everything from the handlers on:
+// copying the message, writing or sending it, and the completions.
+
+TEST_CASE("praktor::request_pool [ smoke ] { steady-state tcp echo makes no allocations per message }")
+{
+	check_tcp_echo_allocations(tcp_echo_options(), std::vector<util::byte_type>(queued_message_size));
+}
+
+TEST_CASE("praktor::request_pool [ smoke ] { steady-state framed tcp echo makes no allocations per message }")
+{
+	check_tcp_echo_allocations(tcp_echo_options().framing(true), std::vector<util::byte_type>(queued_message_size));
+}
+
+TEST_CASE("praktor::request_pool [ smoke ] { steady-state udp echo makes no allocations per message }")
+{
+	std::error_code err;
+	auto            lp = loop::create();
+	spare_buffers   server_buffers;
+	spare_buffers   client_buffers;
+	std::size_t     round_trips{0};
+	std::size_t     allocations{0};
+	util::byte_type ping[echo_message_size]{};
+
+	praktor::ip::endpoint server_ep{praktor::ip::address::v4_loopback(), 7009};
+
+	auto counting = [&]() { return round_trips >= warm_up_round_trips; };
+
+	auto server = lp->create_transceiver(praktor::options{server_ep}, err);
+	CHECK(!err);
+	server->start_receive(
+			err,
+			[&](transceiver::ptr const& tp, util::const_buffer&& buf, praktor::ip::endpoint const& ep, std::error_code const& ec) {
+				if (ec)
+				{
+					return;
+				}
+				allocation_scope scope{counting(), allocations};
+				tp->emit(
+						server_buffers.take(buf.data(), buf.size()),
+						ep,
+						[&](transceiver::ptr const&, util::mutable_buffer&& buf, praktor::ip::endpoint const&, std::error_code const& ec) {
+							allocation_scope scope{counting(), allocations};
+							CHECK(!ec);
+							server_buffers.put_back(std::move(buf));
+						});
+			});
+	CHECK(!err);
+
+	auto client = lp->create_transceiver(praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 0}}, err);
+	CHECK(!err);
+
+	auto send_ping = [&](transceiver::ptr const& tp) {
+		tp->emit(
+				client_buffers.take(ping, sizeof(ping)),
+				server_ep,
+				[&](transceiver::ptr const&, util::mutable_buffer&& buf, praktor::ip::endpoint const&, std::error_code const& ec) {
+					allocation_scope scope{counting(), allocations};
+					CHECK(!ec);
+					client_buffers.put_back(std::move(buf));
+				});
+	};
+
+	client->start_receive(
+			err,
+			[&](transceiver::ptr const& tp, util::const_buffer&& buf, praktor::ip::endpoint const&, std::error_code const& ec) {
+				if (ec)
+				{
+					return;
+				}
+				allocation_scope scope{counting(), allocations};
+				CHECK(buf.size() == echo_message_size);
+				if (++round_trips == warm_up_round_trips + counted_round_trips)
+				{
+					tp->loop()->stop();
+				}
+				else
+				{
+					send_ping(tp);
+				}
+			});
+	CHECK(!err);
+	send_ping(client);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{5000});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(round_trips == warm_up_round_trips + counted_round_trips);
+	CHECK(allocations == 0);
+
+	lp->close(err);
+	CHECK(!err);
+}
@@ -22,14 +22,46 @@
  * THE SOFTWARE.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <deque>
 #include <doctest.h>
 #include <iostream>
+#include <mutex>
 #include <praktor/loop.h>
+#include <praktor/loop_group.h>
 #include <praktor/tcp.h>
+#include <praktor/tcp_uv.h>
+#include <set>
+#include <string>
 #include <util/buffer.h>
+#include <vector>
+
+#if defined(__linux__)
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#endif
 
 using namespace praktor;
 
+#if defined(__linux__)
+namespace
+{
+// Reads an option back from the socket under a channel or acceptor.
+int
+get_socket_option(tcp_base_uv& sock, int level, int name)
+{
+	uv_os_fd_t fd;
+	REQUIRE(uv_fileno(reinterpret_cast<uv_handle_t*>(sock.get_stream_handle()), &fd) == 0);
+	int       value{0};
+	socklen_t size{sizeof(value)};
+	REQUIRE(::getsockopt(fd, level, name, &value, &size) == 0);
+	return value;
+}
+}    // namespace
+#endif
+
 TEST_CASE("praktor::tcp_acceptor [ smoke ] { basic functionality }")
 {
 	bool acceptor_handler_did_execute{false};
@@ -863,4 +895,1083 @@ TEST_CASE("praktor::tcp_framing_acceptor [ smoke ] { framing connect read write
 	CHECK(channel_read_handler_did_execute);
 	CHECK(channel_write_handler_did_execute);
 	CHECK(!err);
-}
\ No newline at end of file
+}
+TEST_CASE("praktor::tcp_acceptor [ smoke ] { reuse port }")
+{
+	std::error_code err;
+	auto            lp = loop::create();
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7003};
+
+	auto first = lp->create_acceptor(err);
+	REQUIRE(!err);
+	first->bind(praktor::options{listen_ep}.reuse_port(true), err);
+	if (err == std::errc::operation_not_supported)
+	{
+		std::cout << "SO_REUSEPORT not available" << std::endl;
+		lp->close(err);
+		return;
+	}
+	CHECK(!err);
+
+	auto second = lp->create_acceptor(err);
+	REQUIRE(!err);
+	second->bind(praktor::options{listen_ep}.reuse_port(true), err);
+	CHECK(!err);
+
+	std::size_t accepted{0};
+	auto        on_connection = [&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+        CHECK(!ec);
+        chan->close();
+        ++accepted;
+	};
+	first->listen(err, on_connection);
+	CHECK(!err);
+	second->listen(err, on_connection);
+	CHECK(!err);
+
+	// a socket without SO_REUSEPORT cannot join the group; libuv defers
+	// EADDRINUSE from bind to listen
+	auto third = lp->create_acceptor(err);
+	REQUIRE(!err);
+	third->bind(praktor::options{listen_ep}, err);
+	if (!err)
+	{
+		third->listen(err, [](acceptor::ptr const&, channel::ptr const&, std::error_code const&) {});
+	}
+	CHECK(err);
+	third->close();
+
+	std::size_t connected{0};
+	for (int i = 0; i < 4; ++i)
+	{
+		lp->connect_channel(praktor::options{listen_ep}, err, [&](channel::ptr const& chan, std::error_code const& ec) {
+			CHECK(!ec);
+			chan->close();
+			if (++connected == 4)
+			{
+				auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+				stop_timer->start(std::chrono::milliseconds{100});
+			}
+		});
+		CHECK(!err);
+	}
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(connected == 4);
+	CHECK(accepted == 4);
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_acceptor [ smoke ] { hand off to worker loops }")
+{
+	constexpr std::size_t connection_count = 4;
+
+	std::error_code err;
+	auto            lp      = loop::create();
+	auto            workers = loop_group::create(2);
+
+	std::mutex                mutex;
+	std::set<std::thread::id> handler_threads;
+	std::set<praktor::loop*>  channel_loops;
+	std::atomic<std::size_t>  handed_off{0};
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7004};
+	auto                  lstnr = lp->create_acceptor(err);
+	REQUIRE(!err);
+	lstnr->bind(praktor::options{listen_ep}, err);
+	REQUIRE(!err);
+	lstnr->listen(
+			err,
+			[workers]() { return workers->next(); },
+			[&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				CHECK(workers->is_group_thread());
+				{
+					std::lock_guard<std::mutex> guard(mutex);
+					handler_threads.insert(std::this_thread::get_id());
+					channel_loops.insert(chan->loop().get());
+				}
+				++handed_off;
+				chan->start_read([](channel::ptr const& chan, util::const_buffer&& buf, std::error_code const& ec) {
+					if (ec)
+					{
+						chan->close();
+						return;
+					}
+					chan->write(util::mutable_buffer{buf.data(), buf.size()});
+				});
+			});
+	REQUIRE(!err);
+
+	std::size_t replies{0};
+	for (std::size_t i = 0; i < connection_count; ++i)
+	{
+		lp->connect_channel(praktor::options{listen_ep}, err, [&](channel::ptr const& chan, std::error_code const& ec) {
+			CHECK(!ec);
+			chan->start_read([&](channel::ptr const& chan, util::const_buffer&& buf, std::error_code const& ec) {
+				CHECK(!ec);
+				CHECK(buf.as_string() == "ping");
+				chan->close();
+				if (++replies == connection_count)
+				{
+					lstnr->close();
+				}
+			});
+			chan->write(util::mutable_buffer{"ping"});
+		});
+		CHECK(!err);
+	}
+
+	auto loop_exit_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	loop_exit_timer->start(std::chrono::milliseconds{3000}, err);
+
+	while (replies < connection_count && lp->run_once(err) && !err)
+		;
+	CHECK(replies == connection_count);
+	CHECK(handed_off.load() == connection_count);
+	CHECK(handler_threads.size() == workers->size());
+	CHECK(channel_loops.size() == workers->size());
+	CHECK(channel_loops.count(lp.get()) == 0);
+
+	workers->stop();
+	workers->join();
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_acceptor [ smoke ] { coalesced writes }")
+{
+	constexpr std::size_t message_count = 20;
+
+	std::error_code err;
+	auto            lp = loop::create();
+	std::string     received;
+	std::string     expected;
+	std::size_t     completed{0};
+	bool            in_order{true};
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7006};
+
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}, err, [&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+					if (!ec)
+					{
+						received += buf.as_string();
+					}
+				});
+			});
+	CHECK(!err);
+
+	// the threshold is high enough that only the end of the loop iteration flushes
+	lp->connect_channel(
+			praktor::options{listen_ep}.coalesce_writes(64 * 1024),
+			err,
+			[&](channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				for (std::size_t i = 0; i < message_count; ++i)
+				{
+					auto message = "message " + std::to_string(i) + ";";
+					expected += message;
+					chan->write(
+							util::mutable_buffer{message},
+							[&, i, message](channel::ptr const&, util::mutable_buffer&& buf, std::error_code const& ec) {
+								CHECK(!ec);
+								CHECK(buf.as_string() == message);
+								in_order = in_order && completed == i;
+								++completed;
+							});
+				}
+
+				std::deque<util::mutable_buffer> bufs;
+				bufs.emplace_back(util::mutable_buffer{"multi "});
+				bufs.emplace_back(util::mutable_buffer{"buffer;"});
+				expected += "multi buffer;";
+				chan->write(
+						std::move(bufs),
+						[&](channel::ptr const&, std::deque<util::mutable_buffer>&& bufs, std::error_code const& ec) {
+							CHECK(!ec);
+							CHECK(bufs.size() == 2);
+							in_order = in_order && completed == message_count;
+							++completed;
+						});
+
+				// nothing is written until the loop gets to its check phase
+				CHECK(completed == 0);
+			});
+	CHECK(!err);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{500});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(completed == message_count + 1);
+	CHECK(in_order);
+	CHECK(received == expected);
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_acceptor [ smoke ] { coalesced writes flush at threshold and on close }")
+{
+	std::error_code err;
+	auto            lp = loop::create();
+	std::string     received;
+	std::size_t     completed{0};
+	std::size_t     last_completed{0};
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7006};
+
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}.framing(true),
+			err,
+			[&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+					if (!ec)
+					{
+						received += buf.as_string();
+					}
+				});
+			});
+	CHECK(!err);
+
+	lp->connect_channel(
+			praktor::options{listen_ep}.framing(true).coalesce_writes(32),
+			err,
+			[&](channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				auto on_write = [&](channel::ptr const& cp, util::mutable_buffer&&, std::error_code const& ec) {
+					CHECK(!ec);
+					++completed;
+					if (completed == 2)
+					{
+						// gathered, not yet written, when the channel closes; closing
+						// submits it rather than dropping it
+						cp->write(util::mutable_buffer{"last"}, [&](channel::ptr const&, util::mutable_buffer&&, std::error_code const&) {
+							++last_completed;
+						});
+						cp->close();
+					}
+				};
+
+				// each frame is an 8 byte header and 12 bytes of payload; the
+				// second frame crosses the threshold
+				chan->write(util::mutable_buffer{"first frame;"}, on_write);
+				chan->write(util::mutable_buffer{"second frame"}, on_write);
+			});
+	CHECK(!err);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{500});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(completed == 2);
+	CHECK(last_completed == 1);
+	CHECK(received == "first frame;second framelast");
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_acceptor [ smoke ] { immediate writes complete asynchronously and in order }")
+{
+	constexpr std::size_t big_size = 4 * 1024 * 1024;
+
+	std::error_code err;
+	auto            lp = loop::create();
+	std::size_t     received{0};
+	std::size_t     completed{0};
+	bool            in_order{true};
+	bool            again_completed{false};
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7007};
+
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}, err, [&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+					if (!ec)
+					{
+						received += buf.size();
+					}
+				});
+			});
+	CHECK(!err);
+
+	lp->connect_channel(praktor::options{listen_ep}, err, [&](channel::ptr const& chan, std::error_code const& ec) {
+		CHECK(!ec);
+
+		// written on the spot; the handler still runs later, and may write again
+		chan->write(
+				util::mutable_buffer{"small;"},
+				[&](channel::ptr const& cp, util::mutable_buffer&& buf, std::error_code const& ec) {
+					CHECK(!ec);
+					CHECK(buf.as_string() == "small;");
+					in_order = in_order && completed == 0;
+					++completed;
+					cp->write(util::mutable_buffer{"again;"}, [&](channel::ptr const&, util::mutable_buffer&&, std::error_code const& ec) {
+						CHECK(!ec);
+						again_completed = true;
+					});
+				});
+		CHECK(completed == 0);
+
+		// more than the socket takes at once; the tail goes out with a request
+		util::mutable_buffer big{big_size};
+		big.fill(static_cast<util::byte_type>('Z'));
+		big.size(big_size);
+		chan->write(std::move(big), [&](channel::ptr const&, util::mutable_buffer&& buf, std::error_code const& ec) {
+			CHECK(!ec);
+			CHECK(buf.size() == big_size);
+			in_order = in_order && completed == 1;
+			++completed;
+		});
+
+		// queued behind the big write
+		std::deque<util::mutable_buffer> bufs;
+		bufs.emplace_back(util::mutable_buffer{"multi "});
+		bufs.emplace_back(util::mutable_buffer{"buffer;"});
+		chan->write(
+				std::move(bufs),
+				[&](channel::ptr const&, std::deque<util::mutable_buffer>&& bufs, std::error_code const& ec) {
+					CHECK(!ec);
+					CHECK(bufs.size() == 2);
+					in_order = in_order && completed == 2;
+					++completed;
+				});
+		CHECK(completed == 0);
+	});
+	CHECK(!err);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{500});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(completed == 3);
+	CHECK(in_order);
+	CHECK(again_completed);
+	CHECK(received == 6 + big_size + 13 + 6);
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_acceptor [ smoke ] { write watermarks fail fast and drain }")
+{
+	constexpr std::size_t chunk_size     = 64 * 1024;
+	constexpr std::size_t high_watermark = 256 * 1024;
+	constexpr std::size_t low_watermark  = 64 * 1024;
+
+	std::error_code err;
+	auto            lp = loop::create();
+	std::size_t     written{0};
+	std::size_t     received{0};
+	std::size_t     pressure_count{0};
+	std::size_t     drain_count{0};
+	std::size_t     queued_at_pressure{0};
+	bool            refused{false};
+	bool            written_after_drain{false};
+	channel::ptr    server_chan;
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7006};
+
+	// the server reads nothing until the client is under pressure
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}, err, [&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				server_chan = chan;
+			});
+	CHECK(!err);
+
+	lp->connect_channel(
+			praktor::options{listen_ep}
+					.write_watermarks(high_watermark, low_watermark)
+					.pressure_policy(write_pressure_policy::fail_fast),
+			err,
+			[&](channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				chan->on_pressure([&](channel::ptr const& cp, std::size_t queued) {
+					++pressure_count;
+					queued_at_pressure = queued;
+					CHECK(cp->is_under_pressure());
+				});
+				chan->on_drain([&](channel::ptr const& cp) {
+					++drain_count;
+					CHECK(!cp->is_under_pressure());
+					CHECK(cp->get_queue_size() <= low_watermark);
+					std::error_code ec;
+					util::mutable_buffer buf{chunk_size};
+					buf.fill(0);
+					buf.size(chunk_size);
+					cp->write(std::move(buf), ec);
+					written_after_drain = !ec;
+					if (!ec)
+					{
+						written += chunk_size;
+					}
+				});
+
+				// writes go out on the spot until the socket buffers fill
+				std::error_code write_err;
+				for (std::size_t i = 0; i < 1024 && !chan->is_under_pressure(); ++i)
+				{
+					util::mutable_buffer buf{chunk_size};
+					buf.fill(0);
+					buf.size(chunk_size);
+					chan->write(std::move(buf), write_err);
+					CHECK(!write_err);
+					written += chunk_size;
+				}
+				CHECK(chan->is_under_pressure());
+
+				util::mutable_buffer buf{chunk_size};
+				buf.fill(0);
+				buf.size(chunk_size);
+				chan->write(std::move(buf), write_err);
+				refused = write_err == praktor::errc::write_queue_full;
+			});
+	CHECK(!err);
+
+	auto read_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) {
+		REQUIRE(server_chan);
+		server_chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+			if (!ec)
+			{
+				received += buf.size();
+			}
+		});
+	});
+	read_timer->start(std::chrono::milliseconds{100});
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{1000});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(pressure_count == 1);
+	CHECK(queued_at_pressure >= high_watermark);
+	CHECK(refused);
+	CHECK(drain_count == 1);
+	CHECK(written_after_drain);
+	CHECK(received == written);
+
+	server_chan.reset();
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_acceptor [ smoke ] { write pressure pauses reading }")
+{
+	constexpr std::size_t reply_size = 16 * 1024 * 1024;
+
+	std::error_code err;
+	auto            lp = loop::create();
+	std::size_t     client_received{0};
+	std::string     server_received;
+	bool            drained{false};
+	bool            read_while_paused{false};
+	channel::ptr    client_chan;
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7006};
+
+	// the first request gets a reply larger than the socket buffers take
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}.write_watermarks(1024 * 1024, 0).pressure_policy(write_pressure_policy::pause_read),
+			err,
+			[&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				chan->on_drain([&](channel::ptr const&) { drained = true; });
+				chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+					if (ec)
+					{
+						return;
+					}
+					read_while_paused = read_while_paused || cp->is_under_pressure();
+					server_received += buf.as_string();
+					if (server_received == "first;")
+					{
+						util::mutable_buffer reply{reply_size};
+						reply.fill(0);
+						reply.size(reply_size);
+						cp->write(std::move(reply));
+						CHECK(cp->is_under_pressure());
+					}
+				});
+			});
+	CHECK(!err);
+
+	lp->connect_channel(praktor::options{listen_ep}, err, [&](channel::ptr const& chan, std::error_code const& ec) {
+		CHECK(!ec);
+		client_chan = chan;
+		chan->write(util::mutable_buffer{"first;"});
+	});
+	CHECK(!err);
+
+	// sent while the server is under pressure; the client reads later
+	auto second_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) {
+		REQUIRE(client_chan);
+		client_chan->write(util::mutable_buffer{"second;"});
+	});
+	second_timer->start(std::chrono::milliseconds{50});
+
+	auto read_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) {
+		CHECK(server_received == "first;");
+		client_chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+			if (!ec)
+			{
+				client_received += buf.size();
+			}
+		});
+	});
+	read_timer->start(std::chrono::milliseconds{150});
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{1500});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(drained);
+	CHECK(!read_while_paused);
+	CHECK(server_received == "first;second;");
+	CHECK(client_received == reply_size);
+
+	client_chan.reset();
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_acceptor [ smoke ] { socket options }")
+{
+	constexpr std::size_t write_size = 1024 * 1024;
+
+	std::error_code err;
+	auto            lp = loop::create();
+	channel::ptr    server_chan;
+	channel::ptr    client_chan;
+	std::size_t     queued{0};
+	bool            connected{false};
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7006};
+
+	// small buffers on both ends; the server's come from its listening socket
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}.receive_buffer_size(32 * 1024).nodelay(true).backlog(16),
+			err,
+			[&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				server_chan = chan;
+			});
+	CHECK(!err);
+
+	lp->connect_channel(
+			praktor::options{listen_ep}
+					.send_buffer_size(32 * 1024)
+					.nodelay(true)
+					.keepalive(true, std::chrono::seconds{30})
+					.quickack(true)
+					.notsent_lowat(16 * 1024)
+					.user_timeout(std::chrono::milliseconds{5000}),
+			err,
+			[&](channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				connected   = true;
+				client_chan = chan;
+
+				// with the server not reading, little fits in the socket buffers
+				util::mutable_buffer buf{write_size};
+				buf.fill(0);
+				buf.size(write_size);
+				chan->write(std::move(buf));
+				queued = chan->get_queue_size();
+			});
+	CHECK(!err);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{200});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(connected);
+	CHECK(queued >= write_size / 2);
+
+#if defined(__linux__)
+	// Linux doubles the buffer sizes it is given, to allow for bookkeeping
+	REQUIRE(client_chan);
+	auto& client = *util::dynamic_pointer_cast<tcp_channel_uv>(client_chan);
+	CHECK(get_socket_option(client, IPPROTO_TCP, TCP_NODELAY) == 1);
+	CHECK(get_socket_option(client, SOL_SOCKET, SO_KEEPALIVE) == 1);
+	CHECK(get_socket_option(client, IPPROTO_TCP, TCP_KEEPIDLE) == 30);
+	CHECK(get_socket_option(client, SOL_SOCKET, SO_SNDBUF) == 2 * 32 * 1024);
+	CHECK(get_socket_option(client, IPPROTO_TCP, TCP_NOTSENT_LOWAT) == 16 * 1024);
+	CHECK(get_socket_option(client, IPPROTO_TCP, TCP_USER_TIMEOUT) == 5000);
+
+	REQUIRE(server_chan);
+	auto& server = *util::dynamic_pointer_cast<tcp_channel_uv>(server_chan);
+	CHECK(get_socket_option(server, IPPROTO_TCP, TCP_NODELAY) == 1);
+	CHECK(get_socket_option(server, SOL_SOCKET, SO_RCVBUF) == 2 * 32 * 1024);
+#endif
+
+	client_chan.reset();
+	server_chan.reset();
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_acceptor [ smoke ] { v6only }")
+{
+	std::error_code err;
+	auto            lp = loop::create();
+	std::error_code v4_result;
+	std::size_t     connect_count{0};
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v6_any(), 7006};
+
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}.v6only(true),
+			err,
+			[&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {});
+	CHECK(!err);
+
+	lp->connect_channel(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v6_loopback(), 7006}},
+			err,
+			[&](channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				++connect_count;
+			});
+	CHECK(!err);
+
+	// IPv4 connections are not accepted on an IPv6-only socket
+	lp->connect_channel(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 7006}},
+			err,
+			[&](channel::ptr const& chan, std::error_code const& ec) {
+				v4_result = ec;
+				++connect_count;
+			});
+	CHECK(!err);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{200});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(connect_count == 2);
+	CHECK(v4_result == std::errc::connection_refused);
+#if defined(__linux__)
+	CHECK(get_socket_option(*util::dynamic_pointer_cast<tcp_acceptor_uv>(lstnr), IPPROTO_IPV6, IPV6_V6ONLY) == 1);
+#endif
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_framing_acceptor [ smoke ] { frame header formats }")
+{
+	// sizes on either side of the varint byte boundaries and the fixed16 limit
+	std::vector<std::size_t> const sizes{0, 1, 127, 128, 300, 16383, 16384, 65535};
+
+	auto frame_contents = [](std::size_t size) { return std::string(size, static_cast<char>('a' + size % 26)); };
+
+	for (auto format : {frame_header_format::fixed16,
+						frame_header_format::fixed32,
+						frame_header_format::fixed64,
+						frame_header_format::varint})
+	{
+		std::error_code          err;
+		auto                     lp = loop::create();
+		std::vector<std::string> received;
+		std::error_code          oversized_err;
+		channel::ptr             server_chan;
+
+		praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7006};
+
+		auto lstnr = lp->create_acceptor(
+				praktor::options{listen_ep}.framing(true).frame_header(format),
+				err,
+				[&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+					CHECK(!ec);
+					server_chan = chan;
+					chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+						CHECK(!ec);
+						received.emplace_back(buf.as_string());
+						if (received.size() == sizes.size())
+						{
+							cp->loop()->stop();
+						}
+					});
+				});
+		CHECK(!err);
+
+		lp->connect_channel(
+				praktor::options{listen_ep}.framing(true).frame_header(format),
+				err,
+				[&](channel::ptr const& chan, std::error_code const& ec) {
+					CHECK(!ec);
+					for (auto size : sizes)
+					{
+						chan->write(util::mutable_buffer{frame_contents(size)});
+					}
+					chan->write(util::mutable_buffer{frame_contents(65536)}, oversized_err);
+				});
+		CHECK(!err);
+
+		auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+		stop_timer->start(std::chrono::milliseconds{1000});
+
+		lp->run(err);
+		CHECK(!err);
+		REQUIRE(received.size() == sizes.size());
+		for (std::size_t i = 0; i < sizes.size(); ++i)
+		{
+			CHECK(received[i] == frame_contents(sizes[i]));
+		}
+		if (format == frame_header_format::fixed16)
+		{
+			CHECK(oversized_err == praktor::errc::frame_too_large);
+		}
+		else
+		{
+			CHECK(!oversized_err);
+		}
+
+		server_chan.reset();
+		lp->close(err);
+		CHECK(!err);
+	}
+}
+
+TEST_CASE("praktor::tcp_framing_acceptor [ smoke ] { max frame size }")
+{
+	std::error_code err;
+	auto            lp = loop::create();
+	std::size_t     frame_count{0};
+	std::error_code read_err;
+	std::error_code write_err;
+
+	std::vector<channel::ptr> server_chans;
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7006};
+
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}.framing(true).max_frame_size(512),
+			err,
+			[&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				server_chans.push_back(chan);
+				chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+					if (ec)
+					{
+						read_err = ec;
+						return;
+					}
+					++frame_count;
+				});
+			});
+	CHECK(!err);
+
+	// the limit applies to writes too, but the client sets none
+	lp->connect_channel(
+			praktor::options{listen_ep}.framing(true), err, [&](channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				chan->write(util::mutable_buffer{std::string(512, 'x')});
+				chan->write(util::mutable_buffer{std::string(513, 'x')});
+				chan->write(util::mutable_buffer{std::string(10, 'x')});
+			});
+	CHECK(!err);
+
+	lp->connect_channel(
+			praktor::options{listen_ep}.framing(true).max_frame_size(512),
+			err,
+			[&](channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				chan->write(util::mutable_buffer{std::string(513, 'x')}, write_err);
+			});
+	CHECK(!err);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{200});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(frame_count == 1);
+	CHECK(read_err == praktor::errc::frame_too_large);
+	CHECK(write_err == praktor::errc::frame_too_large);
+
+	server_chans.clear();
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_framing_acceptor [ smoke ] { framed coalesced writes }")
+{
+	constexpr std::size_t frame_count = 20;
+
+	std::error_code          err;
+	auto                     lp = loop::create();
+	std::vector<std::string> received;
+	std::size_t              handler_count{0};
+	channel::ptr             server_chan;
+
+	auto frame_contents = [](std::size_t i) { return std::string(10 * i, static_cast<char>('a' + i % 26)); };
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7006};
+
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}.framing(true).frame_header(frame_header_format::varint),
+			err,
+			[&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				server_chan = chan;
+				chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+					CHECK(!ec);
+					received.emplace_back(buf.as_string());
+					if (received.size() == frame_count)
+					{
+						cp->loop()->stop();
+					}
+				});
+			});
+	CHECK(!err);
+
+	// every frame of the burst goes out in one gathered write, headers and all
+	lp->connect_channel(
+			praktor::options{listen_ep}.framing(true).frame_header(frame_header_format::varint).coalesce_writes(64 * 1024),
+			err,
+			[&](channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				for (std::size_t i = 0; i < frame_count; ++i)
+				{
+					auto contents = frame_contents(i);
+					if (i % 2)
+					{
+						std::deque<util::mutable_buffer> bufs;
+						bufs.emplace_back(util::mutable_buffer{contents.substr(0, i)});
+						bufs.emplace_back(util::mutable_buffer{contents.substr(i)});
+						chan->write(
+								std::move(bufs),
+								[&](channel::ptr const&, std::deque<util::mutable_buffer>&& bufs, std::error_code const& ec) {
+									CHECK(!ec);
+									CHECK(bufs.size() == 2);
+									++handler_count;
+								});
+					}
+					else
+					{
+						chan->write(
+								util::mutable_buffer{contents},
+								[&](channel::ptr const&, util::mutable_buffer&&, std::error_code const& ec) {
+									CHECK(!ec);
+									++handler_count;
+								});
+					}
+				}
+			});
+	CHECK(!err);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{1000});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(handler_count == frame_count);
+	REQUIRE(received.size() == frame_count);
+	for (std::size_t i = 0; i < frame_count; ++i)
+	{
+		CHECK(received[i] == frame_contents(i));
+	}
+
+	server_chan.reset();
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_framing_acceptor [ smoke ] { batched frame delivery }")
+{
+	constexpr std::size_t frame_count = 200;
+
+	std::error_code          err;
+	auto                     lp = loop::create();
+	std::vector<std::string> received;
+	std::size_t              batch_count{0};
+	std::size_t              largest_batch{0};
+	channel::ptr             server_chan;
+
+	auto frame_contents = [](std::size_t i) { return std::string(1 + i % 50, static_cast<char>('a' + i % 26)); };
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7006};
+
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}.framing(true),
+			err,
+			[&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				server_chan = chan;
+				chan->start_read_batch(
+						[&](channel::ptr const& cp, util::const_buffer* bufs, std::size_t count, std::error_code const& ec) {
+							CHECK(!ec);
+							CHECK(count > 0);
+							++batch_count;
+							largest_batch = std::max(largest_batch, count);
+							for (std::size_t i = 0; i < count; ++i)
+							{
+								received.emplace_back(bufs[i].as_string());
+							}
+							if (received.size() == frame_count)
+							{
+								cp->loop()->stop();
+							}
+						});
+			});
+	CHECK(!err);
+
+	// gathered into one write, the frames arrive in as few reads as possible
+	lp->connect_channel(
+			praktor::options{listen_ep}.framing(true).coalesce_writes(64 * 1024),
+			err,
+			[&](channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				for (std::size_t i = 0; i < frame_count; ++i)
+				{
+					chan->write(util::mutable_buffer{frame_contents(i)});
+				}
+			});
+	CHECK(!err);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{1000});
+
+	lp->run(err);
+	CHECK(!err);
+	REQUIRE(received.size() == frame_count);
+	for (std::size_t i = 0; i < frame_count; ++i)
+	{
+		CHECK(received[i] == frame_contents(i));
+	}
+	CHECK(batch_count < frame_count);
+	CHECK(largest_batch > 1);
+
+	server_chan.reset();
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_delimited_channel [ smoke ] { delimited records }")
+{
+	std::vector<std::string> const records{"alpha", "", "bravo charlie", std::string(300, 'x'), "delta", "echo"};
+
+	std::string stream;
+	for (auto const& record : records)
+	{
+		stream += record + "\r\n";
+	}
+
+	// pieces sent apart, so delimiters and records straddle reads
+	std::vector<std::string> const pieces{
+			stream.substr(0, 6), stream.substr(6, 1), stream.substr(7, 100), stream.substr(107, 230), stream.substr(337)};
+
+	std::error_code          err;
+	auto                     lp = loop::create();
+	std::vector<std::string> received;
+	channel::ptr             server_chan;
+	channel::ptr             client_chan;
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7006};
+
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}.delimiter("\r\n"),
+			err,
+			[&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				server_chan = chan;
+				chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+					CHECK(!ec);
+					received.emplace_back(buf.as_string());
+					if (received.size() == records.size())
+					{
+						cp->loop()->stop();
+					}
+				});
+			});
+	CHECK(!err);
+
+	lp->connect_channel(praktor::options{listen_ep}, err, [&](channel::ptr const& chan, std::error_code const& ec) {
+		CHECK(!ec);
+		client_chan = chan;
+		for (std::size_t i = 0; i < pieces.size(); ++i)
+		{
+			lp->schedule(std::chrono::milliseconds{20 * (i + 1)}, [&, i](loop::ptr const&) {
+				client_chan->write(util::mutable_buffer{pieces[i]});
+			});
+		}
+	});
+	CHECK(!err);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{1000});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(received == records);
+
+	server_chan.reset();
+	client_chan.reset();
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::tcp_delimited_channel [ smoke ] { max record length }")
+{
+	std::error_code          err;
+	auto                     lp = loop::create();
+	std::vector<std::string> received;
+	std::error_code          read_err;
+	channel::ptr             server_chan;
+
+	praktor::ip::endpoint listen_ep{praktor::ip::address::v4_loopback(), 7006};
+
+	auto lstnr = lp->create_acceptor(
+			praktor::options{listen_ep}.delimiter("\n").max_frame_size(16),
+			err,
+			[&](acceptor::ptr const& ap, channel::ptr const& chan, std::error_code const& ec) {
+				CHECK(!ec);
+				server_chan = chan;
+				chan->start_read([&](channel::ptr const& cp, util::const_buffer&& buf, std::error_code const& ec) {
+					if (ec)
+					{
+						read_err = ec;
+						return;
+					}
+					received.emplace_back(buf.as_string());
+				});
+			});
+	CHECK(!err);
+
+	lp->connect_channel(praktor::options{listen_ep}, err, [&](channel::ptr const& chan, std::error_code const& ec) {
+		CHECK(!ec);
+		chan->write(util::mutable_buffer{"sixteen chars ok\n" + std::string(40, 'y')});
+	});
+	CHECK(!err);
+
+	auto stop_timer = lp->create_timer(err, [&](praktor::timer::ptr tp) { tp->loop()->stop(); });
+	stop_timer->start(std::chrono::milliseconds{200});
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(received == std::vector<std::string>{"sixteen chars ok"});
+	CHECK(read_err == praktor::errc::frame_too_large);
+
+	server_chan.reset();
+	lp->close(err);
+	CHECK(!err);
+}
@@ -25,7 +25,9 @@
 #include <praktor/loop.h>
 #include <doctest.h>
 #include <iostream>
+#include <thread>
 #include <util/buffer.h>
+#include <vector>
 
 #define END_LOOP(loop_ptr, delay_ms)                                                                                   \
 	{                                                                                                                  \
@@ -237,3 +239,464 @@ TEST_CASE("praktor::udp [ smoke ] { max datagram size }")
 	lp->close(err);
 	CHECK(!err);
 }
+
+TEST_CASE("praktor::udp [ smoke ] { datagram truncated to mtu }")
+{
+	bool receive_handler_did_execute{false};
+
+	std::error_code err;
+	auto            lp = loop::create();
+
+	END_LOOP(lp, 2000);
+
+	auto recvr = lp->create_transceiver(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 7002}}.mtu(512),
+			err,
+			[&](praktor::transceiver::ptr    transp,
+				util::const_buffer&&         buf,
+				praktor::ip::endpoint const& ep,
+				std::error_code const&       err) {
+				receive_handler_did_execute = true;
+				CHECK(err == std::errc::message_size);
+				CHECK(buf.size() == 512);
+			});
+	CHECK(!err);
+
+	praktor::transceiver::ptr trans
+			= lp->create_transceiver(praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 0}}, err);
+	CHECK(!err);
+
+	util::mutable_buffer big{1000};
+	big.fill(static_cast<util::byte_type>('Z'));
+
+	DELAYED_ACTION_BEGIN(lp)
+	{
+		trans->emit(std::move(big), praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 7002}, err);
+		CHECK(!err);
+	}
+	DELAYED_ACTION_END(500);
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(receive_handler_did_execute);
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::udp [ smoke ] { received buffers held past their slots }")
+{
+	constexpr std::size_t datagram_count = 40;
+
+	std::error_code                 err;
+	auto                            lp = loop::create();
+	std::vector<util::const_buffer> held;
+
+	END_LOOP(lp, 2000);
+
+	auto recvr = lp->create_transceiver(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 7002}},
+			err,
+			[&](praktor::transceiver::ptr    transp,
+				util::const_buffer&&         buf,
+				praktor::ip::endpoint const& ep,
+				std::error_code const&       err) {
+				CHECK(!err);
+				held.emplace_back(std::move(buf));
+			});
+	CHECK(!err);
+
+	praktor::transceiver::ptr trans
+			= lp->create_transceiver(praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 0}}, err);
+	CHECK(!err);
+
+	DELAYED_ACTION_BEGIN(lp)
+	{
+		for (std::size_t i = 0; i < datagram_count; ++i)
+		{
+			util::mutable_buffer msg{100};
+			msg.fill(static_cast<util::byte_type>(i));
+			trans->emit(std::move(msg), praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 7002}, err);
+			CHECK(!err);
+		}
+	}
+	DELAYED_ACTION_END(500);
+
+	lp->run(err);
+	CHECK(!err);
+	recvr.reset();
+	lp->close(err);
+	CHECK(!err);
+
+	// every datagram kept its own slot, even after the transceiver closed
+	REQUIRE(held.size() == datagram_count);
+	for (std::size_t i = 0; i < datagram_count; ++i)
+	{
+		REQUIRE(held[i].size() == 100);
+		CHECK(held[i].data()[0] == static_cast<util::byte_type>(i));
+		CHECK(held[i].data()[99] == static_cast<util::byte_type>(i));
+	}
+
+	std::thread releaser([buffers{std::move(held)}]() mutable { buffers.clear(); });
+	releaser.join();
+}
+
+TEST_CASE("praktor::udp [ smoke ] { batched receive }")
+{
+	constexpr std::size_t datagram_count = 40;
+
+	std::error_code err;
+	auto            lp = loop::create();
+	std::size_t     received{0};
+	std::size_t     largest_batch{0};
+	bool            in_order{true};
+
+	END_LOOP(lp, 1500);
+
+	auto recvr = lp->create_transceiver(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 7002}}.receive_batch(16), err);
+	CHECK(!err);
+	recvr->start_receive(
+			err,
+			[&](praktor::transceiver::ptr const&          transp,
+				std::vector<praktor::received_datagram>& batch,
+				std::error_code const&                    err) {
+				CHECK(!err);
+				largest_batch = std::max(largest_batch, batch.size());
+				for (auto& dgram : batch)
+				{
+					CHECK(!dgram.error);
+					CHECK(dgram.buffer.size() == 100);
+					in_order = in_order && dgram.buffer.data()[0] == static_cast<util::byte_type>(received);
+					++received;
+				}
+			});
+	CHECK(!err);
+
+	praktor::transceiver::ptr trans
+			= lp->create_transceiver(praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 0}}, err);
+	CHECK(!err);
+
+	DELAYED_ACTION_BEGIN(lp)
+	{
+		for (std::size_t i = 0; i < datagram_count; ++i)
+		{
+			util::mutable_buffer msg{100};
+			msg.fill(static_cast<util::byte_type>(i));
+			trans->emit(std::move(msg), praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 7002}, err);
+			CHECK(!err);
+		}
+	}
+	DELAYED_ACTION_END(500);
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(received == datagram_count);
+	CHECK(in_order);
+	CHECK(largest_batch >= 1);
+	CHECK(largest_batch <= 16);
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::udp [ smoke ] { per-datagram callbacks with batched receive }")
+{
+	constexpr std::size_t datagram_count = 40;
+
+	std::error_code err;
+	auto            lp = loop::create();
+	std::size_t     received{0};
+
+	END_LOOP(lp, 1500);
+
+	auto recvr = lp->create_transceiver(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 7002}}.receive_batch(16),
+			err,
+			[&](praktor::transceiver::ptr    transp,
+				util::const_buffer&&         buf,
+				praktor::ip::endpoint const& ep,
+				std::error_code const&       err) {
+				CHECK(!err);
+				CHECK(buf.size() == 100);
+				CHECK(buf.data()[0] == static_cast<util::byte_type>(received));
+				++received;
+			});
+	CHECK(!err);
+
+	praktor::transceiver::ptr trans
+			= lp->create_transceiver(praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 0}}, err);
+	CHECK(!err);
+
+	DELAYED_ACTION_BEGIN(lp)
+	{
+		for (std::size_t i = 0; i < datagram_count; ++i)
+		{
+			util::mutable_buffer msg{100};
+			msg.fill(static_cast<util::byte_type>(i));
+			trans->emit(std::move(msg), praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 7002}, err);
+			CHECK(!err);
+		}
+	}
+	DELAYED_ACTION_END(500);
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(received == datagram_count);
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::udp [ smoke ] { emit batch }")
+{
+	constexpr std::size_t datagram_count = 40;
+	constexpr std::size_t oversized      = 7;
+
+	std::error_code err;
+	auto            lp = loop::create();
+	std::size_t     received{0};
+	bool            in_order{true};
+	bool            completed{false};
+
+	END_LOOP(lp, 1500);
+
+	auto recvr = lp->create_transceiver(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 7002}},
+			err,
+			[&](praktor::transceiver::ptr    transp,
+				util::const_buffer&&         buf,
+				praktor::ip::endpoint const& ep,
+				std::error_code const&       err) {
+				CHECK(!err);
+				CHECK(buf.size() == 100);
+				if (received == oversized)
+				{
+					++received;
+				}
+				in_order = in_order && buf.data()[0] == static_cast<util::byte_type>(received);
+				++received;
+			});
+	CHECK(!err);
+
+	praktor::transceiver::ptr trans
+			= lp->create_transceiver(praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 0}}, err);
+	CHECK(!err);
+
+	DELAYED_ACTION_BEGIN(lp)
+	{
+		std::vector<praktor::outgoing_datagram> batch;
+		for (std::size_t i = 0; i < datagram_count; ++i)
+		{
+			// one datagram too large for any socket, to fail on its own
+			util::mutable_buffer msg{i == oversized ? std::size_t{70000} : std::size_t{100}};
+			msg.fill(static_cast<util::byte_type>(i));
+			batch.push_back({std::move(msg), praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 7002}, {}});
+		}
+
+		trans->emit_batch(
+				std::move(batch),
+				err,
+				[&](praktor::transceiver::ptr const&          transp,
+					std::vector<praktor::outgoing_datagram>&& batch,
+					std::error_code const&                    err) {
+					CHECK(err == std::errc::message_size);
+					CHECK(batch.size() == datagram_count);
+					for (std::size_t i = 0; i < batch.size(); ++i)
+					{
+						CHECK(bool(batch[i].error) == (i == oversized));
+						CHECK(batch[i].buffer.data()[0] == static_cast<util::byte_type>(i));
+					}
+					completed = true;
+				});
+		CHECK(!err);
+	}
+	DELAYED_ACTION_END(500);
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(completed);
+	CHECK(received == datagram_count);
+	CHECK(in_order);
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+// A batch the socket takes at once completes through a dispatch; closing
+// the loop before that runs must still release the request.
+TEST_CASE("praktor::udp [ smoke ] { emit batch on a loop that closes first }")
+{
+	std::error_code err;
+	auto            lp    = loop::create();
+	auto            token = std::make_shared<int>(0);
+
+	praktor::transceiver::ptr trans
+			= lp->create_transceiver(praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 0}}, err);
+	CHECK(!err);
+
+	std::vector<praktor::outgoing_datagram> batch;
+	batch.push_back({util::mutable_buffer{100}, praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 7002}, {}});
+	trans->emit_batch(
+			std::move(batch),
+			err,
+			[token](praktor::transceiver::ptr const&, std::vector<praktor::outgoing_datagram>&&, std::error_code const&) {
+			});
+	CHECK(!err);
+	CHECK(token.use_count() == 2);
+
+	lp->close(err);
+	CHECK(!err);
+	CHECK(token.use_count() == 1);
+}
+
+TEST_CASE("praktor::udp [ smoke ] { segmented emit }")
+{
+	constexpr std::size_t segment_size  = 1000;
+	constexpr std::size_t segment_count = 100;
+	constexpr std::size_t last_size     = 500;
+
+	std::error_code err;
+	auto            lp = loop::create();
+	std::size_t     received{0};
+	bool            in_order{true};
+	bool            completed{false};
+
+	END_LOOP(lp, 1500);
+
+	auto recvr = lp->create_transceiver(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 7002}},
+			err,
+			[&](praktor::transceiver::ptr    transp,
+				util::const_buffer&&         buf,
+				praktor::ip::endpoint const& ep,
+				std::error_code const&       err) {
+				CHECK(!err);
+				CHECK(buf.size() == (received == segment_count - 1 ? last_size : segment_size));
+				in_order = in_order && buf.data()[0] == static_cast<util::byte_type>(received);
+				++received;
+			});
+	CHECK(!err);
+
+	praktor::transceiver::ptr trans
+			= lp->create_transceiver(praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 0}}, err);
+	CHECK(!err);
+
+	DELAYED_ACTION_BEGIN(lp)
+	{
+		// more segments than one offload send carries, the last one short
+		util::mutable_buffer msg{(segment_count - 1) * segment_size + last_size};
+		msg.fill(0);
+		for (std::size_t i = 0; i < segment_count; ++i)
+		{
+			msg.data()[i * segment_size] = static_cast<util::byte_type>(i);
+		}
+
+		trans->emit_segmented(
+				std::move(msg),
+				segment_size,
+				praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 7002},
+				err,
+				[&](praktor::transceiver::ptr    transp,
+					util::mutable_buffer&&       buf,
+					praktor::ip::endpoint const& ep,
+					std::error_code              err) {
+					CHECK(!err);
+					CHECK(buf.size() == (segment_count - 1) * segment_size + last_size);
+					completed = true;
+				});
+		CHECK(!err);
+	}
+	DELAYED_ACTION_END(500);
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(completed);
+	CHECK(received == segment_count);
+	CHECK(in_order);
+
+	lp->close(err);
+	CHECK(!err);
+}
+
+TEST_CASE("praktor::udp [ smoke ] { segmented emit on a loop that closes first }")
+{
+	std::error_code err;
+	auto            lp    = loop::create();
+	auto            token = std::make_shared<int>(0);
+
+	praktor::transceiver::ptr trans
+			= lp->create_transceiver(praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 0}}, err);
+	CHECK(!err);
+
+	trans->emit_segmented(
+			util::mutable_buffer{100},
+			50,
+			praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 7002},
+			err,
+			[token](praktor::transceiver::ptr, util::mutable_buffer&&, praktor::ip::endpoint const&, std::error_code) {});
+	CHECK(!err);
+	CHECK(token.use_count() == 2);
+
+	lp->close(err);
+	CHECK(!err);
+	CHECK(token.use_count() == 1);
+}
+
+TEST_CASE("praktor::udp [ smoke ] { gro receive }")
+{
+	constexpr std::size_t segment_size  = 1000;
+	constexpr std::size_t segment_count = 40;
+
+	std::error_code err;
+	auto            lp = loop::create();
+	std::size_t     received{0};
+	bool            in_order{true};
+
+	END_LOOP(lp, 1500);
+
+	auto recvr = lp->create_transceiver(
+			praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 7002}}.gro(true), err);
+	CHECK(!err);
+	recvr->start_receive(
+			err,
+			[&](praktor::transceiver::ptr const&          transp,
+				std::vector<praktor::received_datagram>& batch,
+				std::error_code const&                    err) {
+				CHECK(!err);
+				for (auto& dgram : batch)
+				{
+					CHECK(!dgram.error);
+					CHECK(dgram.buffer.size() == segment_size);
+					in_order = in_order && dgram.buffer.data()[0] == static_cast<util::byte_type>(received);
+					++received;
+				}
+			});
+	CHECK(!err);
+
+	praktor::transceiver::ptr trans
+			= lp->create_transceiver(praktor::options{praktor::ip::endpoint{praktor::ip::address::v4_any(), 0}}, err);
+	CHECK(!err);
+
+	DELAYED_ACTION_BEGIN(lp)
+	{
+		util::mutable_buffer msg{segment_count * segment_size};
+		msg.fill(0);
+		for (std::size_t i = 0; i < segment_count; ++i)
+		{
+			msg.data()[i * segment_size] = static_cast<util::byte_type>(i);
+		}
+		trans->emit_segmented(
+				std::move(msg), segment_size, praktor::ip::endpoint{praktor::ip::address::v4_loopback(), 7002}, err);
+		CHECK(!err);
+	}
+	DELAYED_ACTION_END(500);
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(received == segment_count);
+	CHECK(in_order);
+
+	lp->close(err);
+	CHECK(!err);
+}
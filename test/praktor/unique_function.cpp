@@ -0,0 +1,179 @@
+/*
+ * The MIT License
+ *
+ * Copyright 2017 David Curtis.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include "allocation_counter.h"
+#include <doctest.h>
+#include <memory>
+#include <praktor/loop.h>
+#include <praktor/unique_function.h>
+#include <string>
+
+TEST_CASE("praktor::unique_function [ smoke ] { move-only capture }")
+{
+	auto p = std::make_unique<std::string>("payload");
+
+	praktor::unique_function<std::size_t()> f = [p{std::move(p)}]() { return p->size(); };
+	CHECK(f);
+	CHECK(f.is_inline());
+	CHECK(f() == 7);
+
+	praktor::unique_function<std::size_t()> g{std::move(f)};
+	CHECK(!f);
+	CHECK(g);
+	CHECK(g() == 7);
+}
+
+TEST_CASE("praktor::unique_function [ smoke ] { large target }")
+{
+	struct large
+	{
+		char m_bytes[praktor::unique_function<int()>::inline_size + 1];
+
+		int
+		operator()() const
+		{
+			return 42;
+		}
+	};
+
+	praktor::unique_function<int()> f = large{};
+	CHECK(!f.is_inline());
+	CHECK(f() == 42);
+
+	f = nullptr;
+	CHECK(!f);
+	CHECK_THROWS_AS(f(), std::bad_function_call);
+}
+
+TEST_CASE("praktor::unique_function [ smoke ] { empty targets }")
+{
+	std::function<void()>           empty_std;
+	void (*null_fp)()               = nullptr;
+	praktor::unique_function<void()> f = empty_std;
+	praktor::unique_function<void()> g = null_fp;
+	praktor::unique_function<void()> h = nullptr;
+	CHECK(!f);
+	CHECK(!g);
+	CHECK(h == nullptr);
+}
+
+TEST_CASE("praktor::unique_function [ smoke ] { dispatch move-only handler }")
+{
+	praktor::loop::ptr lp = praktor::loop::create();
+	std::error_code    err;
+	std::string        received;
+
+	auto payload = std::make_unique<std::string>("moved into dispatch");
+	lp->dispatch(err, [&, payload{std::move(payload)}](praktor::loop::ptr const& loop_ptr) {
+		received = *payload;
+		loop_ptr->stop();
+	});
+	CHECK(!err);
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(received == "moved into dispatch");
+	lp->close(err);
+	CHECK(!err);
+}
+
+// A loop handler is stored as given, so dispatching one costs exactly what
+// dispatching a void handler does; wrapping it in an adapting closure would
+// outgrow the inline storage and allocate.
+TEST_CASE("praktor::unique_function [ smoke ] { dispatch loop handler allocations }")
+{
+	constexpr std::size_t dispatch_count = 100;
+
+	praktor::loop::ptr lp = praktor::loop::create();
+	std::error_code    err;
+	std::size_t        ran{0};
+	std::size_t        loop_handler_allocations{0};
+	std::size_t        void_handler_allocations{0};
+
+	for (std::size_t i = 0; i < dispatch_count; ++i)
+	{
+		{
+			allocation_scope scope{true, loop_handler_allocations};
+			lp->dispatch(err, [&ran](praktor::loop::ptr const&) { ++ran; });
+		}
+		CHECK(!err);
+		{
+			allocation_scope scope{true, void_handler_allocations};
+			lp->dispatch(err, [&ran]() { ++ran; });
+		}
+		CHECK(!err);
+	}
+	lp->dispatch([](praktor::loop::ptr const& loop_ptr) { loop_ptr->stop(); });
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(ran == 2 * dispatch_count);
+	CHECK(loop_handler_allocations == void_handler_allocations);
+	lp->close(err);
+	CHECK(!err);
+}
+
+// Scheduling allocates the timer and nothing else, whichever signature the
+// handler has: the same as a timer created with a timer handler.
+TEST_CASE("praktor::unique_function [ smoke ] { schedule handler allocations }")
+{
+	constexpr std::size_t schedule_count = 100;
+
+	praktor::loop::ptr lp = praktor::loop::create();
+	std::error_code    err;
+	std::size_t        ran{0};
+	std::size_t        loop_handler_allocations{0};
+	std::size_t        void_handler_allocations{0};
+	std::size_t        timer_handler_allocations{0};
+
+	for (std::size_t i = 0; i < schedule_count; ++i)
+	{
+		{
+			allocation_scope scope{true, loop_handler_allocations};
+			lp->schedule(std::chrono::milliseconds{1}, err, [&ran](praktor::loop::ptr const&) { ++ran; });
+		}
+		CHECK(!err);
+		{
+			allocation_scope scope{true, void_handler_allocations};
+			lp->schedule(std::chrono::milliseconds{1}, err, [&ran]() { ++ran; });
+		}
+		CHECK(!err);
+		{
+			allocation_scope scope{true, timer_handler_allocations};
+			auto             tp = lp->create_timer(err, [&ran](praktor::timer::ptr) { ++ran; });
+			tp->start(std::chrono::milliseconds{1}, err);
+		}
+		CHECK(!err);
+	}
+	lp->schedule(std::chrono::milliseconds{50}, [](praktor::loop::ptr const& loop_ptr) { loop_ptr->stop(); });
+
+	lp->run(err);
+	CHECK(!err);
+	CHECK(ran == 3 * schedule_count);
+	CHECK(loop_handler_allocations == timer_handler_allocations);
+	CHECK(void_handler_allocations == timer_handler_allocations);
+	lp->close(err);
+	CHECK(!err);
+}